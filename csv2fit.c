@@ -26,10 +26,27 @@
 #include <errno.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 #include <fit_example.h>
 #include <fit_crc.h>
 
+#include <fit_convert.h>
+#include <fit_cpu.h>
+#include <fit_crc16.h>
+#include <fit_writer.h>
+#include <fit_encoder.h>
+
+#ifdef FIT_CPU_X86
+#include <immintrin.h>
+#endif
+
 // define fixed portion of fit message record. it must be packed;
 typedef struct {
    FIT_UINT8 reserved_1;
@@ -38,144 +55,382 @@ typedef struct {
    FIT_UINT8 num_fields;
 } __attribute__((__packed__)) _fit_fixed_mesg_def;
 
+// dev_fields and dev_base_types point right after the last entry of fields (same allocation)
 typedef struct {
    FIT_UINT8 num_fields;
    FIT_UINT8 num_dev_fields;
+   FIT_DEV_FIELD_DEF *dev_fields;
+   FIT_UINT8 *dev_base_types;                      // base type of dev fields values, BYTE if DEF line is not typed
    FIT_FIELD_DEF fields[0];
-   FIT_DEV_FIELD_DEF dev_fields[0];
 } _fit_mesg_def;
 
+// encode a single field value string (len bytes, not 0 terminated) into its binary value in the data record
+typedef struct {
+   int32_t (*str_to_val)(const int8_t *string, int32_t len, uint8_t *rv, uint8_t size);
+   uint16_t offset;                                // field offset in data record (record header excluded)
+   uint8_t size;
+   uint8_t t_size;                                 // element size
+   uint64_t invalid;                               // element invalid value, written for empty values (FIT_CSV_FORMAT, COMPACT)
+} _field_encoder;
+
+// DEF line compiled into an encode plan. DATA lines are encoded by walking the field encoders and
+// the definition record is kept ready to be written. plans are cached by DEF line hash, so a
+// repeated DEF line is found in cache and not parsed again.
+typedef struct _encode_plan {
+   struct _encode_plan *next;                      // next plan in same cache bucket
+   uint32_t hash;                                  // DEF line hash
+   int8_t *def_line;                               // DEF line text (cache key)
+   int32_t def_line_len;
+   _fit_mesg_def *mesg_def;                        // fields definitions
+   uint8_t mesg_type;                              // local message type
+   uint8_t rec_hdr;                                // data record header (normal header)
+   uint16_t data_mesg_len;                         // data record length without record header
+   uint16_t def_rec_len;                           // definition record length
+   uint8_t *def_rec;                               // definition record as written to FIT file
+   int32_t ts_offset;                              // timestamp field offset in data record, -1 if none
+   struct _encode_plan *ct_plan;                   // --compress-timestamps: same definition without timestamp field
+   int32_t num_encoders;
+   _field_encoder encoders[0];                     // fields and dev fields encoders
+} _encode_plan;
+
+#define PLAN_CACHE_SIZE            256             // number of cache buckets, must be power of 2
+
+// growing memory output, used instead of FIT file when encoding a chunk of CSV lines
+typedef struct {
+   uint8_t *buf;
+   size_t len;
+   size_t size;
+} _out_buf;
+
+#define TIMESTAMP_FIELD            253             // timestamp field number, same in all messages
+#define TIMESTAMP_INVALID          0xFFFFFFFF
+
+#define LINE_ERR_SIZE              128             // malformed line error text size
+#define CSV_READ_SIZE              (1024*1024)     // CSV pipe is read in blocks of this size
+
+// start of a record in FIT data and the CSV line it was encoded from (--verify-against)
+typedef struct {
+   FIT_UINT32 offset;
+   int32_t line;
+} _rec_pos;
+
+// records start offsets in increasing order
+typedef struct {
+   _rec_pos *pos;
+   int32_t count;
+   int32_t size;
+} _rec_index;
+
+#define VERIFY_BLOCK_SIZE          (1024*1024)     // FIT data is compared against reference in blocks of this size
+
+// --verify-against state. encoded FIT data is staged in blocks and each full block is compared with
+// the same bytes of the reference file, by the encoding thread or by the verify thread
+typedef struct {
+   FILE *ref_f;                                    // reference FIT file, positioned at next data block
+   FIT_UINT32 ref_data_left;                       // reference data bytes not read yet
+   uint8_t ref_hdr[FIT_FILE_HDR_SIZE];             // reference file header
+   uint8_t *ref_buf;                               // reference block
+   uint8_t *stage[2];                              // one block is filled while the other is compared
+   int32_t fill;                                   // block being filled
+   size_t fill_len;
+   FIT_UINT32 staged;                              // FIT data offset of block being filled
+   bool diff;                                      // difference was found
+   FIT_UINT32 diff_offset;                         // FIT data offset of first difference
+   bool threaded;                                  // --verify-thread mode
+   pthread_t thread;
+   pthread_mutex_t lock;
+   pthread_cond_t cond;
+   const uint8_t *job;                             // block handed to verify thread
+   size_t job_len;
+   FIT_UINT32 job_offset;
+   bool pending;                                   // job was not compared yet
+   bool stop;                                      // no more blocks
+} _verifier;
+
+// chunk of CSV text lines encoded by a worker thread (--jobs mode)
+typedef struct {
+   const int8_t *start;                            // first line of chunk
+   const int8_t *end;                              // end of chunk text
+   int32_t first_line;                             // CSV line number of first line
+   const int8_t *def_lines[FIT_HDR_TYPE_MASK+1];   // DEF lines in effect at chunk start
+   _out_buf out;                                   // encoded records
+   FIT_UINT16 crc;                                 // crc of encoded records, starting from 0
+   bool ok;
+   int32_t err_line;                               // line number and line definition of failing line
+   int32_t err_line_def;
+   int8_t err_text[LINE_ERR_SIZE];                 // why failing line could not be processed
+   _rec_index index;                               // records of chunk, offsets from chunk start (--verify-against)
+} _csv_chunk;
+
+#define CHUNKS_PER_JOB             4               // chunks per worker thread, to balance uneven chunks
+#define MIN_CHUNK_SIZE             (64*1024)       // do not split CSV text to smaller chunks
+
 #define _FIT_PROTOCOL_VERSION      1
 #define _FIT_PROFILE_VERSION       2
 #define _FIT_DEF                   3
 #define _FIT_DATA                  4
 #define _FIT_END                   5
+#define _FIT_CSV_FORMAT            6
 #define _FIT_NONE                  0
 
 // static arguments to save passing arguments between functions call
-static  FIT_UINT16 crc;                            // crc - we need to global to save argument passing
-static FIT_UINT32 fit_data_write;                  // track how much data was read 
-static _fit_mesg_def *mesg_type_def[FIT_HDR_TYPE_MASK+1]; // track on local message types 
+// encoding state is per thread, so that --jobs worker threads can encode CSV chunks side by side
+static __thread FIT_UINT16 crc;                    // crc - we need to global to save argument passing
+static __thread FIT_UINT32 fit_data_write;         // track how much data was read 
+static __thread _encode_plan *mesg_type_plan[FIT_HDR_TYPE_MASK+1]; // track on local message types 
+static __thread _encode_plan *plan_cache[PLAN_CACHE_SIZE];  // compiled DEF lines
 static FILE *fit_f;                                // fit file handle
 static FILE *csv_f;                                // csv file handle
-static FILE *cfit_f;                                // check file
-static uint8_t *wbuf;                       // write buffer 
-static int8_t *rbuf;                                 // read buffer 
-static int8_t *delim = ":,\n";                       // CSV values delimitors
-static int8_t *token;                                // parsing token
-static int32_t line_num = 0;
-#ifdef DEBUG
-static uint8_t *cbuf;                        // check buffer
-#endif
+static __thread uint8_t *wbuf;                     // write buffer 
+static int8_t *csv_text;                           // whole CSV file text, mapped or read to memory, or pipe buffer
+static size_t csv_len;
+static bool csv_mapped;                            // csv_text is mapped, otherwise it was allocated
+static __thread const int8_t *line_pos;            // tokenizer position in current line
+static __thread const int8_t *line_end;            // end of current line
+static __thread const int8_t *token;               // parsing token, it is not 0 terminated
+static __thread int32_t token_len;
+static __thread int32_t line_num = 0;
+static __thread int32_t line_def;                  // CSV line definition of last line
+static __thread int8_t line_err[LINE_ERR_SIZE];    // why last line could not be processed
+static __thread _out_buf *out_mem;                 // if set, fit_write() writes to memory instead of FIT file
+static _csv_chunk *chunks;                         // --jobs mode CSV chunks
+static int32_t num_chunks;
+static int32_t next_chunk;                         // next chunk to encode, taken atomically by worker threads
+static bool optimize_defs;                         // --optimize-defs mode
+static _fit_writer_slots out_slots;                // --optimize-defs: definitions held by FIT local message types
+static int32_t def_lines_count;                    // DEF lines in CSV file
+static int32_t def_recs_count;                     // definition records written to FIT file
+static bool compress_ts;                           // --compress-timestamps mode
+static FIT_UINT32 last_ts;                         // last timestamp as FIT reader tracks it
+static bool last_ts_valid;
+static _encode_plan *last_data_plan;               // plan of previous DATA line
+static int32_t ts_compressed_count;                // timestamps replaced by compressed timestamp header
+static bool real_floats;                           // CSV float values are decimal numbers (FIT_CSV_FORMAT, REAL_FLOATS)
+static int32_t bytes_format;                       // CSV BYTE values text (FIT_CSV_FORMAT, HEX_BYTES or BASE64_BYTES)
+static bool compact;                               // CSV values are not padded and invalid values are empty (FIT_CSV_FORMAT, COMPACT)
+static _verifier *verify;                          // --verify-against mode, NULL if output is not verified
+static _rec_index file_index;                      // records of FIT file (--verify-against)
+static __thread _rec_index *rec_index;             // if set, records start offsets are added to it
 
 /****************************************************/
 /* convert strings to FIT values based on their type */
 /****************************************************/
 typedef struct {
    FIT_FIT_BASE_TYPE base_type;
-   int32_t (*str_to_val)(int8_t *string, uint8_t *rv, int8_t size);
+   int32_t (*str_to_val)(const int8_t *string, int32_t len, uint8_t *rv, uint8_t size);
 } _base_type_to_value;
 
-#ifdef DEBUG
-// return 0 if 
-int32_t cmp_buff (int32_t size) {
-   int32_t s;
-   if (fread(cbuf, 1, size, cfit_f) < size) {
-      fprintf(stderr, "Failed to read from check file: %s\n", strerror(errno));
-      s = 1;
+// convert single array element to its binary value. return -1 if element is not a valid number
+// signed values are accepted up to the unsigned maximum of the same size and stored as two's complement.
+// fit2csv built where long is 64 bits prints negative SINT32 values as their unsigned 32 bits value.
+typedef int32_t (*_parse_elem)(const int8_t *s, int32_t len, uint8_t *val);
+
+static int32_t str2val (const int8_t *str, int32_t len, uint8_t *val, uint8_t size, int8_t t_size, _parse_elem parse_elem) {
+   const int8_t *str_end = str + len;
+   const int8_t *end;
+   int32_t i = 0;
+
+   // reset val;
+   memset(val, 0, size);
+
+   // array elements are separated by "|". empty elements are skipped as strtok() did
+   while ((str < str_end) && (i + t_size <= size)) {
+      if ((end = memchr(str, '|', str_end - str)) == NULL)
+         end = str_end;
+      if (end > str) {
+         if (parse_elem(str, end - str, val) < 0)
+            return 0;
+         i += t_size;
+         val += t_size;
+      }
+      str = (end < str_end) ? end + 1 : end;
    }
-   else
-      s = memcmp(cbuf, wbuf, size); 
 
-   return s;  
+   return i;
 }
-#endif
 
-static int32_t str2val (int8_t *str, uint8_t *val, int8_t size, int8_t t_size, int8_t *f1) {
-	int8_t *del = "|,";
-   int8_t *tokloc;     // local token
-   char *svloc;      // save local token location
-   int8_t i = 0;
-
-	// reset rval;
-	memset(val, 0, size);
-
-	tokloc = strtok_r(str, del, &svloc);      // use strtok_r() to keep global strtok() on right track
-	while ((tokloc != NULL) && (i < size)) {
-		sscanf(tokloc, f1, val);
-		i += t_size;
-      val += t_size;
-		tokloc = strtok_r(NULL, del, &svloc);
-	}
+static int32_t uint8_elem (const int8_t *s, int32_t len, uint8_t *val) {
+   uint64_t v;
 
-   return i;
+   if (parse_uint(s, len, UINT8_MAX, &v) < 0)
+      return -1;
+   *val = (uint8_t)v;
+   return 0;
 }
 
-static int32_t to_uint8 (int8_t *string, uint8_t *val, int8_t size) {
-   return str2val(string, val, size, sizeof(uint8_t), "%hhu");
+static int32_t int8_elem (const int8_t *s, int32_t len, uint8_t *val) {
+   int64_t v;
+
+   if (parse_int(s, len, INT8_MIN, UINT8_MAX, &v) < 0)
+      return -1;
+   *(int8_t *)val = (int8_t)v;
+   return 0;
 }
 
-static int32_t to_int8 (int8_t *string, uint8_t *val, int8_t size) {
-   return str2val(string, val, size, sizeof(int8_t), "%hhd");
+static int32_t uint16_elem (const int8_t *s, int32_t len, uint8_t *val) {
+   uint64_t v;
+   uint16_t us;
+
+   if (parse_uint(s, len, UINT16_MAX, &v) < 0)
+      return -1;
+   us = (uint16_t)v;
+   memcpy(val, &us, sizeof(us));
+   return 0;
 }
 
-static int32_t to_int16 (int8_t *string, uint8_t *val, int8_t size) {
-   return str2val(string, val, size, sizeof(int16_t), "%hd");
+static int32_t int16_elem (const int8_t *s, int32_t len, uint8_t *val) {
+   int64_t v;
+   int16_t ss;
+
+   if (parse_int(s, len, INT16_MIN, UINT16_MAX, &v) < 0)
+      return -1;
+   ss = (int16_t)v;
+   memcpy(val, &ss, sizeof(ss));
+   return 0;
+}
+
+static int32_t uint32_elem (const int8_t *s, int32_t len, uint8_t *val) {
+   uint64_t v;
+   uint32_t ul;
+
+   if (parse_uint(s, len, UINT32_MAX, &v) < 0)
+      return -1;
+   ul = (uint32_t)v;
+   memcpy(val, &ul, sizeof(ul));
+   return 0;
 }
 
+static int32_t int32_elem (const int8_t *s, int32_t len, uint8_t *val) {
+   int64_t v;
+   int32_t sl;
 
-static int32_t to_uint16 (int8_t *string, uint8_t *val, int8_t size) {
-   return str2val(string, val, size, sizeof(uint16_t), "%hu");
+   if (parse_int(s, len, INT32_MIN, UINT32_MAX, &v) < 0)
+      return -1;
+   sl = (int32_t)v;
+   memcpy(val, &sl, sizeof(sl));
+   return 0;
 }
 
-static int32_t to_int32 (int8_t *string, uint8_t *val, int8_t size) {
-   return str2val(string, val, size, sizeof(int32_t), "%d");
+static int32_t uint64_elem (const int8_t *s, int32_t len, uint8_t *val) {
+   uint64_t v;
+
+   if (parse_uint(s, len, UINT64_MAX, &v) < 0)
+      return -1;
+   memcpy(val, &v, sizeof(v));
+   return 0;
 }
 
-static int32_t to_uint32 (int8_t *string, uint8_t *val, int8_t size) {
-   return str2val(string, val, size, sizeof(uint32_t), "%u");
+static int32_t int64_elem (const int8_t *s, int32_t len, uint8_t *val) {
+   int64_t v;
+
+   if (parse_int(s, len, INT64_MIN, UINT64_MAX, &v) < 0)
+      return -1;
+   memcpy(val, &v, sizeof(v));
+   return 0;
+}
+
+static int32_t to_uint8 (const int8_t *string, int32_t len, uint8_t *val, uint8_t size) {
+   return str2val(string, len, val, size, sizeof(uint8_t), &uint8_elem);
+}
+
+static int32_t to_int8 (const int8_t *string, int32_t len, uint8_t *val, uint8_t size) {
+   return str2val(string, len, val, size, sizeof(int8_t), &int8_elem);
+}
+
+static int32_t to_int16 (const int8_t *string, int32_t len, uint8_t *val, uint8_t size) {
+   return str2val(string, len, val, size, sizeof(int16_t), &int16_elem);
+}
+
+
+static int32_t to_uint16 (const int8_t *string, int32_t len, uint8_t *val, uint8_t size) {
+   return str2val(string, len, val, size, sizeof(uint16_t), &uint16_elem);
 }
 
-static int32_t to_int64 (int8_t *string, uint8_t *val, int8_t size) {
-   return str2val(string, val, size, sizeof(int64_t), "%lld");
+static int32_t to_int32 (const int8_t *string, int32_t len, uint8_t *val, uint8_t size) {
+   return str2val(string, len, val, size, sizeof(int32_t), &int32_elem);
 }
 
-static int32_t to_uint64 (int8_t *string, uint8_t *val, int8_t size) {
+static int32_t to_uint32 (const int8_t *string, int32_t len, uint8_t *val, uint8_t size) {
+   return str2val(string, len, val, size, sizeof(uint32_t), &uint32_elem);
 }
 
-static int32_t to_string (int8_t *string, uint8_t *val, int8_t size) {
+static int32_t to_int64 (const int8_t *string, int32_t len, uint8_t *val, uint8_t size) {
+   return str2val(string, len, val, size, sizeof(int64_t), &int64_elem);
+}
+
+static int32_t to_uint64 (const int8_t *string, int32_t len, uint8_t *val, uint8_t size) {
+   return str2val(string, len, val, size, sizeof(uint64_t), &uint64_elem);
+}
+
+static int32_t float32_elem (const int8_t *s, int32_t len, uint8_t *val) {
+   float f;
+
+   if (parse_float32(s, len, &f) < 0)
+      return -1;
+   memcpy(val, &f, sizeof(f));
+   return 0;
+}
+
+static int32_t float64_elem (const int8_t *s, int32_t len, uint8_t *val) {
+   double d;
+
+   if (parse_float64(s, len, &d) < 0)
+      return -1;
+   memcpy(val, &d, sizeof(d));
+   return 0;
+}
+
+static int32_t to_float32 (const int8_t *string, int32_t len, uint8_t *val, uint8_t size) {
+   return str2val(string, len, val, size, sizeof(float), &float32_elem);
+}
+
+static int32_t to_float64 (const int8_t *string, int32_t len, uint8_t *val, uint8_t size) {
+   return str2val(string, len, val, size, sizeof(double), &float64_elem);
+}
+
+static int32_t to_string (const int8_t *string, int32_t len, uint8_t *val, uint8_t size) {
    // initialize val
    memset(val, 0, size);
    // copy string to val only of string != "NULL"
-   if (strcmp("NULL", string) != 0)
-      strncpy(val, string, size);
+   if ((len != 4) || (memcmp("NULL", string, 4) != 0))
+      memcpy(val, string, (len < size) ? len : size);
    return 1;
 }
 
 
 // handle unknown base type
-static int32_t unkonwn_base_type_2val (int8_t *str, uint8_t *val, int8_t size) {
-	uint8_t rval[size];
-	int8_t *del = "/";
-	int32_t i = 0;
-   int8_t *tokloc;     // local token
-   char *svloc;      // save local token location
-
-	// reset rval;
-	memset(rval, 0, sizeof(rval));
+// values are "/" terminated 3 digits bytes, e.g. "010/234/255/255/"
+static int32_t unkonwn_base_type_2val (const int8_t *str, int32_t len, uint8_t *val, uint8_t size) {
+   const int8_t *str_end = str + len;
+   const int8_t *end;
+   int32_t i = 0;
 
-	tokloc = strtok_r(str, del, &svloc);      // use strtok_r() to keep global strtok() on right track
-	while ((tokloc != NULL) && (i < size)) {
-		sscanf(tokloc, "%hhu", &rval[i]);
-		i++;
-		tokloc = strtok_r(NULL, del, &svloc);
-	}
+   // reset val;
+   memset(val, 0, size);
 
-	memcpy(val, rval, size);
+   while ((str < str_end) && (i < size)) {
+      if ((end = memchr(str, '/', str_end - str)) == NULL)
+         end = str_end;
+      if (end > str) {
+         if (uint8_elem(str, end - str, &val[i]) < 0)
+            return 0;
+         i++;
+      }
+      str = (end < str_end) ? end + 1 : end;
+   }
 
    return 1;
 }
 
+// BYTE values written by "fit2csv --bytes=hex" and "fit2csv --bytes=base64"
+static int32_t hex_2val (const int8_t *str, int32_t len, uint8_t *val, uint8_t size) {
+   return (parse_hex(str, len, val, size) < 0) ? 0 : 1;
+}
+
+static int32_t base64_2val (const int8_t *str, int32_t len, uint8_t *val, uint8_t size) {
+   return (parse_base64(str, len, val, size) < 0) ? 0 : 1;
+}
+
 static _base_type_to_value str2base[FIT_FIT_BASE_TYPE_COUNT] = {
    {FIT_FIT_BASE_TYPE_ENUM, &to_uint8},
    {FIT_FIT_BASE_TYPE_SINT8, &to_int8},
@@ -196,9 +451,38 @@ static _base_type_to_value str2base[FIT_FIT_BASE_TYPE_COUNT] = {
    {FIT_FIT_BASE_TYPE_UINT64Z, &to_uint64}
 };
 
+// float values written by "fit2csv --real-floats"
+static _base_type_to_value real_float2base[] = {
+   {FIT_FIT_BASE_TYPE_FLOAT32, &to_float32},
+   {FIT_FIT_BASE_TYPE_FLOAT64, &to_float64}
+};
+
+enum {
+   BYTES_DEC = 0,
+   BYTES_HEX,
+   BYTES_BASE64
+};
+
+// BYTE values decoders, indexed by bytes_format
+static _base_type_to_value compact_bytes2base[] = {
+   {FIT_FIT_BASE_TYPE_BYTE, &unkonwn_base_type_2val},
+   {FIT_FIT_BASE_TYPE_BYTE, &hex_2val},
+   {FIT_FIT_BASE_TYPE_BYTE, &base64_2val}
+};
+
 _base_type_to_value *get_type_2base (FIT_FIT_BASE_TYPE type) {
 	int32_t i = 0;
 
+   if (type == FIT_FIT_BASE_TYPE_BYTE)
+      return &compact_bytes2base[bytes_format];
+
+   if (real_floats) {
+      for (i = 0; i < sizeof(real_float2base)/sizeof(real_float2base[0]); i++) {
+         if (real_float2base[i].base_type == type)
+            return &real_float2base[i];
+      }
+   }
+
 	for (i = 0; i < FIT_FIT_BASE_TYPE_COUNT; i++) {
 		if (str2base[i].base_type == type)
 			return &str2base[i];
@@ -207,26 +491,227 @@ _base_type_to_value *get_type_2base (FIT_FIT_BASE_TYPE type) {
 }
 
 
-// get input line definition
-static int32_t get_line_def (int8_t *tok) {
+// set element size and invalid value of field encoder. fields of unknown base types, or with size that is
+// not a multiple of their element size, are bytes
+static void set_encoder_invalid (_field_encoder *enc_p, FIT_FIT_BASE_TYPE base_type) {
+   if (!fit_encoder_base_type(base_type, enc_p->size, &enc_p->t_size, &enc_p->invalid)) {
+      enc_p->t_size = sizeof(uint8_t);
+      enc_p->invalid = FIT_BYTE_INVALID;
+   }
+}
+
+// write invalid value to all field elements
+static void set_invalid (const _field_encoder *enc_p, uint8_t *val) {
+   int32_t i;
+
+   for (i = 0; i < enc_p->size; i += enc_p->t_size)
+      memcpy(val + i, &enc_p->invalid, enc_p->t_size);
+}
+
+/****************************************************/
+/* CSV line tokenizer                               */
+/* lines are parsed in place, in the mapped CSV     */
+/* text or pipe buffer. tokens are spans of line,   */
+/* they are not 0 terminated and have no length cap */
+/****************************************************/
+
+// CSV values delimitors. empty values are skipped, the way strtok() did
+static inline bool is_delim (int8_t c) {
+   return (c == ':') || (c == ',') || (c == '\n');
+}
+
+// return end of line starting at line (position of '\n' or end of text)
+static const int8_t *find_line_end (const int8_t *line, const int8_t *end) {
+   const int8_t *eol;
+
+   if ((eol = memchr(line, '\n', end - line)) == NULL)
+      return end;
+   return eol;
+}
+
+// end of token starting at p: first delimitor in [p, end), or end. comma_only - only ',' ends it (compact
+// DATA lines). vector variants load whole vectors while they are inside the CSV text, even past end
+static const int8_t *scan_generic (const int8_t *p, const int8_t *end, bool comma_only) {
+   if (comma_only) {
+      while ((p < end) && (*p != ','))
+         p++;
+   }
+   else {
+      while ((p < end) && !is_delim(*p))
+         p++;
+   }
+   return p;
+}
+
+#ifdef FIT_CPU_X86
+
+__attribute__((target("sse4.2")))
+static const int8_t *scan_sse42 (const int8_t *p, const int8_t *end, bool comma_only) {
+   const int8_t *text_end = csv_text + csv_len;
+   __m128i v, delims;
+   uint32_t mask;
+
+   for (; (p < end) && (p + sizeof(v) <= text_end); p += sizeof(v)) {
+      v = _mm_loadu_si128((const __m128i *)p);
+      delims = _mm_cmpeq_epi8(v, _mm_set1_epi8(','));
+      if (!comma_only)
+         delims = _mm_or_si128(delims, _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+      if ((mask = _mm_movemask_epi8(delims)) != 0)
+         return (p + __builtin_ctz(mask) < end) ? p + __builtin_ctz(mask) : end;
+   }
+   return (p < end) ? scan_generic(p, end, comma_only) : end;
+}
+
+__attribute__((target("avx2")))
+static const int8_t *scan_avx2 (const int8_t *p, const int8_t *end, bool comma_only) {
+   const int8_t *text_end = csv_text + csv_len;
+   __m256i v, delims;
+   uint32_t mask;
+
+   for (; (p < end) && (p + sizeof(v) <= text_end); p += sizeof(v)) {
+      v = _mm256_loadu_si256((const __m256i *)p);
+      delims = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','));
+      if (!comma_only)
+         delims = _mm256_or_si256(delims, _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+      if ((mask = _mm256_movemask_epi8(delims)) != 0)
+         return (p + __builtin_ctz(mask) < end) ? p + __builtin_ctz(mask) : end;
+   }
+   return (p < end) ? scan_sse42(p, end, comma_only) : end;
+}
+
+__attribute__((target("avx512f,avx512bw,avx2")))
+static const int8_t *scan_avx512 (const int8_t *p, const int8_t *end, bool comma_only) {
+   const int8_t *text_end = csv_text + csv_len;
+   __m512i v;
+   uint64_t mask;
+
+   for (; (p < end) && (p + sizeof(v) <= text_end); p += sizeof(v)) {
+      v = _mm512_loadu_si512(p);
+      mask = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(','));
+      if (!comma_only)
+         mask |= _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(':')) | _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8('\n'));
+      if (mask != 0)
+         return (p + __builtin_ctzll(mask) < end) ? p + __builtin_ctzll(mask) : end;
+   }
+   return (p < end) ? scan_avx2(p, end, comma_only) : end;
+}
 
-   if (tok != NULL) {
-      if (strcmp (tok, "DATA") == 0)
-         return _FIT_DATA;
-      if (strcmp(tok, "DEF") == 0)
-         return _FIT_DEF;
-      if (strcmp(tok, "FIT_PROTOCOL_VERSION") == 0)
-         return _FIT_PROTOCOL_VERSION;
-      if (strcmp (tok, "FIT_PROFILE_VERSION") == 0)
-         return _FIT_PROFILE_VERSION;
-      if (strcmp (tok, "END") == 0)
-         return _FIT_END;
+#endif // FIT_CPU_X86
+
+static const int8_t *(*scan_token)(const int8_t *p, const int8_t *end, bool comma_only) = scan_generic;
+
+// select tokenizer variant by CPU level
+static void set_scan_token () {
+#ifdef FIT_CPU_X86
+   switch (fit_cpu_level()) {
+      case FIT_CPU_AVX512:
+         scan_token = scan_avx512;
+         break;
+      case FIT_CPU_AVX2:
+         scan_token = scan_avx2;
+         break;
+      case FIT_CPU_SSE42:
+         scan_token = scan_sse42;
+         break;
+      default:
+         scan_token = scan_generic;
    }
+#endif
+}
+
+// set line [line, end) to tokenize
+static void set_line (const int8_t *line, const int8_t *end) {
+   line_pos = line;
+   line_end = end;
+}
+
+// get next token of current line. return false if there are no more tokens
+static bool next_token () {
+   while ((line_pos < line_end) && is_delim(*line_pos))
+      line_pos++;
+   if (line_pos == line_end)
+      return false;
+
+   token = line_pos;
+   line_pos = scan_token(line_pos, line_end, false);
+   token_len = line_pos - token;
+
+   return true;
+}
+
+// compact DATA lines: read next value, up to next ','. empty values are values too.
+// line_pos is at the ',' that ends the previous value. return false at end of line
+static bool next_cell () {
+   if (line_pos >= line_end)
+      return false;
+   if (*line_pos == ',')
+      line_pos++;
+
+   token = line_pos;
+   line_pos = scan_token(line_pos, line_end, true);
+   token_len = line_pos - token;
+
+   // CSV files edited on windows end lines with \r
+   if ((line_pos == line_end) && token_len && (token[token_len-1] == '\r'))
+      token_len--;
+   return true;
+}
+
+// check if token is word
+static bool token_is (const int8_t *word) {
+   return (token_len == strlen(word)) && (memcmp(token, word, token_len) == 0);
+}
+
+// remove white spaces around token (CSV files edited on windows end lines with \r)
+static void trim_token () {
+   while (token_len && ((*token == ' ') || (*token == '\t'))) {
+      token++;
+      token_len--;
+   }
+   while (token_len && ((token[token_len-1] == ' ') || (token[token_len-1] == '\t') || (token[token_len-1] == '\r')))
+      token_len--;
+}
+
+// set the reason current line could not be processed. always return false
+static bool set_line_err (const int8_t *format, ...) {
+   va_list args;
+
+   va_start(args, format);
+   vsnprintf(line_err, sizeof(line_err), format, args);
+   va_end(args);
+   return false;
+}
+
+// get input line definition from first token of line
+static int32_t get_line_def () {
+
+   if (!next_token())
+      return _FIT_NONE;
+
+   if (token_is("DATA"))
+      return _FIT_DATA;
+   if (token_is("DEF"))
+      return _FIT_DEF;
+   if (token_is("FIT_PROTOCOL_VERSION"))
+      return _FIT_PROTOCOL_VERSION;
+   if (token_is("FIT_PROFILE_VERSION"))
+      return _FIT_PROFILE_VERSION;
+   if (token_is("END"))
+      return _FIT_END;
+   if (token_is("FIT_CSV_FORMAT"))
+      return _FIT_CSV_FORMAT;
 
    return _FIT_NONE;
 }
 
 
+// check if line is a DEF line, the same way get_line_def() sees its first token
+static bool is_def_line (const int8_t *line, const int8_t *end) {
+   while ((line < end) && is_delim(*line))
+      line++;
+   return (end - line >= 3) && (memcmp(line, "DEF", 3) == 0) && ((end - line == 3) || is_delim(line[3]));
+}
+
 // write FIT file header. This function must be called at the beginnig and end of the program
 bool WriteFileHeader(FIT_FILE_HDR *file_header)
 {
@@ -242,34 +727,388 @@ bool WriteFileHeader(FIT_FILE_HDR *file_header)
    }
 }
 
+/****************************************************/
+/* --verify-against: compare encoded FIT data with  */
+/* a reference FIT file in large blocks             */
+/****************************************************/
+
+// compare block of FIT data with next bytes of reference FIT data. first difference is kept
+static void compare_block (const uint8_t *buf, size_t len, FIT_UINT32 offset) {
+   size_t n;
+   size_t i;
+
+   if (verify->diff)
+      return;
+
+   n = (len < verify->ref_data_left) ? len : verify->ref_data_left;
+   n = fread(verify->ref_buf, 1, n, verify->ref_f);
+   verify->ref_data_left -= n;
+   if ((n == len) && (memcmp(buf, verify->ref_buf, len) == 0))
+      return;
+
+   // reference data is different or ends inside block
+   for (i = 0; (i < n) && (buf[i] == verify->ref_buf[i]); i++)
+      ;
+   verify->diff = true;
+   verify->diff_offset = offset + i;
+}
+
+// verify thread: compare blocks handed by encoding thread until there are no more blocks
+static void *verify_blocks (void *arg) {
+   pthread_mutex_lock(&verify->lock);
+   for (;;) {
+      while (!verify->pending && !verify->stop)
+         pthread_cond_wait(&verify->cond, &verify->lock);
+      if (!verify->pending)
+         break;
+      pthread_mutex_unlock(&verify->lock);
+      compare_block(verify->job, verify->job_len, verify->job_offset);
+      pthread_mutex_lock(&verify->lock);
+      verify->pending = false;
+      pthread_cond_signal(&verify->cond);
+   }
+   pthread_mutex_unlock(&verify->lock);
+   return NULL;
+}
+
+// compare staged block, or hand it to verify thread and fill the other block
+static void flush_stage () {
+   if (verify->fill_len == 0)
+      return;
+
+   if (verify->threaded) {
+      pthread_mutex_lock(&verify->lock);
+      while (verify->pending)
+         pthread_cond_wait(&verify->cond, &verify->lock);
+      verify->job = verify->stage[verify->fill];
+      verify->job_len = verify->fill_len;
+      verify->job_offset = verify->staged;
+      verify->pending = true;
+      pthread_cond_signal(&verify->cond);
+      pthread_mutex_unlock(&verify->lock);
+      verify->fill ^= 1;
+   }
+   else
+      compare_block(verify->stage[verify->fill], verify->fill_len, verify->staged);
+
+   verify->staged += verify->fill_len;
+   verify->fill_len = 0;
+}
+
+// stage FIT data written to FIT file for comparison
+static void verify_write (const uint8_t *buf, size_t size) {
+   size_t n;
+
+   while (size > 0) {
+      n = VERIFY_BLOCK_SIZE - verify->fill_len;
+      if (n > size)
+         n = size;
+      memcpy(verify->stage[verify->fill] + verify->fill_len, buf, n);
+      verify->fill_len += n;
+      buf += n;
+      size -= n;
+      if (verify->fill_len == VERIFY_BLOCK_SIZE)
+         flush_stage();
+   }
+}
+
+// open reference FIT file and start verify thread
+static bool verify_open (const int8_t *file_name, bool threaded) {
+   FIT_UINT32 ref_data_size;
+
+   if ((verify = calloc(1, sizeof(_verifier))) == NULL) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      return false;
+   }
+   if ((verify->ref_f = fopen(file_name, "rb")) == NULL) {
+      fprintf(stderr, "Failed to open reference FIT file: %s, %s\n", file_name, strerror(errno));
+      return false;
+   }
+   if ((fread(verify->ref_hdr, 1, FIT_FILE_HDR_SIZE, verify->ref_f) < FIT_FILE_HDR_SIZE) ||
+       (memcmp(verify->ref_hdr + 8, ".FIT", 4) != 0)) {
+      fprintf(stderr, "Reference file %s is not a FIT file\n", file_name);
+      return false;
+   }
+   // reference data starts after its own header size
+   memcpy(&ref_data_size, verify->ref_hdr + 4, sizeof(ref_data_size));
+   verify->ref_data_left = ref_data_size;
+   if (fseek(verify->ref_f, verify->ref_hdr[0], SEEK_SET) != 0) {
+      fprintf(stderr, "Failed to read reference FIT file: %s, %s\n", file_name, strerror(errno));
+      return false;
+   }
+
+   if (((verify->ref_buf = malloc(VERIFY_BLOCK_SIZE)) == NULL) || ((verify->stage[0] = malloc(VERIFY_BLOCK_SIZE)) == NULL) ||
+       ((verify->stage[1] = malloc(VERIFY_BLOCK_SIZE)) == NULL)) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      return false;
+   }
+
+   // if verify thread can not be started, blocks are compared by encoding thread
+   if (threaded) {
+      pthread_mutex_init(&verify->lock, NULL);
+      pthread_cond_init(&verify->cond, NULL);
+      verify->threaded = (pthread_create(&verify->thread, NULL, &verify_blocks, NULL) == 0);
+   }
+   return true;
+}
+
+// wait for verify thread to compare all blocks
+static void verify_stop () {
+   if ((verify == NULL) || !verify->threaded)
+      return;
+   pthread_mutex_lock(&verify->lock);
+   verify->stop = true;
+   pthread_cond_signal(&verify->cond);
+   pthread_mutex_unlock(&verify->lock);
+   pthread_join(verify->thread, NULL);
+   verify->threaded = false;
+}
+
+static void verify_close () {
+   if (verify == NULL)
+      return;
+   verify_stop();
+   if (verify->ref_f != NULL)
+      fclose(verify->ref_f);
+   free(verify->ref_buf);
+   free(verify->stage[0]);
+   free(verify->stage[1]);
+   free(verify);
+   verify = NULL;
+   free(file_index.pos);
+}
+
+// add start of next record to records index
+static bool index_record () {
+   _rec_pos *p;
+
+   if (rec_index == NULL)
+      return true;
+   if (rec_index->count == rec_index->size) {
+      if ((p = realloc(rec_index->pos, (rec_index->size + 4096) * sizeof(_rec_pos))) == NULL)
+         return false;
+      rec_index->pos = p;
+      rec_index->size += 4096;
+   }
+   rec_index->pos[rec_index->count].offset = fit_data_write;
+   rec_index->pos[rec_index->count].line = line_num;
+   rec_index->count++;
+   return true;
+}
+
+// append chunk records to file records index, chunk starts at FIT data offset base
+static bool index_chunk (_rec_index *index, FIT_UINT32 base) {
+   _rec_pos *p;
+   int32_t i;
+
+   if ((p = realloc(file_index.pos, (file_index.count + index->count) * sizeof(_rec_pos))) == NULL)
+      return false;
+   file_index.pos = p;
+   for (i = 0; i < index->count; i++) {
+      p[file_index.count + i].offset = index->pos[i].offset + base;
+      p[file_index.count + i].line = index->pos[i].line;
+   }
+   file_index.count += index->count;
+   file_index.size = file_index.count;
+   return true;
+}
+
+// find record holding FIT data offset
+static _rec_pos *find_record (FIT_UINT32 offset) {
+   int32_t lo = 0;
+   int32_t hi = file_index.count - 1;
+   int32_t mid;
+
+   if ((hi < 0) || (offset < file_index.pos[0].offset))
+      return NULL;
+   while (lo < hi) {
+      mid = (lo + hi + 1) / 2;
+      if (file_index.pos[mid].offset <= offset)
+         lo = mid;
+      else
+         hi = mid - 1;
+   }
+   return &file_index.pos[lo];
+}
+
+// compare whole FIT file with reference after FIT file is complete
+// return true if FIT file is identical to reference
+static bool verify_finish (const FIT_FILE_HDR *hdr, FIT_UINT16 file_crc) {
+   _rec_pos *rec_p;
+   FIT_UINT32 ref_data_size;
+   FIT_UINT16 ref_crc;
+   int32_t i;
+
+   flush_stage();
+   verify_stop();
+
+   // reference has more data than FIT file
+   memcpy(&ref_data_size, verify->ref_hdr + 4, sizeof(ref_data_size));
+   if (!verify->diff && (ref_data_size > hdr->data_size)) {
+      verify->diff = true;
+      verify->diff_offset = hdr->data_size;
+   }
+
+   if (verify->diff) {
+      if ((rec_p = find_record(verify->diff_offset)) != NULL)
+         fprintf(stderr, "FIT file differs from reference: first difference at byte offset %u, in record at byte offset %u of CSV line %d\n",
+               FIT_FILE_HDR_SIZE + verify->diff_offset, FIT_FILE_HDR_SIZE + rec_p->offset, rec_p->line);
+      else
+         fprintf(stderr, "FIT file differs from reference: first difference at byte offset %u\n", FIT_FILE_HDR_SIZE + verify->diff_offset);
+      return false;
+   }
+
+   // records are identical, check file header and file CRC
+   for (i = 0; (i < FIT_FILE_HDR_SIZE) && (((const uint8_t *)hdr)[i] == verify->ref_hdr[i]); i++)
+      ;
+   if (i < FIT_FILE_HDR_SIZE) {
+      fprintf(stderr, "FIT file differs from reference: file header differs at byte offset %d\n", i);
+      return false;
+   }
+   if ((fread(&ref_crc, 1, sizeof(ref_crc), verify->ref_f) < sizeof(ref_crc)) || (ref_crc != file_crc)) {
+      fprintf(stderr, "FIT file differs from reference: file CRC differs at byte offset %u\n", FIT_FILE_HDR_SIZE + hdr->data_size);
+      return false;
+   }
+
+   return true;
+}
+
+// append data to memory output. return number of bytes written
+static int32_t mem_write (_out_buf *out, void *buf, int32_t size) {
+   size_t new_size;
+   uint8_t *p;
+
+   if (out->len + size > out->size) {
+      new_size = (out->size > 0) ? out->size * 2 : 64*1024;
+      while (new_size < out->len + size)
+         new_size *= 2;
+      if ((p = realloc(out->buf, new_size)) == NULL)
+         return 0;
+      out->buf = p;
+      out->size = new_size;
+   }
+   memcpy(out->buf + out->len, buf, size);
+   out->len += size;
+
+   return size;
+}
+
 // write data to FIT file
 // update global varibles: crc, fit_data_write
 int32_t fit_write (void *buf, int32_t size) {
    int32_t i;
 
-   if ((i = fwrite(buf, 1, size, fit_f)) < size) {
+   if (out_mem != NULL)
+      i = mem_write(out_mem, buf, size);
+   else
+      i = fwrite(buf, 1, size, fit_f);
+
+   if (i < size) {
       fprintf(stderr, "Failed to write to FIT file, wrote %d bytes instead of %d, %s\n", i, size, strerror(errno));
       i = -1;
    }
    else {
-      crc = FitCRC_Update16(crc, buf, size);
+      if ((out_mem == NULL) && (verify != NULL))
+         verify_write(buf, size);
+      crc = fit_crc16_update(crc, buf, size);
       fit_data_write += size;
    }
 
    return i;   
 }
 
-void print_def_mesg(uint8_t mesg_type) {
+/****************************************************/
+/* --optimize-defs: definition records are written  */
+/* only before the first DATA line that needs them  */
+/* and FIT local message types are reassigned by    */
+/* LRU instead of using CSV M_TYPE values           */
+/****************************************************/
+
+// get FIT local message type holding plan definition, and write plan definition record if it takes a new one.
+// local message types are assigned by fit_writer_get_slot(), the way fit_writer_mesg() assigns them
+// return local message type, -1 if definition record could not be written
+static int32_t get_slot (_encode_plan *plan_p, bool ct) {
+   uint8_t rec_hdr = plan_p->def_rec[0] & ~FIT_HDR_TYPE_MASK;
+   bool new_def;
+   int32_t s;
+
+   s = fit_writer_get_slot(&out_slots, plan_p->def_rec+1, plan_p->def_rec_len-1, (rec_hdr & FIT_HDR_DEV_DATA_BIT) != 0, ct, &new_def);
+   if (!new_def)
+      return s;
+
+   // write definition record with its new local message type
+   rec_hdr |= s;
+   if (!index_record() || (fit_write(&rec_hdr, 1) < 1) || (fit_write(plan_p->def_rec+1, plan_p->def_rec_len-1) < plan_p->def_rec_len-1))
+      return -1;
+   def_recs_count++;
+   return s;
+}
+
+/****************************************************/
+/* --compress-timestamps: records whose timestamp   */
+/* is less than 32 seconds after the last one are   */
+/* written with compressed timestamp header and a   */
+/* definition without timestamp field               */
+/****************************************************/
+
+// update last timestamp from compressed timestamp header offset, the way FIT reader does
+static void ct_offset_to_ts (FIT_UINT8 time_offset) {
+   time_offset &= FIT_HDR_TIME_OFFSET_MASK;
+   if (!last_ts_valid)
+      return;
+   if (time_offset < (last_ts & FIT_HDR_TIME_OFFSET_MASK))
+      last_ts += FIT_HDR_TIME_OFFSET_MASK + 1;
+   last_ts = (last_ts & ~FIT_HDR_TIME_OFFSET_MASK) | time_offset;
+}
+
+// make plan of same definition without timestamp field (no field encoders, records are encoded by plan_p)
+static _encode_plan *make_ct_plan (_encode_plan *plan_p) {
+   _encode_plan *ct_plan_p;
    int32_t i;
+   int32_t field_off;                              // timestamp field definition offset in definition record
+   int32_t def_off = 1 + sizeof(_fit_fixed_mesg_def);
+
+   if ((ct_plan_p = calloc(1, sizeof(_encode_plan))) == NULL)
+      return NULL;
+   if ((ct_plan_p->def_rec = malloc(plan_p->def_rec_len - sizeof(FIT_FIELD_DEF))) == NULL) {
+      free(ct_plan_p);
+      return NULL;
+   }
 
-   fprintf(stderr, "DEF:M_TYPE,%d,FIELDS,%d,DEV_FIELDS,%d,,", mesg_type, mesg_type_def[mesg_type]->num_fields, mesg_type_def[mesg_type]->num_dev_fields);
-   for (i = 0; i < mesg_type_def[mesg_type]->num_fields; i++)
-      fprintf(stderr, "%d,%d,%d,,", mesg_type_def[mesg_type]->fields[i].field_def_num, mesg_type_def[mesg_type]->fields[i].size, mesg_type_def[mesg_type]->fields[i].base_type);
+   for (i = 0; plan_p->mesg_def->fields[i].field_def_num != TIMESTAMP_FIELD; i++)
+      ;
+   field_off = def_off + i * sizeof(FIT_FIELD_DEF);
 
-   for (i = 0; i < mesg_type_def[mesg_type]->num_dev_fields; i++)
-      fprintf(stderr, "%d,%d,%d,,", mesg_type_def[mesg_type]->dev_fields[i].def_num, mesg_type_def[mesg_type]->dev_fields[i].size, mesg_type_def[mesg_type]->dev_fields[i].dev_index);
+   memcpy(ct_plan_p->def_rec, plan_p->def_rec, field_off);
+   memcpy(ct_plan_p->def_rec + field_off, plan_p->def_rec + field_off + sizeof(FIT_FIELD_DEF), plan_p->def_rec_len - field_off - sizeof(FIT_FIELD_DEF));
+   ct_plan_p->def_rec[def_off-1]--;                // number of fields
+   ct_plan_p->def_rec_len = plan_p->def_rec_len - sizeof(FIT_FIELD_DEF);
+   ct_plan_p->data_mesg_len = plan_p->data_mesg_len - sizeof(FIT_UINT32);
+   ct_plan_p->mesg_type = plan_p->mesg_type;
+   ct_plan_p->ts_offset = -1;
 
-   fprintf(stderr, "\n");
+   plan_p->ct_plan = ct_plan_p;
+   return ct_plan_p;
+}
+
+// check if record timestamp can be replaced by compressed timestamp header. records of a definition that
+// is not held by local message types 0-3 are compressed only in a run of records, so that a single record
+// does not evict another compressed definition.
+// return plan of definition without timestamp field, NULL if timestamp must be kept
+static _encode_plan *get_ct_plan (_encode_plan *plan_p, FIT_UINT32 ts) {
+   _encode_plan *ct_plan_p = plan_p->ct_plan;
+
+   if (!last_ts_valid || (ts == TIMESTAMP_INVALID) || (ts < last_ts) || (ts - last_ts > FIT_HDR_TIME_OFFSET_MASK))
+      return NULL;
+
+   if ((plan_p != last_data_plan) &&
+       ((ct_plan_p == NULL) || (fit_writer_find_slot(&out_slots, ct_plan_p->def_rec+1, ct_plan_p->def_rec_len-1, (ct_plan_p->def_rec[0] & FIT_HDR_DEV_DATA_BIT) != 0, FIT_WRITER_CT_SLOTS) < 0)))
+      return NULL;
+
+   if (ct_plan_p == NULL)
+      ct_plan_p = make_ct_plan(plan_p);
+
+   return ct_plan_p;
 }
 
 // process line as DATA line
@@ -280,101 +1119,224 @@ void print_def_mesg(uint8_t mesg_type) {
 bool process_data_line() {
    FIT_UINT8 mesg_type;
    FIT_UINT8  time_rec_bit;
-   FIT_UINT8  time_offset;
-   int32_t wbuf_off;                               // offset into write buffer
-   _fit_mesg_def *mesg_def_p;
-   _base_type_to_value *base_type_p;
+   FIT_UINT8  time_offset = 0;
+   uint8_t *data_p;                                // data record values (after record header)
+   _encode_plan *plan_p;
+   _encode_plan *rec_plan_p;                       // plan of definition record is written with
+   _encode_plan *ct_plan_p;
+   _field_encoder *enc_p;
+   FIT_UINT32 ts;
+   int32_t slot;
    int32_t i;
 
-   // init variables
-   wbuf_off = 1;     // wbuf[0] is record header;
-   wbuf[0] = 0;
- 
    // get compress time bit
-   token = strtok(NULL, delim);
-   if (strcmp(token, "CT") != 0)
-      return false;
-   token = strtok(NULL, delim);
-   if (token == NULL)
-      return false;
-   to_uint8(token, &time_rec_bit, 1);
+   if (!next_token() || !token_is("CT"))
+      return set_line_err("missing CT");
+   if (!next_token() || (to_uint8(token, token_len, &time_rec_bit, 1) < 1))
+      return set_line_err("missing or invalid CT value");
 
    // get message type title, M_TYPE..
    // token == "M_TYPE" otherewise -> error
-   token = strtok(NULL, delim);
-   if (strcmp(token, "M_TYPE") != 0)
-      return false;
+   if (!next_token() || !token_is("M_TYPE"))
+      return set_line_err("missing M_TYPE");
    // get message type value
-   token = strtok(NULL, delim);
-   if (token == NULL)
-      return false;
-   to_uint8(token, (uint8_t *)&mesg_type, 1);
-
-   // check if mesg_type_def[mesg_type] exists
-   if (mesg_type_def[mesg_type] == NULL)
-      return false;
+   if (!next_token())
+      return set_line_err("missing M_TYPE value");
+   if (to_uint8(token, token_len, (uint8_t *)&mesg_type, 1) < 1 || mesg_type > FIT_HDR_TYPE_MASK)
+      return set_line_err("invalid M_TYPE value \"%.*s\"", token_len, token);
+
+   // check if mesg_type_plan[mesg_type] exists
+   if (mesg_type_plan[mesg_type] == NULL)
+      return set_line_err("M_TYPE %d was not defined by a DEF line", mesg_type);
    else
-      mesg_def_p = mesg_type_def[mesg_type];
+      plan_p = mesg_type_plan[mesg_type];
+
+   // compact lines are read value by value: M_TYPE value is followed by an empty value, the time offset
+   // value (empty if time_rec_bit is not set) and another empty value
+   if (compact && (!next_cell() || !next_cell()))
+      return set_line_err("missing time offset");
 
    // set record header.
    // if time_rec_bit is set, next token is the time_offset value that is part of record header
    if (time_rec_bit) {
-      token = strtok(NULL, delim);
-      if (token == NULL)
-         return false;
-      to_uint8(token, (uint8_t *)&time_offset, 1);
+      if ((!compact && !next_token()) || (to_uint8(token, token_len, (uint8_t *)&time_offset, 1) < 1))
+         return set_line_err("missing or invalid time offset");
+
+      //set reac header
+      wbuf[0] = FIT_HDR_TIME_REC_BIT;
+      wbuf[0] |= (mesg_type & 0x3) << FIT_HDR_TIME_TYPE_SHIFT;
+      wbuf[0] |= time_offset & FIT_HDR_TIME_OFFSET_MASK;
+   }
+   else
+      // simple data record
+      wbuf[0] = plan_p->rec_hdr;
+
+   // scan all field and dev_field values and add their binary values to wbuf using the plan encoders
+   data_p = wbuf + 1;
+   enc_p = plan_p->encoders;
+   if (compact) {
+      if (!next_cell())
+         return set_line_err("missing values");
+      for (i = 0; i < plan_p->num_encoders; i++, enc_p++) {
+         if (!next_cell())
+            return set_line_err("%d values instead of %d", i, plan_p->num_encoders);
+
+         // empty value is the invalid value of field base type
+         if (token_len == 0)
+            set_invalid(enc_p, data_p + enc_p->offset);
+         else if (enc_p->str_to_val(token, token_len, data_p + enc_p->offset, enc_p->size) < 1)
+            return set_line_err("invalid value \"%.*s\" of field %d", token_len, token, i+1);
+      }
+      // only the empty value after the last ',' may follow
+      while (next_cell()) {
+         if (token_len > 0)
+            return set_line_err("more than %d values", plan_p->num_encoders);
+      }
+   }
+   else {
+      for (i = 0; i < plan_p->num_encoders; i++, enc_p++) {
+         if (!next_token())
+            return set_line_err("%d values instead of %d", i, plan_p->num_encoders);
+
+         if (enc_p->str_to_val(token, token_len, data_p + enc_p->offset, enc_p->size) < 1)
+            return set_line_err("invalid value \"%.*s\" of field %d", token_len, token, i+1);
+      }
+      if (next_token())
+         return set_line_err("more than %d values", plan_p->num_encoders);
+   }
+
+   // set record header local message type to the one holding plan definition
+   rec_plan_p = plan_p;
+   if (optimize_defs) {
+      if (time_rec_bit)
+         ct_offset_to_ts(time_offset);
+      else if (plan_p->ts_offset >= 0) {
+         memcpy(&ts, data_p + plan_p->ts_offset, sizeof(ts));
+         if (compress_ts && ((ct_plan_p = get_ct_plan(plan_p, ts)) != NULL)) {
+            // drop timestamp field value from record
+            memmove(data_p + plan_p->ts_offset, data_p + plan_p->ts_offset + sizeof(ts), plan_p->data_mesg_len - plan_p->ts_offset - sizeof(ts));
+            time_rec_bit = 1;
+            time_offset = ts & FIT_HDR_TIME_OFFSET_MASK;
+            rec_plan_p = ct_plan_p;
+            ts_compressed_count++;
+         }
+         if (ts != TIMESTAMP_INVALID) {
+            last_ts = ts;
+            last_ts_valid = true;
+         }
+      }
+      last_data_plan = plan_p;
+
+      if ((slot = get_slot(rec_plan_p, time_rec_bit)) < 0)
+         return set_line_err("failed to write definition record");
+      if (time_rec_bit)
+         wbuf[0] = FIT_HDR_TIME_REC_BIT | (slot << FIT_HDR_TIME_TYPE_SHIFT) | (time_offset & FIT_HDR_TIME_OFFSET_MASK);
+      else
+         wbuf[0] = slot;
+   }
+
+   // write wbuf to FIT file
+   if (!index_record() || (fit_write(wbuf, rec_plan_p->data_mesg_len + 1) < rec_plan_p->data_mesg_len + 1))
+      return set_line_err("failed to write data record");
+
+   return true;
+}
+
+// FNV-1a hash of DEF line, used as encode plans cache key
+static uint32_t line_hash (const int8_t *line, int32_t len) {
+   uint32_t h = 2166136261u;
+
+   while (len--) {
+      h ^= (uint8_t)*line++;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+// look for a plan that was compiled from identical DEF line
+static _encode_plan *find_plan (const int8_t *line, int32_t len, uint32_t hash) {
+   _encode_plan *plan_p;
+
+   for (plan_p = plan_cache[hash & (PLAN_CACHE_SIZE-1)]; plan_p != NULL; plan_p = plan_p->next) {
+      if ((plan_p->hash == hash) && (plan_p->def_line_len == len) && (memcmp(plan_p->def_line, line, len) == 0))
+         return plan_p;
+   }
+   return NULL;
+}
+
+// set plan as current definition of its local message type and write its definition record
+static bool apply_plan (_encode_plan *plan_p) {
+   mesg_type_plan[plan_p->mesg_type] = plan_p;
+
+   // definition record is written when a DATA line needs it
+   if (optimize_defs) {
+      def_lines_count++;
+      return true;
+   }
+
+   // write definition record to FIT file
+   if (!index_record() || (fit_write(plan_p->def_rec, plan_p->def_rec_len) < plan_p->def_rec_len))
+      return set_line_err("failed to write definition record");
+
+   return true;
+}
+
+// compile new encode plan from message definition and definition record in wbuf
+static _encode_plan *compile_plan (uint8_t mesg_type, _fit_mesg_def *mesg_def_p, int32_t def_rec_len) {
+   _encode_plan *plan_p;
+   _base_type_to_value *base_type_p;
+   int32_t num_encoders = mesg_def_p->num_fields + mesg_def_p->num_dev_fields;
+   uint16_t offset = 0;
+   int32_t i;
 
-      //set reac header
-      wbuf[0] |= FIT_HDR_TIME_REC_BIT;
-      wbuf[0] |= (mesg_type & 0x3) << FIT_HDR_TIME_TYPE_SHIFT;
-      wbuf[0] |= time_offset & FIT_HDR_TIME_OFFSET_MASK;
-   }
-   else
-      // simple data record
-      wbuf[0] |= mesg_type & FIT_HDR_TYPE_MASK;
+   if ((plan_p = malloc(sizeof(_encode_plan) + num_encoders * sizeof(_field_encoder))) == NULL)
+      return NULL;
 
-   // scan all field values and add their binary values to wbuf according to their types
+   if ((plan_p->def_rec = malloc(def_rec_len)) == NULL) {
+      free(plan_p);
+      return NULL;
+   }
+   memcpy(plan_p->def_rec, wbuf, def_rec_len);
+   plan_p->def_rec_len = def_rec_len;
+   plan_p->mesg_def = mesg_def_p;
+   plan_p->mesg_type = mesg_type;
+   plan_p->rec_hdr = mesg_type & FIT_HDR_TYPE_MASK;
+   plan_p->num_encoders = num_encoders;
+   plan_p->def_line = NULL;
+   plan_p->next = NULL;
+   plan_p->ts_offset = -1;
+   plan_p->ct_plan = NULL;
+
+   // resolve fields encoders. unknown base types are handled as bytes (the way fit2csv prints them)
    for (i = 0; i < mesg_def_p->num_fields; i++) {
-      token = strtok(NULL, delim);
-      if (token == NULL)
-         return false;
-
-      base_type_p = get_type_2base(mesg_def_p->fields[i].base_type);      
-      if (base_type_p->str_to_val(token, wbuf+wbuf_off, mesg_def_p->fields[i].size) < 1)
-         return false;
-      
-      wbuf_off += mesg_def_p->fields[i].size;
+      base_type_p = get_type_2base(mesg_def_p->fields[i].base_type);
+      plan_p->encoders[i].str_to_val = (base_type_p != NULL) ? base_type_p->str_to_val : get_type_2base(FIT_FIT_BASE_TYPE_BYTE)->str_to_val;
+      plan_p->encoders[i].offset = offset;
+      plan_p->encoders[i].size = mesg_def_p->fields[i].size;
+      set_encoder_invalid(&plan_p->encoders[i], mesg_def_p->fields[i].base_type);
+      if ((mesg_def_p->fields[i].field_def_num == TIMESTAMP_FIELD) && (mesg_def_p->fields[i].size == sizeof(FIT_UINT32)))
+         plan_p->ts_offset = offset;
+      offset += mesg_def_p->fields[i].size;
    }
 
-   // scan all dev_field values and add their binary values to wbuf according to their types
-   base_type_p = get_type_2base(FIT_FIT_BASE_TYPE_BYTE);    
+   // dev fields are read like fields of their base type
    for (i = 0; i < mesg_def_p->num_dev_fields; i++) {
-      token = strtok(NULL, delim);
-      if (token == NULL)
-         return false;
- 
-      if (base_type_p->str_to_val(token, wbuf+wbuf_off, mesg_def_p->dev_fields[i].size) < 1)
-         return false;
-      
-      wbuf_off += mesg_def_p->dev_fields[i].size;
-   }
-
-   // write wbuf to FIT file
-   if (fit_write(wbuf, wbuf_off) < wbuf_off)
-      return false;
-
-#ifdef DEBUG
-   // check against check file
-   if (cmp_buff(wbuf_off)) {
-      fprintf(stderr, "Failed in process data line\n");
-      printf("[line: %d] ", line_num);
-      print_def_mesg(mesg_type);
+      base_type_p = get_type_2base(mesg_def_p->dev_base_types[i]);
+      plan_p->encoders[mesg_def_p->num_fields+i].str_to_val = (base_type_p != NULL) ? base_type_p->str_to_val : get_type_2base(FIT_FIT_BASE_TYPE_BYTE)->str_to_val;
+      plan_p->encoders[mesg_def_p->num_fields+i].offset = offset;
+      plan_p->encoders[mesg_def_p->num_fields+i].size = mesg_def_p->dev_fields[i].size;
+      set_encoder_invalid(&plan_p->encoders[mesg_def_p->num_fields+i], mesg_def_p->dev_base_types[i]);
+      offset += mesg_def_p->dev_fields[i].size;
    }
-#endif
+   plan_p->data_mesg_len = offset;
 
-   return true;
+   return plan_p;
 }
 
+// read next FIT_UINT8 value of field definition
+static bool next_def_value (FIT_UINT8 *val) {
+   return next_token() && (to_uint8(token, token_len, val, 1) > 0);
+}
 
 // process line as MESSAGE DEFINITION line
 // definition line includes the following fields:
@@ -385,16 +1347,22 @@ bool process_data_line() {
 // DEV_FIELDS value is FIT_UINT8
 // each field is FIT_FIELD_DEF
 // each dev_field is FIT_DEV_FIELD_DEF
-bool process_definition_line() {
+// "TYPED_DEV_FIELDS" instead of "DEV_FIELDS": each dev_field is FIT_DEV_FIELD_DEF followed by the base type
+// of its values (fit2csv writes described developer fields like fields of their base type)
+// def_line is a copy of the line text (len bytes) and hash is its line_hash()
+// the compiled plan is added to plans cache and returned, NULL if line could not be processed
+_encode_plan *process_definition_line(int8_t *def_line, int32_t len, uint32_t hash) {
    FIT_UINT8 mesg_type;
    FIT_UINT8 num_fields;
    FIT_UINT8 num_dev_fields;
-   FIT_UINT8 field_member;
    FIT_MESG_NUM global_mesg_num;
+   bool typed_dev_fields;
    int32_t i;
    int32_t wbuf_off;                               // offset into write buffer
    _fit_fixed_mesg_def fit_fixed_mesg_def;     // fixed portion of a definition message
    int32_t size;
+   _fit_mesg_def *mesg_def_p;
+   _encode_plan *plan_p;
 
    // init variables
    memset(&fit_fixed_mesg_def, 0, sizeof(fit_fixed_mesg_def));
@@ -403,48 +1371,53 @@ bool process_definition_line() {
 
    // get message type title, M_TYPE..
    // token == "M_TYPE" otherewise -> error
-   token = strtok(NULL, delim);
-   if (strcmp(token, "M_TYPE") != 0)
-      return false;
+   if (!next_token() || !token_is("M_TYPE")) {
+      set_line_err("missing M_TYPE");
+      return NULL;
+   }
 
    // get message type value
-   token = strtok(NULL, delim);
-   if (token == NULL)
-      return false;
-   to_uint8(token, (uint8_t *)&mesg_type, 1);
+   if (!next_token() || (to_uint8(token, token_len, (uint8_t *)&mesg_type, 1) < 1) || (mesg_type > FIT_HDR_TYPE_MASK)) {
+      set_line_err("missing or invalid M_TYPE value");
+      return NULL;
+   }
    wbuf[0] |= mesg_type & FIT_HDR_TYPE_MASK;  // set message type;
 
    // get global message number title
-   token = strtok(NULL, delim);
-   if (strcmp(token, "M_NUM") != 0)
-      return false;
+   if (!next_token() || !token_is("M_NUM")) {
+      set_line_err("missing M_NUM");
+      return NULL;
+   }
    //get global message number value
-   token = strtok(NULL, delim);
-   if (token == NULL)
-      return false;
-   to_uint16(token, (uint8_t *)&global_mesg_num, 2);
+   if (!next_token() || (to_uint16(token, token_len, (uint8_t *)&global_mesg_num, 2) < 1)) {
+      set_line_err("missing or invalid M_NUM value");
+      return NULL;
+   }
 
    // read number of fields title
-   token = strtok(NULL, delim);
-   if (strcmp(token, "FIELDS") != 0)
-      return false;
+   if (!next_token() || !token_is("FIELDS")) {
+      set_line_err("missing FIELDS");
+      return NULL;
+   }
 
    // read number of fields value
-   token = strtok(NULL, delim);
-   if (token == NULL)
-      return false;
-   to_uint8(token, (uint8_t *)&num_fields, 1);
+   if (!next_token() || (to_uint8(token, token_len, (uint8_t *)&num_fields, 1) < 1)) {
+      set_line_err("missing or invalid FIELDS value");
+      return NULL;
+   }
 
    // read number of dev fields number title
-   token = strtok(NULL, delim);
-   if (strcmp(token, "DEV_FIELDS") != 0)
-      return false;
+   if (!next_token() || !(token_is("DEV_FIELDS") || token_is("TYPED_DEV_FIELDS"))) {
+      set_line_err("missing DEV_FIELDS");
+      return NULL;
+   }
+   typed_dev_fields = token_is("TYPED_DEV_FIELDS");
 
    // read number of dev fields number value
-   token = strtok(NULL, delim);
-   if (token == NULL)
-      return false;
-   to_uint8(token, (uint8_t *)&num_dev_fields, 1);   
+   if (!next_token() || (to_uint8(token, token_len, (uint8_t *)&num_dev_fields, 1) < 1)) {
+      set_line_err("missing or invalid DEV_FIELDS value");
+      return NULL;
+   }
 
    fit_fixed_mesg_def.arch = 0;
    fit_fixed_mesg_def.reserved_1 = 0;
@@ -455,101 +1428,587 @@ bool process_definition_line() {
    memcpy(wbuf+wbuf_off, &fit_fixed_mesg_def, sizeof(fit_fixed_mesg_def));
    wbuf_off += sizeof(fit_fixed_mesg_def);
 
-   // save new message def in mesg_type_def, but first check if mesg_type is already in use
-   // if it does, release it
-   if (mesg_type_def[mesg_type] != NULL)
-      free(mesg_type_def[mesg_type]);
+   // calculate size of new message def and allocate it
+   size = sizeof(_fit_mesg_def) + num_fields * sizeof(FIT_FIELD_DEF) + num_dev_fields * (sizeof(FIT_DEV_FIELD_DEF) + sizeof(FIT_UINT8));
+   if ((mesg_def_p = malloc(size)) == NULL)
+      return NULL;
 
-   // calculate size of new mesg_type_def and allocate it
-   size = sizeof(_fit_mesg_def) + num_fields * sizeof(FIT_FIELD_DEF) + num_dev_fields * sizeof(FIT_DEV_FIELD_DEF);
-   if ((mesg_type_def[mesg_type] = malloc(size)) == NULL)
-      return false;
-
-   mesg_type_def[mesg_type]->num_dev_fields = num_dev_fields;
-   mesg_type_def[mesg_type]->num_fields = num_fields;
+   mesg_def_p->num_dev_fields = num_dev_fields;
+   mesg_def_p->num_fields = num_fields;
+   mesg_def_p->dev_fields = (FIT_DEV_FIELD_DEF *)&mesg_def_p->fields[num_fields];
+   mesg_def_p->dev_base_types = (FIT_UINT8 *)&mesg_def_p->dev_fields[num_dev_fields];
 
    // update record header dev data flag if there are dev fields
-   if (mesg_type_def[mesg_type]->num_dev_fields > 0)
+   if (mesg_def_p->num_dev_fields > 0)
       wbuf[0] |= FIT_HDR_DEV_DATA_BIT;
 
-   // now read all fields and message fields definitions into mesg_type_def[mesg_type]
+   // now read all fields and message fields definitions into mesg_def_p
    for (i = 0; i < num_fields; i++) {
-      token = strtok(NULL, delim);
-      if (token == NULL)
-         return false;
-      to_uint8(token, (uint8_t *)&mesg_type_def[mesg_type]->fields[i].field_def_num, 1);
-      token = strtok(NULL, delim);
-      if (token == NULL)
-         return false;
-      to_uint8(token, (uint8_t *)&mesg_type_def[mesg_type]->fields[i].size, 1);
-      token = strtok(NULL, delim);
-      if (token == NULL)
-         return false;
-      to_uint8(token, (uint8_t *)&mesg_type_def[mesg_type]->fields[i].base_type, 1);
+      if (!next_def_value(&mesg_def_p->fields[i].field_def_num) || !next_def_value(&mesg_def_p->fields[i].size) ||
+          !next_def_value(&mesg_def_p->fields[i].base_type)) {
+         set_line_err("missing or invalid definition of field %d", i+1);
+         goto def_error;
+      }
    }
 
    for (i = 0; i < num_dev_fields; i++) {
-      token = strtok(NULL, delim);
-      if (token == NULL)
-         return false;
-      to_uint8(token, (uint8_t *)&mesg_type_def[mesg_type]->dev_fields[i].def_num, 1);
-      token = strtok(NULL, delim);
-      if (token == NULL)
-         return false;
-      to_uint8(token, (uint8_t *)&mesg_type_def[mesg_type]->dev_fields[i].size, 1);
-      token = strtok(NULL, delim);
-      if (token == NULL)
-         return false;
-      to_uint8(token, (uint8_t *)&mesg_type_def[mesg_type]->dev_fields[i].dev_index, 1);
+      if (!next_def_value(&mesg_def_p->dev_fields[i].def_num) || !next_def_value(&mesg_def_p->dev_fields[i].size) ||
+          !next_def_value(&mesg_def_p->dev_fields[i].dev_index)) {
+         set_line_err("missing or invalid definition of dev field %d", i+1);
+         goto def_error;
+      }
+      mesg_def_p->dev_base_types[i] = FIT_FIT_BASE_TYPE_BYTE;
+      if (typed_dev_fields && !next_def_value(&mesg_def_p->dev_base_types[i])) {
+         set_line_err("missing or invalid base type of dev field %d", i+1);
+         goto def_error;
+      }
+   }
+
+   if (next_token()) {
+      set_line_err("more than %d fields definitions", num_fields + num_dev_fields);
+      goto def_error;
    }
 
    // update wbuf
-   size = mesg_type_def[mesg_type]->num_fields*sizeof(FIT_FIELD_DEF);
-   memcpy(wbuf+wbuf_off, &mesg_type_def[mesg_type]->fields, size);
+   size = mesg_def_p->num_fields*sizeof(FIT_FIELD_DEF);
+   memcpy(wbuf+wbuf_off, mesg_def_p->fields, size);
    wbuf_off += size;
 
    // if there are dev fields add them to wbuf
-   if (mesg_type_def[mesg_type]->num_dev_fields > 0) {
-      size = sizeof(mesg_type_def[mesg_type]->num_dev_fields);
-      memcpy(wbuf+wbuf_off, &mesg_type_def[mesg_type]->num_dev_fields, size);
+   if (mesg_def_p->num_dev_fields > 0) {
+      size = sizeof(mesg_def_p->num_dev_fields);
+      memcpy(wbuf+wbuf_off, &mesg_def_p->num_dev_fields, size);
       wbuf_off += size;
 
-      size = mesg_type_def[mesg_type]->num_dev_fields*sizeof(FIT_DEV_FIELD_DEF);
-      memcpy(wbuf+wbuf_off, &mesg_type_def[mesg_type]->dev_fields, size);
+      size = mesg_def_p->num_dev_fields*sizeof(FIT_DEV_FIELD_DEF);
+      memcpy(wbuf+wbuf_off, mesg_def_p->dev_fields, size);
       wbuf_off += size;
    }
 
-   // write wbuf to FIT file
-   if (fit_write(wbuf, wbuf_off) < wbuf_off)
-      return false;
+   // compile plan and add it to plans cache
+   if ((plan_p = compile_plan(mesg_type, mesg_def_p, wbuf_off)) == NULL) {
+      set_line_err("out of memory");
+      goto def_error;
+   }
+   plan_p->def_line = def_line;
+   plan_p->def_line_len = len;
+   plan_p->hash = hash;
+   plan_p->next = plan_cache[hash & (PLAN_CACHE_SIZE-1)];
+   plan_cache[hash & (PLAN_CACHE_SIZE-1)] = plan_p;
 
-#ifdef DEBUG
-   // check against check file
-   if (cmp_buff(wbuf_off)) {
-      fprintf(stderr, "Failed in process definition line\n");
-      print_def_mesg(mesg_type);
+   return plan_p;
+
+def_error:
+   free(mesg_def_p);
+   return NULL;
+}
+
+// get encode plan of DEF line [line, end). plan of identical DEF line that was already compiled is taken
+// from plans cache, otherwise the line is parsed, compiled and added to cache
+static _encode_plan *get_plan (const int8_t *line, const int8_t *end) {
+   int32_t len = end - line;
+   uint32_t hash;
+   int8_t *def_line;
+   _encode_plan *plan_p;
+
+   hash = line_hash(line, len);
+   if ((plan_p = find_plan(line, len, hash)) != NULL)
+      return plan_p;
+
+   // keep line text as cache key
+   if ((def_line = malloc(len)) == NULL) {
+      set_line_err("out of memory");
+      return NULL;
+   }
+   memcpy(def_line, line, len);
+
+   // skip "DEF" token
+   set_line(line, end);
+   next_token();
+   if ((plan_p = process_definition_line(def_line, len, hash)) == NULL)
+      free(def_line);
+
+   return plan_p;
+}
+
+// FIT_CSV_FORMAT line, it tells how fit2csv wrote the values. it changes the way DEF lines are compiled,
+// so it must come before them
+static bool set_csv_format () {
+   int32_t i;
+
+   for (i = 0; i <= FIT_HDR_TYPE_MASK; i++) {
+      if (mesg_type_plan[i] != NULL)
+         return set_line_err("FIT_CSV_FORMAT line must come before DEF lines");
+   }
+
+   while (next_token()) {
+      trim_token();
+      if (token_is("REAL_FLOATS"))
+         real_floats = true;
+      else if (token_is("HEX_BYTES"))
+         bytes_format = BYTES_HEX;
+      else if (token_is("BASE64_BYTES"))
+         bytes_format = BYTES_BASE64;
+      else if (token_is("COMPACT"))
+         compact = true;
+      else if (token_is("UNITS"))
+         return set_line_err("CSV file with physical units can not be converted back to FIT");
+      else if (token_len > 0)
+         return set_line_err("unknown CSV format \"%.*s\"", token_len, token);
+   }
+   return true;
+}
+
+// process single CSV line [line, end). version lines update hdr, unless hdr is NULL
+// return false if line could not be processed. line_def is set to the line definition
+// and line_err to the reason the line could not be processed
+static bool process_line (const int8_t *line, const int8_t *end, FIT_FILE_HDR *hdr) {
+   _encode_plan *plan_p;
+
+   line_num++;
+
+   // DEF lines are looked up in plans cache before they are parsed.
+   // identical DEF line that was already compiled is applied without parsing it again
+   if (is_def_line(line, end)) {
+      line_def = _FIT_DEF;
+      if ((plan_p = get_plan(line, end)) == NULL)
+         return false;
+      return apply_plan(plan_p);
+   }
+
+   set_line(line, end);
+   line_def = get_line_def();
+
+   switch (line_def) {
+      case _FIT_PROTOCOL_VERSION:
+         if (next_token() && (hdr != NULL))
+            to_uint8(token, token_len, (uint8_t *)&hdr->protocol_version, 1) ;
+         break;
+      case _FIT_PROFILE_VERSION:
+         if (next_token() && (hdr != NULL))
+            to_uint16(token, token_len, (uint8_t *)&hdr->profile_version, 2) ;
+         break;
+      case _FIT_CSV_FORMAT:
+         // in --jobs mode prescan_csv() set the format, worker threads (hdr is NULL) must not write it
+         return (hdr == NULL) || set_csv_format();
+      case _FIT_DATA:
+         return process_data_line();
+      default:
+         break;
+   }
+
+   return true;
+}
+
+static void print_line_error (int32_t line_def, int32_t line_num, int8_t *err_text) {
+   if (line_def == _FIT_DEF)
+      fprintf(stderr, "Error processing definition line %d: %s\n", line_num, err_text);
+   else if (line_def == _FIT_CSV_FORMAT)
+      fprintf(stderr, "Error processing format line %d: %s\n", line_num, err_text);
+   else
+      fprintf(stderr, "Error processing data line %d: %s\n", line_num, err_text);
+}
+
+// release all compiled plans of calling thread
+static void free_plans () {
+   int32_t i;
+   _encode_plan *plan_p;
+
+   for (i = 0; i < PLAN_CACHE_SIZE; i++) {
+      while ((plan_p = plan_cache[i]) != NULL) {
+         plan_cache[i] = plan_p->next;
+         free(plan_p->def_line);
+         free(plan_p->def_rec);
+         free(plan_p->mesg_def);
+         if (plan_p->ct_plan != NULL) {
+            free(plan_p->ct_plan->def_rec);
+            free(plan_p->ct_plan);
+         }
+         free(plan_p);
+      }
+   }
+   memset(mesg_type_plan, 0, sizeof(mesg_type_plan));
+}
+
+/****************************************************/
+/* CSV input: regular files are mapped to memory,   */
+/* pipes (and windows) are streamed through a       */
+/* buffer that grows to the longest line. --jobs    */
+/* mode reads whole pipe to memory to split it      */
+/****************************************************/
+
+// read whole CSV file (or pipe) into memory
+static int8_t *read_csv_text (FILE *f, size_t *len) {
+   int8_t *text = NULL;
+   int8_t *p;
+   size_t size = 0;
+   size_t n;
+
+   *len = 0;
+   do {
+      if (*len >= size) {
+         size = (size > 0) ? size * 2 : CSV_READ_SIZE;
+         if ((p = realloc(text, size)) == NULL) {
+            fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+            free(text);
+            return NULL;
+         }
+         text = p;
+      }
+      n = fread(text + *len, 1, size - *len, f);
+      *len += n;
+   } while (n > 0);
+
+   if (ferror(f)) {
+      fprintf(stderr, "Failed to read CSV file, %s\n", strerror(errno));
+      free(text);
+      return NULL;
+   }
+
+   return text;
+}
+
+// get CSV file text. map it if it is a regular file, otherwise read it if whole text is needed.
+// csv_text is left NULL if CSV file is to be streamed
+static bool load_csv_text (FILE *f, bool whole) {
+#ifndef _WIN32
+   struct stat st;
+   void *p;
+
+   if ((fstat(fileno(f), &st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0)) {
+      if ((p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(f), 0)) != MAP_FAILED) {
+#ifdef MADV_SEQUENTIAL
+         madvise(p, st.st_size, MADV_SEQUENTIAL);
+#endif
+         csv_text = p;
+         csv_len = st.st_size;
+         csv_mapped = true;
+         return true;
+      }
    }
 #endif
 
+   csv_mapped = false;
+   if (!whole)
+      return true;
+   return (csv_text = read_csv_text(f, &csv_len)) != NULL;
+}
+
+// release CSV file text
+static void free_csv_text () {
+#ifndef _WIN32
+   if (csv_mapped)
+      munmap(csv_text, csv_len);
+   else
+#endif
+      free(csv_text);
+   csv_text = NULL;
+}
+
+// encode CSV lines of [text, end) in order, until END line. last line has no '\n' only if text_done,
+// otherwise it is not complete yet. return start of first line not encoded (end if all were), NULL on error
+static const int8_t *encode_lines (const int8_t *text, const int8_t *end, bool text_done, FIT_FILE_HDR *hdr) {
+   const int8_t *line;
+   const int8_t *eol;
+
+   for (line = text; (line < end) && (line_def != _FIT_END); line = eol + 1) {
+      if ((eol = memchr(line, '\n', end - line)) == NULL) {
+         if (!text_done)
+            return line;
+         eol = end;
+      }
+      if (!process_line(line, eol, hdr)) {
+         print_line_error(line_def, line_num, line_err);
+         return NULL;
+      }
+   }
+
+   return (line < end) ? line : end;
+}
+
+// stream CSV lines from pipe in blocks, until END line. an incomplete last line is moved to buffer start
+// and the rest of it is read after it. buffer is doubled when a line does not fit in it
+static bool encode_stream (FILE *f, FIT_FILE_HDR *hdr) {
+   const int8_t *rest;
+   int8_t *p;
+   size_t size = CSV_READ_SIZE;
+   size_t n;
+   bool text_done = false;
+
+   if ((csv_text = malloc(size)) == NULL) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      return false;
+   }
+   csv_len = 0;
+
+   while (!text_done && (line_def != _FIT_END)) {
+      if (csv_len == size) {
+         if ((p = realloc(csv_text, size * 2)) == NULL) {
+            fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+            return false;
+         }
+         csv_text = p;
+         size *= 2;
+      }
+      if ((n = fread(csv_text + csv_len, 1, size - csv_len, f)) == 0) {
+         if (ferror(f)) {
+            fprintf(stderr, "Failed to read CSV file, %s\n", strerror(errno));
+            return false;
+         }
+         text_done = true;
+      }
+      csv_len += n;
+
+      if ((rest = encode_lines(csv_text, csv_text + csv_len, text_done, hdr)) == NULL)
+         return false;
+      csv_len = csv_text + csv_len - rest;
+      memmove(csv_text, rest, csv_len);
+   }
+
    return true;
 }
 
-// cleanup function 
-void cleanup () {
+// encode all CSV lines in order, until END line. lines are streamed from f if CSV text is not in memory
+static bool encode_sequential (FILE *f, FIT_FILE_HDR *hdr) {
+   if (csv_text != NULL) {
+      if (encode_lines(csv_text, csv_text + csv_len, true, hdr) == NULL)
+         return false;
+   }
+   else {
+      if (!encode_stream(f, hdr))
+         return false;
+   }
+
+   // check if we exit the loop due to _FIT_END. If not CSV file is not complete - exit with error
+   if (line_def != _FIT_END) {
+      fprintf(stderr, "CSV file must end with \"END,\" line. FIT file is not complete!\n");
+      return false;
+   }
+
+   return true;
+}
+
+/****************************************************/
+/* --jobs mode: encode CSV chunks in worker threads */
+/****************************************************/
+
+// DEF-only pre-scan: split CSV text to chunks at line boundaries and record for each chunk the DEF
+// lines in effect at its start. version lines are applied to hdr and text from END line on is dropped.
+// return false if there is no END line
+static bool prescan_csv (const int8_t *text, size_t len, int32_t jobs, FIT_FILE_HDR *hdr) {
+   const int8_t *def_lines[FIT_HDR_TYPE_MASK+1];
+   const int8_t *line;
+   const int8_t *eol;
+   const int8_t *end = text + len;
+   size_t chunk_size;
+   size_t chunk_end;
+   int32_t line_count = 0;
+   int32_t max_chunks;
+   int32_t i;
+   FIT_UINT8 mesg_type;
+   _csv_chunk *chunk_p = NULL;
+
+   chunk_size = len / (jobs * CHUNKS_PER_JOB);
+   if (chunk_size < MIN_CHUNK_SIZE)
+      chunk_size = MIN_CHUNK_SIZE;
+   max_chunks = len / chunk_size + 2;
+   if ((chunks = calloc(max_chunks, sizeof(_csv_chunk))) == NULL) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      return false;
+   }
+   num_chunks = 0;
+   memset(def_lines, 0, sizeof(def_lines));
+   chunk_end = 0;
+
+   for (line = text; line < end; line = eol + 1) {
+      // start new chunk on first line past current chunk size
+      if ((size_t)(line - text) >= chunk_end) {
+         if (chunk_p != NULL)
+            chunk_p->end = line;
+         chunk_p = &chunks[num_chunks++];
+         chunk_p->start = line;
+         chunk_p->first_line = line_count + 1;
+         memcpy(chunk_p->def_lines, def_lines, sizeof(def_lines));
+         chunk_end = (line - text) + chunk_size;
+      }
+      line_count++;
+      eol = find_line_end(line, end);
+
+      // DATA lines are most of the file, skip them without tokenizing
+      if ((eol - line >= 4) && (memcmp(line, "DATA", 4) == 0))
+         continue;
+
+      if (is_def_line(line, eol)) {
+         // DEF:M_TYPE,<mesg_type>,... remember line as the definition of mesg_type
+         set_line(line, eol);
+         next_token();
+         if (next_token() && token_is("M_TYPE") && next_token() && (to_uint8(token, token_len, &mesg_type, 1) > 0) &&
+             (mesg_type <= FIT_HDR_TYPE_MASK))
+            def_lines[mesg_type] = line;
+         continue;
+      }
+
+      set_line(line, eol);
+      switch (get_line_def()) {
+         case _FIT_PROTOCOL_VERSION:
+            if (next_token())
+               to_uint8(token, token_len, (uint8_t *)&hdr->protocol_version, 1) ;
+            break;
+         case _FIT_PROFILE_VERSION:
+            if (next_token())
+               to_uint16(token, token_len, (uint8_t *)&hdr->profile_version, 2) ;
+            break;
+         case _FIT_CSV_FORMAT:
+            // format is set once here, worker threads only read it when they compile DEF lines
+            for (i = 0; (i <= FIT_HDR_TYPE_MASK) && (def_lines[i] == NULL); i++)
+               ;
+            if (i <= FIT_HDR_TYPE_MASK)
+               set_line_err("FIT_CSV_FORMAT line must come before DEF lines");
+            if ((i <= FIT_HDR_TYPE_MASK) || !set_csv_format()) {
+               print_line_error(_FIT_CSV_FORMAT, line_count, line_err);
+               return false;
+            }
+            break;
+         case _FIT_END:
+            chunk_p->end = line;
+            return true;
+         default:
+            break;
+      }
+   }
+
+   fprintf(stderr, "CSV file must end with \"END,\" line. FIT file is not complete!\n");
+   return false;
+}
+
+// encode one chunk of CSV lines into chunk memory output
+static void encode_chunk (_csv_chunk *chunk_p) {
+   const int8_t *line;
+   const int8_t *eol;
+   int32_t i;
+
+   out_mem = &chunk_p->out;
+   rec_index = (verify != NULL) ? &chunk_p->index : NULL;
+   crc = 0;
+   fit_data_write = 0;
+   memset(mesg_type_plan, 0, sizeof(mesg_type_plan));
+   chunk_p->ok = false;
+
+   // set definitions in effect at chunk start, without writing their definition records
+   line_num = chunk_p->first_line - 1;
+   for (i = 0; i <= FIT_HDR_TYPE_MASK; i++) {
+      if (chunk_p->def_lines[i] == NULL)
+         continue;
+      eol = find_line_end(chunk_p->def_lines[i], chunk_p->end);
+      if ((mesg_type_plan[i] = get_plan(chunk_p->def_lines[i], eol)) == NULL) {
+         chunk_p->err_line = chunk_p->first_line;
+         chunk_p->err_line_def = _FIT_DEF;
+         strcpy(chunk_p->err_text, line_err);
+         return;
+      }
+   }
+
+   for (line = chunk_p->start; line < chunk_p->end; line = eol + 1) {
+      eol = find_line_end(line, chunk_p->end);
+      if (!process_line(line, eol, NULL)) {
+         chunk_p->err_line = line_num;
+         chunk_p->err_line_def = line_def;
+         strcpy(chunk_p->err_text, line_err);
+         return;
+      }
+   }
+
+   chunk_p->crc = crc;
+   chunk_p->ok = true;
+}
+
+// worker thread: encode chunks until all chunks are taken
+static void *encode_chunks (void *arg) {
+   int32_t i;
+
+   if ((wbuf = malloc(FIT_MAX_MESG_SIZE)) == NULL) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      return NULL;
+   }
+
+   while ((i = __atomic_fetch_add(&next_chunk, 1, __ATOMIC_RELAXED)) < num_chunks)
+      encode_chunk(&chunks[i]);
+
+   free_plans();
+   free(wbuf);
+   return NULL;
+}
+
+// encode whole CSV file with jobs threads and write chunks in order to FIT file.
+// chunks crc values are combined into file crc, so output is identical to sequential encoding
+static bool encode_parallel (int32_t jobs, FIT_FILE_HDR *hdr) {
+   pthread_t *threads;
+   int32_t started;
    int32_t i;
+   bool ok = false;
+
+   if (!prescan_csv(csv_text, csv_len, jobs, hdr))
+      goto parallel_done;
+
+   if ((threads = malloc(jobs * sizeof(pthread_t))) == NULL) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      goto parallel_done;
+   }
+   next_chunk = 0;
+   for (started = 0; started < jobs; started++) {
+      if (pthread_create(&threads[started], NULL, &encode_chunks, NULL) != 0)
+         break;
+   }
+   // if no thread could be started, encode all chunks here
+   if (started == 0)
+      encode_chunks(NULL);
+   for (i = 0; i < started; i++)
+      pthread_join(threads[i], NULL);
+   free(threads);
+
+   // stitch chunks in order. first failing chunk is the first failing line in file
+   for (i = 0; i < num_chunks; i++) {
+      if (!chunks[i].ok) {
+         if (chunks[i].err_line_def != _FIT_NONE)
+            print_line_error(chunks[i].err_line_def, chunks[i].err_line, chunks[i].err_text);
+         goto parallel_done;
+      }
+      if (fwrite(chunks[i].out.buf, 1, chunks[i].out.len, fit_f) < chunks[i].out.len) {
+         fprintf(stderr, "Failed to write to FIT file, %s\n", strerror(errno));
+         goto parallel_done;
+      }
+      if (verify != NULL) {
+         if (!index_chunk(&chunks[i].index, fit_data_write)) {
+            fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+            goto parallel_done;
+         }
+         verify_write(chunks[i].out.buf, chunks[i].out.len);
+      }
+      crc = fit_crc16_combine(crc, chunks[i].crc, chunks[i].out.len);
+      fit_data_write += chunks[i].out.len;
+   }
+   ok = true;
+
+parallel_done:
+   for (i = 0; i < num_chunks; i++) {
+      free(chunks[i].out.buf);
+      free(chunks[i].index.pos);
+   }
+   free(chunks);
+   chunks = NULL;
+   return ok;
+}
 
+
+
+// cleanup function 
+void cleanup () {
    fclose(fit_f);
    fclose(csv_f);
-   free(rbuf);
+   free_csv_text();
    free(wbuf);
-#ifdef DEBUG
-   fclose(cfit_f); 
-   free(cbuf);
-#endif
-   for (i = 0; i < FIT_HDR_TYPE_MASK+1; i++) {
-      if (mesg_type_def[i] != NULL)
-         free(mesg_type_def[i]);
-   }   
+   verify_close();
+   free_plans();
 }
 
 
@@ -558,7 +2017,10 @@ int32_t main (int32_t argc, int8_t *argv[]) {
    _fit_mesg_def *fit_mesg_def_ptr;                   // address of last message def
    int32_t  line_mesg_deg;                                // csv line definition
    static uint8_t rec_hdr;                      // record header
-   int32_t line_def;                                      // CSV line definition
+   int32_t argi;                                      // first file name argument
+   int32_t jobs = 1;                                  // number of encoding threads
+   int8_t *verify_file = NULL;                        // reference FIT file to verify output against
+   bool verify_thread = false;                        // compare with reference in a separate thread
 
    // print general license note
    printf("\
@@ -569,51 +2031,79 @@ int32_t main (int32_t argc, int8_t *argv[]) {
    GNU License (https://www.gnu.org/licenses/) conditions;\n\
 ******************************************************************************\n");
 
+   // read options
+   for (argi = 1; (argi < argc) && (strncmp(argv[argi], "--", 2) == 0); argi++) {
+      if (strncmp(argv[argi], "--jobs=", 7) == 0) {
+         jobs = atoi(argv[argi]+7);
+#ifdef _SC_NPROCESSORS_ONLN
+         if (jobs <= 0)
+            jobs = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+         if (jobs <= 0)
+            jobs = 1;
+      }
+      else if (strcmp(argv[argi], "--optimize-defs") == 0)
+         optimize_defs = true;
+      else if (strcmp(argv[argi], "--compress-timestamps") == 0) {
+         compress_ts = true;
+         optimize_defs = true;
+      }
+      else if (strncmp(argv[argi], "--verify-against=", 17) == 0)
+         verify_file = argv[argi]+17;
+      else if (strcmp(argv[argi], "--verify-thread") == 0)
+         verify_thread = true;
+      else {
+         fprintf(stderr, "Unknown option: %s\n", argv[argi]);
+         return 1;
+      }
+   }
+
 #ifdef DEBUG
-   if (argc < 4) {
+   if (argc - argi < 3) {
       fprintf(stderr, "Missing arguments\n");
       fprintf(stderr, "USAGE: csv2fit <CSV_file_name> <FIT_file_name> <CHECK_FIT_FILE\n");
       return 1;
    }
+   verify_file = argv[argi+2];
 #else
-   if (argc < 3) {
+   if (argc - argi < 2) {
       fprintf(stderr, "Missing arguments\n");
-      fprintf(stderr, "USAGE: csv2fit <CSV_file_name> <FIT_file_name>\n");
+      fprintf(stderr, "USAGE: csv2fit [--jobs=N] [--optimize-defs] [--compress-timestamps] [--verify-against=REF_FIT_file_name]\n");
+      fprintf(stderr, "              [--verify-thread] <CSV_file_name> <FIT_file_name>\n");
+      fprintf(stderr, "       --jobs=N           encode with N threads (0 - number of CPUs)\n");
+      fprintf(stderr, "       --optimize-defs    write definitions only when needed and reassign local message types\n");
+      fprintf(stderr, "                          (encodes with a single thread)\n");
+      fprintf(stderr, "       --compress-timestamps  write close timestamps in compressed timestamp header\n");
+      fprintf(stderr, "                          (implies --optimize-defs)\n");
+      fprintf(stderr, "       --verify-against=REF_FIT_file_name  check that FIT file is identical to reference FIT file\n");
+      fprintf(stderr, "       --verify-thread    compare with reference FIT file in a separate thread\n");
       return 1;
    }
 #endif
 
+   // local message types assignment depends on all previous lines
+   if (optimize_defs)
+      jobs = 1;
+
    // open csv file
-   if ((csv_f = fopen(argv[1], "r")) == NULL) {
-      fprintf(stderr, "Failed to open CSV file: %s, %s\n", argv[1], strerror(errno));
+   if ((csv_f = fopen(argv[argi], "r")) == NULL) {
+      fprintf(stderr, "Failed to open CSV file: %s, %s\n", argv[argi], strerror(errno));
       return 1;
    }
 
    // open fit file
-   if ((fit_f = fopen(argv[2], "w+b")) == NULL) {
-      fprintf(stderr, "Failed to open FIT file: %s, %s\n", argv[2], strerror(errno));
+   if ((fit_f = fopen(argv[argi+1], "w+b")) == NULL) {
+      fprintf(stderr, "Failed to open FIT file: %s, %s\n", argv[argi+1], strerror(errno));
       fclose(csv_f);
       return 1;
    }
 
-#ifdef DEBUG
-   // open check fit file
-   if ((cfit_f = fopen(argv[3], "rb")) == NULL) {
-      fprintf(stderr, "Failed to open CHECK FIT file: %s, %s\n", argv[3], strerror(errno));
-      fclose(csv_f);
-      fclose(fit_f);
-      return 1;
-   }
-#endif
 
-   // allocate local read buf
-   if ((rbuf = malloc(FIT_MAX_MESG_SIZE)) == NULL) {
-      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+   // map CSV file text. pipes are streamed, unless --jobs mode needs whole text to split it
+   set_scan_token();
+   if (!load_csv_text(csv_f, jobs > 1)) {
       fclose(csv_f);
       fclose(fit_f);  
-#ifdef DEBUG
-      fclose(cfit_f); 
-#endif
       return 1;
    }
 
@@ -622,28 +2112,19 @@ int32_t main (int32_t argc, int8_t *argv[]) {
       fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
       fclose(fit_f);      
       fclose(csv_f);
-#ifdef DEBUG
-      fclose(cfit_f); 
-#endif
-      free(rbuf);
+      free_csv_text();
       return 1;
    }
 
-#ifdef DEBUG
-      // allocate check buffer buf
-   if ((cbuf = malloc(FIT_MAX_MESG_SIZE)) == NULL) {
-      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
-      fclose(fit_f);      
-      fclose(csv_f);
-      fclose(cfit_f); 
-      free(rbuf);
-      free(wbuf);
-      return 1;
-   }
-#endif
+   // open reference FIT file. records index maps first difference to its CSV line
+   if ((verify_file != NULL) && !verify_open(verify_file, verify_thread))
+      goto done_with_error;
+   if (verify != NULL)
+      rec_index = &file_index;
 
-   // init all fit_mesg_def pointers to NULL
-   memset(&mesg_type_def, 0, sizeof(mesg_type_def));
+   // init all plan pointers to NULL
+   memset(&mesg_type_plan, 0, sizeof(mesg_type_plan));
+   memset(&plan_cache, 0, sizeof(plan_cache));
 
    // write fit file header - it will be updated before file is closed!
    fit_file_hdr.header_size = FIT_FILE_HDR_SIZE;
@@ -654,56 +2135,18 @@ int32_t main (int32_t argc, int8_t *argv[]) {
    if (!WriteFileHeader(&fit_file_hdr))
       goto done_with_error;
 
-#ifdef DEBUG
-   // advance check file past file_header
-   if (fseek(cfit_f, FIT_FILE_HDR_SIZE, SEEK_SET) != 0)
-      fprintf(stderr, "Seek failed\n");
-#endif
-
    // file header crc check succeeded. now reset crc to check whole file CRC
    crc = 0;
    fit_data_write = 0;
    line_def = _FIT_NONE;
 
-   while ((fgets(rbuf, FIT_MAX_MESG_SIZE, csv_f) != NULL) && !feof(csv_f) && (line_def != _FIT_END)) {
-
-      token = strtok(rbuf, delim);
-      line_def = get_line_def (token);
-      line_num++;
-
-      switch (line_def) {
-         case _FIT_PROTOCOL_VERSION:
-            token = strtok(NULL, delim);
-               if (token != NULL)
-         	      to_uint8(token, (uint8_t *)&fit_file_hdr.protocol_version, 1) ;
-            break;
-         case _FIT_PROFILE_VERSION:
-            token = strtok(NULL, delim);
-               if (token != NULL)
-         	      to_uint16(token, (uint8_t *)&fit_file_hdr.profile_version, 2) ;
-            break;
-         case _FIT_DEF:
-            if (!process_definition_line()) {
-               fprintf(stderr, "Error processing definition line %d\n", line_num);
-               goto done_with_error;
-            }
-            break;
-         case _FIT_DATA:
-            if (!process_data_line()) {
-               fprintf(stderr, "Error processing data line %d\n", line_num);
-               goto done_with_error;
-            }
-            break;
-         case _FIT_END:
-            break;
-        default:
-      }
+   if (jobs > 1) {
+      if (!encode_parallel(jobs, &fit_file_hdr))
+         goto done_with_error;
    }
-
-   // check if we exit the loop due to _FIT_END. If not CSV file is not complete - exit with error
-   if (line_def != _FIT_END) {
-      fprintf(stderr, "CSV file must end with \"END,\" line. FIT file is not complete!\n");
-      goto done_with_error;
+   else {
+      if (!encode_sequential(csv_f, &fit_file_hdr))
+         goto done_with_error;
    }
 
    // we got heare after reading all lines in CSV file
@@ -720,6 +2163,16 @@ int32_t main (int32_t argc, int8_t *argv[]) {
       goto done_with_error;
    }
 
+   if (optimize_defs)
+      printf("%d DEF lines, %d definition records written\n", def_lines_count, def_recs_count);
+   if (compress_ts)
+      printf("%d timestamps compressed, %d timestamp bytes removed\n", ts_compressed_count, ts_compressed_count * (int32_t)sizeof(FIT_UINT32));
+
+   if ((verify != NULL) && !verify_finish(&fit_file_hdr, crc))
+      goto done_with_error;
+   if (verify != NULL)
+      printf("FIT file is identical to reference FIT file %s\n", verify_file);
+
    //done ok;
    printf("Converting CSV to FIT file completed successfully\n");
    cleanup ();
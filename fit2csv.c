@@ -26,11 +26,22 @@
 #include <errno.h>
 #include <string.h>
 #include <stdbool.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include <fit_example.h>
 #include <fit_crc.h>
 
 #include <fit_titles.h>
+#include <fit_scan.h>
+#include <fit_crc16.h>
+#include <fit_convert.h>
+#include <fit_stats.h>
+#include <fit_dev.h>
+#include <fit_index.h>
+#include <fit_writer.h>
+#include <fit_daemon.h>
 
 // define fixed portion of fit message record. it must be packed;
 typedef struct {
@@ -40,12 +51,18 @@ typedef struct {
    FIT_UINT8 num_fields;
 } __attribute__((__packed__)) _fit_fixed_mesg_def;
 
+// dev_fields and dev_base_types point right after the last entry of fields (same allocation)
 typedef struct {
+   FIT_MESG_NUM global_mesg_num;
+   uint8_t def_rec_hdr;                            // definition record header and architecture, to write it again
+   FIT_UINT8 arch;
    FIT_UINT8 num_fields;
    FIT_UINT8 num_dev_fields;
    uint16_t data_mesg_len;
+   int32_t ts_offset;                              // timestamp field offset in data record, -1 if none
+   FIT_DEV_FIELD_DEF *dev_fields;
+   FIT_UINT8 *dev_base_types;                      // base type developer fields are written with, BYTE if not described
    FIT_FIELD_DEF fields[0];
-   FIT_DEV_FIELD_DEF dev_fields[0];
 } _fit_mesg_def;
 
 // static arguments to save passing arguments between functions call
@@ -57,10 +74,44 @@ static _fit_mesg_def *mesg_type_def[FIT_HDR_TYPE_MASK+1]; // track on local mess
 static _fit_fixed_mesg_def fit_fixed_mesg_def;     // fixed portion of a definition message     
 static uint8_t rec_hdr;                      // record header
 static int32_t fit_data_read;                          // track how much data was read 
+static bool real_floats;                           // --real-floats mode
+static bool units;                                 // --units mode
+static bool ndjson;                                // --ndjson mode
+static bool skip_invalid;                          // --ndjson: leave out fields with invalid values
+static int32_t bytes_format;                       // --bytes: BYTE fields text (BYTES_DEC, BYTES_HEX or BYTES_BASE64)
+static bool compact;                               // --compact: integers are not zero padded, invalid values are empty
+static _fit_dev_table dev_table;                   // developer fields described so far
+
+#define TIMESTAMP_FIELD            253             // timestamp field number, same in all messages
+#define TIMESTAMP_INVALID          0xFFFFFFFF
+
+// --from / --to: only data records in time window are written
+static bool window;
+static FIT_UINT32 window_from;
+static FIT_UINT32 window_to = UINT32_MAX;
+static bool window_stop;                           // index says timestamps are monotonic, stop after window end
+static bool window_done;                           // record after window end was read
+static bool jumped;                                // reading started from index checkpoint
+static FIT_UINT32 last_ts;                         // last timestamp as FIT reader tracks it
+static bool last_ts_valid;
+static bool last_ts_kept;                          // record that set last timestamp was written
+static FIT_UINT32 rec_ts;                          // timestamp of data record in buf, decoded for compressed timestamp header
+static FIT_UINT32 out_last_ts;                     // --fit: last timestamp of output file
+static bool out_last_ts_valid;
+static bool def_pending[FIT_HDR_TYPE_MASK+1];      // definition is written before next written record of local message type
+static uint32_t def_offsets[FIT_HDR_TYPE_MASK+1];  // file offset of definition record of local message type
+static bool fit_out;                               // --fit: write FIT file instead of CSV
+static _fit_writer fit_w;
 
 /****************************************************/
 /* convert FIT values to string based on their type */
 /****************************************************/
+enum {
+   BYTES_DEC = 0,                                  // "010/234/255/"
+   BYTES_HEX,                                      // "0AEAFF"
+   BYTES_BASE64                                    // "CuiA"
+};
+
 typedef struct {
    FIT_FIT_BASE_TYPE base_type;
    int8_t *(*val_to_str)(uint8_t *data, uint8_t size);
@@ -74,71 +125,107 @@ enum {
    int32,
    uint32,
    int64,
-   uint64
+   uint64,
+   float32,
+   float64,
+   text,
+   bytes
 };
 
-static int8_t string[FIT_MAX_FIELD_SIZE*4+1];  // to allow unkown base type string
+static int8_t string[FIT_MAX_FIELD_SIZE*FLOAT_STR_SIZE+1];  // to allow unkown base type string, --real-floats and --units arrays (up to 31 characters per element)
 
-static int32_t prf (int8_t *s, int8_t *format, uint8_t *val, int32_t type) {
+// write integer value zero padded to digits. return text length
+static int32_t prf (int8_t *s, int32_t digits, uint8_t *val, int32_t type) {
    switch (type) {
-      case int8: return sprintf(s, format, *(int8_t *)val);
-      case uint8: return sprintf(s, format, *(uint8_t *)val);
-      case int16: return sprintf(s, format, *(int16_t *)val);
-      case uint16: return sprintf(s, format, *(uint16_t *)val);
-      case int32: return sprintf(s, format, *(int32_t *)val);
-      case uint32: return sprintf(s, format, *(uint32_t *)val);
-      case int64: return sprintf(s, format, *(int64_t *)val);
-      case uint64: return sprintf(s, format, *(uint64_t *)val);
-      default:
+      case int8: return format_int(*(int8_t *)val, digits, s);
+      case uint8: return format_uint(*(uint8_t *)val, digits, s);
+      case int16: return format_int(*(int16_t *)val, digits, s);
+      case uint16: return format_uint(*(uint16_t *)val, digits, s);
+      case int32: return compact ? format_int(*(int32_t *)val, digits, s) : format_uint(*(uint32_t *)val, digits, s);   // CSV files always had sint32 values written as unsigned
+      case uint32: return format_uint(*(uint32_t *)val, digits, s);
+      case int64: return format_int(*(int64_t *)val, digits, s);
+      default: return format_uint(*(uint64_t *)val, digits, s);
    }
 }
 
-static int8_t *val2str (uint8_t *v, uint8_t size, int8_t t_size, int8_t *f1, int8_t *f2, int8_t f_s, int32_t type) {
+// array elements are separated by '|'. negative elements are one character longer than the digits
+static int8_t *val2str (uint8_t *v, uint8_t size, int8_t t_size, int32_t digits, int32_t type) {
    int8_t *s = string;
-	prf(s, f1, v, type);
+
+   if (compact)
+      digits = 1;
+	s += prf(s, digits, v, type);
    size -= t_size;
    v += t_size;
-   s += f_s;
    while (size) {
-   	prf(s, f2, v, type);
+      *s++ = '|';
+   	s += prf(s, digits, v, type);
       size -= t_size;
       v += t_size;
-      s += f_s+1;
    }
 	return string;
 }
 
 static int8_t *int8_to_str (uint8_t *v, uint8_t size) {
-	return val2str(v, size, sizeof(int8_t), "%3.3hhd", "|%3.3hhd", 3, int8);
+	return val2str(v, size, sizeof(int8_t), 3, int8);
 }
 
 static int8_t *uint8_to_str (uint8_t *v, uint8_t size) {
-	return val2str(v, size, sizeof(uint8_t), "%3.3hhu", "|%3.3hhu", 3, uint8);
+	return val2str(v, size, sizeof(uint8_t), 3, uint8);
 }
 
 static int8_t *int16_to_str (uint8_t *v, uint8_t size) {
-	return val2str(v, size, sizeof(int16_t), "%6.6hd", "|%6.6hd", 6, int16);
+	return val2str(v, size, sizeof(int16_t), 6, int16);
 }
 
 
 static int8_t *uint16_to_str (uint8_t *v, uint8_t size) {
-	return val2str(v, size, sizeof(uint16_t), "%6.6hu", "|%6.6hu", 6, uint16);
+	return val2str(v, size, sizeof(uint16_t), 6, uint16);
 }
 
 static int8_t *int32_to_str (uint8_t *v, uint8_t size) {
-	return val2str(v, size, sizeof(int32_t), "%11.11ld", "|%11.11ld", 11, int32);
+	return val2str(v, size, sizeof(int32_t), 11, int32);
 }
 
 static int8_t *uint32_to_str (uint8_t *v, uint8_t size) {
-	return val2str(v, size, sizeof(uint32_t), "%11.11lu", "|%11.11lu", 11, uint32);
+	return val2str(v, size, sizeof(uint32_t), 11, uint32);
 }
 
 static int8_t *int64_to_str (uint8_t *v, uint8_t size) {
-	return val2str(v, size, sizeof(int64_t), "%21.21lld", "|%21.21lld", 21, int64);
+	return val2str(v, size, sizeof(int64_t), 21, int64);
 }
 
 static int8_t *uint64_to_str (uint8_t *v, uint8_t size) {
-	return val2str(v, size, sizeof(uint64_t), "%21.21llu", "|%21.21llu", 21, uint64);
+	return val2str(v, size, sizeof(uint64_t), 21, uint64);
+}
+
+// --real-floats: shortest text that reads back to the same float bits
+static int8_t *float32_to_str (uint8_t *v, uint8_t size) {
+   int8_t *s = string;
+   float f;
+
+   for (; size >= sizeof(float); size -= sizeof(float), v += sizeof(float)) {
+      if (s != string)
+         *s++ = '|';
+      memcpy(&f, v, sizeof(f));
+      s += format_float32(f, s);
+   }
+   *s = 0;
+   return string;
+}
+
+static int8_t *float64_to_str (uint8_t *v, uint8_t size) {
+   int8_t *s = string;
+   double d;
+
+   for (; size >= sizeof(double); size -= sizeof(double), v += sizeof(double)) {
+      if (s != string)
+         *s++ = '|';
+      memcpy(&d, v, sizeof(d));
+      s += format_float64(d, s);
+   }
+   *s = 0;
+   return string;
 }
 
 static int8_t *string_to_str (uint8_t *v, uint8_t size) {
@@ -156,11 +243,23 @@ static int8_t *unkonwn_base_type (uint8_t *val, uint8_t size) {
    int8_t *str = string;
    uint8_t *uc = val;
    while (size) {
-      sprintf(str, "%03hhu/", *uc);
-      str += 4;
+      str += format_uint(*uc, compact ? 1 : 3, str);
+      *str++ = '/';
       uc++;
 	  size--;
    }
+   *str = 0;
+   return string;
+}
+
+// --bytes=hex and --bytes=base64
+static int8_t *hex_to_str (uint8_t *val, uint8_t size) {
+   format_hex(val, size, string);
+   return string;
+}
+
+static int8_t *base64_to_str (uint8_t *val, uint8_t size) {
+   format_base64(val, size, string);
    return string;
 }
 
@@ -184,9 +283,31 @@ static _base_type_to_string base2str[FIT_FIT_BASE_TYPE_COUNT] = {
    {FIT_FIT_BASE_TYPE_UINT64Z, &uint64_to_str}
 };
 
+static _base_type_to_string real_float2str[] = {
+   {FIT_FIT_BASE_TYPE_FLOAT32, &float32_to_str},
+   {FIT_FIT_BASE_TYPE_FLOAT64, &float64_to_str}
+};
+
+// BYTE fields written by --bytes=hex and --bytes=base64, indexed by bytes_format
+static _base_type_to_string compact_bytes2str[] = {
+   {FIT_FIT_BASE_TYPE_BYTE, &unkonwn_base_type},
+   {FIT_FIT_BASE_TYPE_BYTE, &hex_to_str},
+   {FIT_FIT_BASE_TYPE_BYTE, &base64_to_str}
+};
+
 _base_type_to_string *get_type_2str (FIT_FIT_BASE_TYPE type) {
 	int32_t i = 0;
 
+   if (type == FIT_FIT_BASE_TYPE_BYTE)
+      return &compact_bytes2str[bytes_format];
+
+   if (real_floats) {
+      for (i = 0; i < sizeof(real_float2str)/sizeof(real_float2str[0]); i++) {
+         if (real_float2str[i].base_type == type)
+            return &real_float2str[i];
+      }
+   }
+
 	for (i = 0; i < FIT_FIT_BASE_TYPE_COUNT; i++) {
 		if (base2str[i].base_type == type)
 			return &base2str[i];
@@ -194,18 +315,352 @@ _base_type_to_string *get_type_2str (FIT_FIT_BASE_TYPE type) {
 	return NULL;	
 }
 
-// cleanup function 
+/**********************************************************/
+/* --units and --ndjson: fields converters                */
+/* converters are built once for each message definition  */
+/**********************************************************/
+typedef struct {
+   const _field_units *units;          // --units: NULL - field value is printed as stored
+   double bias;                        // offset * scale, stored values are integers so (value - bias) is exact
+   int32_t type;                       // element type (int8 ... bytes)
+   uint8_t t_size;                     // element size
+   uint64_t invalid;                   // element invalid value bits
+   const int8_t *key;                  // --ndjson: field key, ',"TITLE":'
+   int32_t key_len;
+} _field_conv;
+
+typedef struct {
+   FIT_FIT_BASE_TYPE base_type;
+   int32_t type;
+   uint8_t t_size;
+   uint64_t invalid;
+} _conv_type;
+
+// fields of other base types are converted as bytes
+static _conv_type conv_types[] = {
+   {FIT_FIT_BASE_TYPE_ENUM, uint8, sizeof(uint8_t), FIT_ENUM_INVALID},
+   {FIT_FIT_BASE_TYPE_SINT8, int8, sizeof(int8_t), (uint8_t)FIT_SINT8_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT8, uint8, sizeof(uint8_t), FIT_UINT8_INVALID},
+   {FIT_FIT_BASE_TYPE_SINT16, int16, sizeof(int16_t), (uint16_t)FIT_SINT16_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT16, uint16, sizeof(uint16_t), FIT_UINT16_INVALID},
+   {FIT_FIT_BASE_TYPE_SINT32, int32, sizeof(int32_t), (uint32_t)FIT_SINT32_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT32, uint32, sizeof(uint32_t), FIT_UINT32_INVALID},
+   {FIT_FIT_BASE_TYPE_STRING, text, sizeof(uint8_t), 0},
+   {FIT_FIT_BASE_TYPE_FLOAT32, float32, sizeof(float), UINT32_MAX},
+   {FIT_FIT_BASE_TYPE_FLOAT64, float64, sizeof(double), UINT64_MAX},
+   {FIT_FIT_BASE_TYPE_SINT64, int64, sizeof(int64_t), (uint64_t)FIT_SINT64_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT64, uint64, sizeof(uint64_t), FIT_UINT64_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT8Z, uint8, sizeof(uint8_t), FIT_UINT8Z_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT16Z, uint16, sizeof(uint16_t), FIT_UINT16Z_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT32Z, uint32, sizeof(uint32_t), FIT_UINT32Z_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT64Z, uint64, sizeof(uint64_t), FIT_UINT64Z_INVALID}
+};
+
+static _conv_type bytes_type = {FIT_FIT_BASE_TYPE_BYTE, bytes, sizeof(uint8_t), FIT_BYTE_INVALID};
+
+static _field_conv *mesg_type_conv[FIT_HDR_TYPE_MASK+1]; // fields converters of local message types
+static int8_t *mesg_type_json[FIT_HDR_TYPE_MASK+1];      // --ndjson: message keys and fields keys of local message types
+
+static const _conv_type *get_conv_type (FIT_FIT_BASE_TYPE base_type, uint8_t size) {
+   int32_t t;
+
+   for (t = 0; t < sizeof(conv_types)/sizeof(conv_types[0]); t++) {
+      if (conv_types[t].base_type == base_type)
+         return (size % conv_types[t].t_size == 0) ? &conv_types[t] : &bytes_type;
+   }
+   return &bytes_type;
+}
+
+// write JSON string, up to size characters. return text length
+static int32_t json_text (uint8_t *v, uint8_t size, int8_t *s) {
+   int8_t *p = s;
+
+   *p++ = '"';
+   for (; size && *v; size--, v++) {
+      if ((*v == '"') || (*v == '\\')) {
+         *p++ = '\\';
+         *p++ = *v;
+      }
+      else if (*v < 0x20)
+         p += sprintf(p, "\\u%04X", *v);
+      else
+         *p++ = *v;
+   }
+   *p++ = '"';
+   *p = 0;
+   return p - s;
+}
+
+// write field key: known title, or field number for unknown fields. return key length
+static int32_t json_field_key (int8_t *s, FIT_UINT8 field_def_num) {
+   char *title = get_field_title(fit_fixed_mesg_def.global_mesg_num, field_def_num);
+
+   if ((title == NULL) || (strcmp(title, "unknown") == 0))
+      return sprintf(s, ",\"FIELD_%d\":", field_def_num);
+   return sprintf(s, ",\"%s\":", title);
+}
+
+// write developer field key: its description name, or developer data index and field number
+// for fields with no description or no name. return key length
+static int32_t json_dev_key (int8_t *s, const FIT_DEV_FIELD_DEF *dev_field) {
+   const _fit_dev_field *f = fit_dev_lookup(&dev_table, dev_field->dev_index, dev_field->def_num);
+   int32_t len;
+
+   if ((f == NULL) || (f->name[0] == 0))
+      return sprintf(s, ",\"DEV_%d_%d\":", dev_field->dev_index, dev_field->def_num);
+   s[0] = ',';
+   len = 1 + json_text((uint8_t *)f->name, sizeof(f->name), s + 1);
+   return len + sprintf(s + len, ":");
+}
+
+// serialize message keys and fields keys once, data records only copy them
+// return 0 on success, -1 on error
+static int32_t set_mesg_json (uint8_t mesg_type) {
+   _fit_mesg_def *def = mesg_type_def[mesg_type];
+   _field_conv *conv = mesg_type_conv[mesg_type];
+   int8_t key[FIT_MAX_FIELD_SIZE + 6 * FIT_DEV_NAME_SIZE];   // escaped developer field name is the longest key
+   int32_t len;
+   int32_t i;
+   int8_t *s;
+
+   // message keys, then keys of fields and developer fields
+   len = snprintf(NULL, 0, "{\"MESG\":\"%s\",\"M_NUM\":%d", get_mesg_title(fit_fixed_mesg_def.global_mesg_num), fit_fixed_mesg_def.global_mesg_num) + 1;
+   for (i = 0; i < def->num_fields; i++)
+      len += json_field_key(key, def->fields[i].field_def_num) + 1;
+   for (i = 0; i < def->num_dev_fields; i++)
+      len += json_dev_key(key, &def->dev_fields[i]) + 1;
+
+   free(mesg_type_json[mesg_type]);
+   if ((mesg_type_json[mesg_type] = malloc(len)) == NULL) {
+      fprintf(stderr, "Failed to allocate memory for JSON keys, %s\n", strerror(errno));
+      return -1;
+   }
+
+   s = mesg_type_json[mesg_type];
+   s += sprintf(s, "{\"MESG\":\"%s\",\"M_NUM\":%d", get_mesg_title(fit_fixed_mesg_def.global_mesg_num), fit_fixed_mesg_def.global_mesg_num) + 1;
+   for (i = 0; i < def->num_fields + def->num_dev_fields; i++) {
+      conv[i].key = s;
+      if (i < def->num_fields)
+         conv[i].key_len = json_field_key(s, def->fields[i].field_def_num);
+      else
+         conv[i].key_len = json_dev_key(s, &def->dev_fields[i - def->num_fields]);
+      s += conv[i].key_len + 1;
+   }
+   return 0;
+}
+
+// scale, offset and units of described developer field, NULL if it has no scale
+static const _field_units *dev_field_units (const FIT_DEV_FIELD_DEF *dev_field) {
+   const _fit_dev_field *f = fit_dev_lookup(&dev_table, dev_field->dev_index, dev_field->def_num);
+
+   return ((f != NULL) && (f->units.scale != 0)) ? &f->units : NULL;
+}
+
+// set fields converters of new message definition
+// return 0 on success, -1 on error
+static int32_t set_mesg_conv (uint8_t mesg_type) {
+   _fit_mesg_def *def = mesg_type_def[mesg_type];
+   const _conv_type *t;
+   _field_conv *conv;
+   int32_t i;
+
+   free(mesg_type_conv[mesg_type]);
+   if ((mesg_type_conv[mesg_type] = calloc(def->num_fields + def->num_dev_fields + 1, sizeof(_field_conv))) == NULL) {
+      fprintf(stderr, "Failed to allocate memory for fields converters, %s\n", strerror(errno));
+      return -1;
+   }
+
+   for (i = 0; i < def->num_fields + def->num_dev_fields; i++) {
+      conv = &mesg_type_conv[mesg_type][i];
+      if (i < def->num_fields)
+         t = get_conv_type(def->fields[i].base_type, def->fields[i].size);
+      else
+         t = get_conv_type(def->dev_base_types[i - def->num_fields], def->dev_fields[i - def->num_fields].size);
+      conv->type = t->type;
+      conv->t_size = t->t_size;
+      conv->invalid = t->invalid;
+
+      // only integer fields are scaled, by FIT profile or by developer field description
+      if (!units || (conv->type > uint64))
+         continue;
+      if (i < def->num_fields)
+         conv->units = get_field_units(fit_fixed_mesg_def.global_mesg_num, def->fields[i].field_def_num);
+      else
+         conv->units = dev_field_units(&def->dev_fields[i - def->num_fields]);
+      if (conv->units != NULL)
+         conv->bias = conv->units->offset * conv->units->scale;
+   }
+
+   return ndjson ? set_mesg_json(mesg_type) : 0;
+}
+
+static double elem_value (uint8_t *v, int32_t type) {
+   switch (type) {
+      case int8: return *(int8_t *)v;
+      case uint8: return *(uint8_t *)v;
+      case int16: return *(int16_t *)v;
+      case uint16: return *(uint16_t *)v;
+      case int32: return *(int32_t *)v;
+      case uint32: return *(uint32_t *)v;
+      case int64: return *(int64_t *)v;
+      default: return *(uint64_t *)v;
+   }
+}
+
+// convert all field elements: value / scale - offset. invalid elements are left empty
+static int8_t *units_to_str (const _field_conv *conv, uint8_t *v, uint8_t size) {
+   int8_t *s = string;
+   uint64_t bits;
+
+   for (; size >= conv->t_size; size -= conv->t_size, v += conv->t_size) {
+      if (s != string)
+         *s++ = '|';
+      bits = 0;
+      memcpy(&bits, v, conv->t_size);
+      if (bits != conv->invalid)
+         s += format_float64((elem_value(v, conv->type) - conv->bias) / conv->units->scale, s);
+   }
+   *s = 0;
+   return string;
+}
+
+/**********************************************************/
+/* --ndjson: one JSON object per data record              */
+/**********************************************************/
+
+// write one element, NaN and infinity are not JSON numbers. return text length, 0 if element is invalid
+static int32_t json_elem (const _field_conv *conv, uint8_t *v, int8_t *s) {
+   uint64_t bits = 0;
+   float f;
+   double d;
+
+   memcpy(&bits, v, conv->t_size);
+   if (bits == conv->invalid)
+      return 0;
+   if (conv->units != NULL)
+      return format_float64((elem_value(v, conv->type) - conv->bias) / conv->units->scale, s);
+
+   switch (conv->type) {
+      case int8: return format_int(*(int8_t *)v, 1, s);
+      case int16: return format_int(*(int16_t *)v, 1, s);
+      case int32: return format_int(*(int32_t *)v, 1, s);
+      case int64: return format_int(*(int64_t *)v, 1, s);
+      case uint8:
+      case bytes: return format_uint(*(uint8_t *)v, 1, s);
+      case uint16: return format_uint(*(uint16_t *)v, 1, s);
+      case uint32: return format_uint(*(uint32_t *)v, 1, s);
+      case float32:
+         memcpy(&f, v, sizeof(f));
+         return isfinite(f) ? format_float32(f, s) : 0;
+      case float64:
+         memcpy(&d, v, sizeof(d));
+         return isfinite(d) ? format_float64(d, s) : 0;
+      default: return format_uint(*(uint64_t *)v, 1, s);
+   }
+}
+
+// write field value to string, arrays and bytes fields as JSON arrays, invalid elements as null
+// return text length, 0 if all elements are invalid
+static int32_t json_value (const _field_conv *conv, uint8_t *v, uint8_t size) {
+   int8_t *s = string;
+   bool valid = false;
+   int32_t len;
+
+   if (conv->type == text)
+      return (*v != 0) ? json_text(v, size, string) : 0;
+
+   if ((size == conv->t_size) && (conv->type != bytes)) {
+      len = json_elem(conv, v, s);
+      string[len] = 0;
+      return len;
+   }
+
+   *s++ = '[';
+   for (; size >= conv->t_size; size -= conv->t_size, v += conv->t_size) {
+      if (s != string + 1)
+         *s++ = ',';
+      if ((len = json_elem(conv, v, s)) > 0)
+         valid = true;
+      else
+         len = sprintf(s, "null");
+      s += len;
+   }
+   *s++ = ']';
+   *s = 0;
+
+   return valid ? s - string : 0;
+}
+
+void print_json_mesg (uint8_t mesg_type) {
+   _fit_mesg_def *def = mesg_type_def[mesg_type];
+   _field_conv *conv = mesg_type_conv[mesg_type];
+   uint8_t *val_ptr = buf;
+   int32_t len;
+   int32_t i;
+
+   fputs(mesg_type_json[mesg_type], csv_f);
+   if (rec_hdr & FIT_HDR_TIME_REC_BIT)
+      fprintf(csv_f, ",\"CT_OFFSET\":%d", rec_hdr & FIT_HDR_TIME_OFFSET_MASK);
+
+   for (i = 0; i < def->num_fields + def->num_dev_fields; i++) {
+      len = json_value(&conv[i], val_ptr, (i < def->num_fields) ? def->fields[i].size : def->dev_fields[i - def->num_fields].size);
+      val_ptr += (i < def->num_fields) ? def->fields[i].size : def->dev_fields[i - def->num_fields].size;
+
+      if ((len == 0) && skip_invalid)
+         continue;
+      fwrite(conv[i].key, 1, conv[i].key_len, csv_f);
+      if (len > 0)
+         fwrite(string, 1, len, csv_f);
+      else
+         fputs("null", csv_f);
+   }
+
+   fputs("}\n", csv_f);
+}
+
+// cleanup function, frees everything of the converted file
 void cleanup () {
    int32_t i;
 
-   fclose(fit_f);
-   free(buf);
+   if (fit_f != NULL)
+      fclose(fit_f);
+   fit_f = NULL;
+   if ((csv_f != NULL) && (csv_f != stdout))
+      fclose(csv_f);
+   csv_f = NULL;
+   fit_writer_abort(&fit_w);
+   fit_dev_free(&dev_table);
    for (i = 0; i < FIT_HDR_TYPE_MASK+1; i++) {
       if (mesg_type_def[i] != NULL)
          free(mesg_type_def[i]);
+      free(mesg_type_conv[i]);
+      free(mesg_type_json[i]);
+      mesg_type_def[i] = NULL;
+      mesg_type_conv[i] = NULL;
+      mesg_type_json[i] = NULL;
    }   
 }
 
+// reset state of converted file, before next file is converted
+static void reset_state () {
+   memset(&mesg_type_def, 0, sizeof(mesg_type_def));
+   memset(&mesg_type_conv, 0, sizeof(mesg_type_conv));
+   memset(&mesg_type_json, 0, sizeof(mesg_type_json));
+   memset(&fit_w, 0, sizeof(fit_w));
+   fit_dev_init(&dev_table);
+   fit_data_read = 0;
+   window_stop = false;
+   window_done = false;
+   jumped = false;
+   last_ts = 0;
+   last_ts_valid = false;
+   last_ts_kept = false;
+   out_last_ts = 0;
+   out_last_ts_valid = false;
+   memset(def_pending, 0, sizeof(def_pending));
+   memset(def_offsets, 0, sizeof(def_offsets));
+}
+
 // read buffer from FIT file
 int32_t fit_read (void *buf, int32_t size) {
    int32_t i;
@@ -215,7 +670,7 @@ int32_t fit_read (void *buf, int32_t size) {
       i = -1;
    }
 
-   crc = FitCRC_Update16(crc, buf, size);
+   crc = fit_crc16_update(crc, buf, size);
    fit_data_read += size;
 
    return i;
@@ -237,6 +692,22 @@ uint16_t calc_data_mesg_len (_fit_mesg_def *fit_mesg_def) {
    return us;
 }
 
+// --compact: check if all field elements are invalid, such fields are written as empty values
+static bool is_invalid (const _field_conv *conv, uint8_t *v, uint8_t size) {
+   uint64_t bits;
+
+   if (conv->type == text)
+      return v[0] == 0;
+
+   for (; size >= conv->t_size; size -= conv->t_size, v += conv->t_size) {
+      bits = 0;
+      memcpy(&bits, v, conv->t_size);
+      if (bits != conv->invalid)
+         return false;
+   }
+   return true;
+}
+
 void print_data_mesg (uint8_t mesg_type) {
    int32_t i;
    void *val_ptr;
@@ -254,20 +725,31 @@ void print_data_mesg (uint8_t mesg_type) {
 
    for (i = 0; i < mesg_type_def[mesg_type]->num_fields; i++) {
       base_type_p = get_type_2str(mesg_type_def[mesg_type]->fields[i].base_type);
-      if (base_type_p != NULL)
+      if (compact && is_invalid(&mesg_type_conv[mesg_type][i], val_ptr, mesg_type_def[mesg_type]->fields[i].size))
+         fputc(',', csv_f);
+      else if (units && (mesg_type_conv[mesg_type][i].units != NULL))
+         fprintf(csv_f, "%s,", units_to_str(&mesg_type_conv[mesg_type][i], val_ptr, mesg_type_def[mesg_type]->fields[i].size));
+      else if (base_type_p != NULL)
           fprintf(csv_f, "%s,", base_type_p->val_to_str(val_ptr, mesg_type_def[mesg_type]->fields[i].size));        
       else
-         fprintf(csv_f, "%s", unkonwn_base_type(val_ptr, mesg_type_def[mesg_type]->fields[i].size));    // undefined base_type
+         fprintf(csv_f, "%s,", get_type_2str(FIT_FIT_BASE_TYPE_BYTE)->val_to_str(val_ptr, mesg_type_def[mesg_type]->fields[i].size));    // undefined base_type, written as bytes
 
 
       // advance to next field value
       val_ptr += mesg_type_def[mesg_type]->fields[i].size;
    }
 
-   // read developer fields. we treat all developer fields as unknow type
-   base_type_p = get_type_2str(FIT_FIT_BASE_TYPE_BYTE);
+   // read developer fields. described fields are written like fields of their base type, others as bytes
    for (i = 0; i < mesg_type_def[mesg_type]->num_dev_fields; i++) {
-      fprintf(csv_f, "%s,", base_type_p->val_to_str(val_ptr, mesg_type_def[mesg_type]->dev_fields[i].size));         
+      if (compact && is_invalid(&mesg_type_conv[mesg_type][mesg_type_def[mesg_type]->num_fields + i], val_ptr, mesg_type_def[mesg_type]->dev_fields[i].size))
+         fputc(',', csv_f);
+      else if (units && (mesg_type_conv[mesg_type][mesg_type_def[mesg_type]->num_fields + i].units != NULL))
+         fprintf(csv_f, "%s,", units_to_str(&mesg_type_conv[mesg_type][mesg_type_def[mesg_type]->num_fields + i], val_ptr, mesg_type_def[mesg_type]->dev_fields[i].size));
+      else {
+         base_type_p = get_type_2str(mesg_type_def[mesg_type]->dev_base_types[i]);
+         fprintf(csv_f, "%s,", base_type_p->val_to_str(val_ptr, mesg_type_def[mesg_type]->dev_fields[i].size));
+      }
+      val_ptr += mesg_type_def[mesg_type]->dev_fields[i].size;
    }
 
    fprintf(csv_f, "\n");
@@ -275,143 +757,877 @@ void print_data_mesg (uint8_t mesg_type) {
 
 // print message definition text and fields titles
 // this line starts with "#" do that csv2fit will ignore it when reading the csv file
+// in --units mode converted fields titles are followed by their units, e.g. "SPEED[m/s]"
 void print_data_titles (uint8_t mesg_type) {
+   const _field_units *u;
+   const FIT_DEV_FIELD_DEF *d;
+   const _fit_dev_field *f;
+   char *title;
    int32_t i;
 
-   fprintf(csv_f, "#DEF:M_TYPE,%d,%s,%d,,,,", mesg_type, get_mesg_title(fit_fixed_mesg_def.global_mesg_num), fit_fixed_mesg_def.global_mesg_num);
+   fprintf(csv_f, "#DEF:M_TYPE,%d,%s,%d,,,,", mesg_type, get_mesg_title(mesg_type_def[mesg_type]->global_mesg_num), mesg_type_def[mesg_type]->global_mesg_num);
 
-   for (i = 0; i < mesg_type_def[mesg_type]->num_fields; i++)
-      fprintf(csv_f, "%s,", get_field_title(fit_fixed_mesg_def.global_mesg_num, mesg_type_def[mesg_type]->fields[i].field_def_num));
+   for (i = 0; i < mesg_type_def[mesg_type]->num_fields; i++) {
+      title = get_field_title(mesg_type_def[mesg_type]->global_mesg_num, mesg_type_def[mesg_type]->fields[i].field_def_num);
+      u = units ? mesg_type_conv[mesg_type][i].units : NULL;
+      if ((u != NULL) && (u->units[0] != 0))
+         fprintf(csv_f, "%s[%s],", title, u->units);
+      else
+         fprintf(csv_f, "%s,", title);
+   }
+
+   // developer fields titles are their description names
+   for (i = 0; i < mesg_type_def[mesg_type]->num_dev_fields; i++) {
+      d = &mesg_type_def[mesg_type]->dev_fields[i];
+      f = fit_dev_lookup(&dev_table, d->dev_index, d->def_num);
+      if ((f != NULL) && (f->name[0] != 0))
+         fprintf(csv_f, "%s", f->name);
+      else
+         fprintf(csv_f, "DEV_%d_%d", d->dev_index, d->def_num);
+      u = units ? mesg_type_conv[mesg_type][mesg_type_def[mesg_type]->num_fields + i].units : NULL;
+      if ((u != NULL) && (u->units[0] != 0))
+         fprintf(csv_f, "[%s]", u->units);
+      fprintf(csv_f, ",");
+   }
 
    fprintf(csv_f, "\n");
 }
 
+// when some developer fields are described, "TYPED_DEV_FIELDS" replaces "DEV_FIELDS" and every
+// developer field definition is followed by the base type its values are written with
 void print_def_mesg(uint8_t mesg_type) {
+   bool typed = false;
    int32_t i;
 
-   fprintf(csv_f, "DEF:M_TYPE,%d,M_NUM,%d,FIELDS,%d,DEV_FIELDS,%d,,", mesg_type, fit_fixed_mesg_def.global_mesg_num, mesg_type_def[mesg_type]->num_fields, mesg_type_def[mesg_type]->num_dev_fields);
+   for (i = 0; i < mesg_type_def[mesg_type]->num_dev_fields; i++) {
+      if (mesg_type_def[mesg_type]->dev_base_types[i] != FIT_FIT_BASE_TYPE_BYTE)
+         typed = true;
+   }
+
+   fprintf(csv_f, "DEF:M_TYPE,%d,M_NUM,%d,FIELDS,%d,%s,%d,,", mesg_type, mesg_type_def[mesg_type]->global_mesg_num, mesg_type_def[mesg_type]->num_fields, typed ? "TYPED_DEV_FIELDS" : "DEV_FIELDS", mesg_type_def[mesg_type]->num_dev_fields);
    for (i = 0; i < mesg_type_def[mesg_type]->num_fields; i++)
       fprintf(csv_f, "%d,%d,%d,,", mesg_type_def[mesg_type]->fields[i].field_def_num, mesg_type_def[mesg_type]->fields[i].size, mesg_type_def[mesg_type]->fields[i].base_type);
 
-   for (i = 0; i < mesg_type_def[mesg_type]->num_dev_fields; i++)
-      fprintf(csv_f, "%d,%d,%d,,", mesg_type_def[mesg_type]->dev_fields[i].def_num, mesg_type_def[mesg_type]->dev_fields[i].size, mesg_type_def[mesg_type]->dev_fields[i].dev_index);
+   for (i = 0; i < mesg_type_def[mesg_type]->num_dev_fields; i++) {
+      if (typed)
+         fprintf(csv_f, "%d,%d,%d,%d,,", mesg_type_def[mesg_type]->dev_fields[i].def_num, mesg_type_def[mesg_type]->dev_fields[i].size, mesg_type_def[mesg_type]->dev_fields[i].dev_index, mesg_type_def[mesg_type]->dev_base_types[i]);
+      else
+         fprintf(csv_f, "%d,%d,%d,,", mesg_type_def[mesg_type]->dev_fields[i].def_num, mesg_type_def[mesg_type]->dev_fields[i].size, mesg_type_def[mesg_type]->dev_fields[i].dev_index);
+   }
 
    fprintf(csv_f, "\n");
 
    print_data_titles (mesg_type);
 }
 
+// base type developer field values are written with: the described base type if it fits the field size,
+// otherwise BYTE
+static FIT_UINT8 dev_base_type (const FIT_DEV_FIELD_DEF *dev_field) {
+   const _fit_dev_field *f = fit_dev_lookup(&dev_table, dev_field->dev_index, dev_field->def_num);
+
+   if ((f == NULL) || (get_type_2str(f->base_type) == NULL) || (get_conv_type(f->base_type, dev_field->size) == &bytes_type))
+      return FIT_FIT_BASE_TYPE_BYTE;
+   return f->base_type;
+}
+
 // read record definition from FIT file
 _fit_mesg_def *add_new_def_mesg() {
    int32_t alloc_size;
    int32_t read_size;
-   FIT_UINT8 num_of_dev_fields;
+   FIT_UINT8 num_of_dev_fields = 0;
    uint8_t mesg_type;
+   _fit_mesg_def *def;
+   int32_t i;
 
    // read fit_fixed_mesg_def
-   if (fit_read(&fit_fixed_mesg_def, sizeof(_fit_fixed_mesg_def)) == sizeof(_fit_fixed_mesg_def)) {
-      mesg_type = rec_hdr & FIT_HDR_TYPE_MASK;
-      // check if new local message type is already set, if it does, release it first
-      if (mesg_type_def[mesg_type] != NULL)
-         free(mesg_type_def[mesg_type]);
-
-      // calculate size of new mesg_type_def and allocate it
-      alloc_size = sizeof(_fit_mesg_def) + fit_fixed_mesg_def.num_fields * sizeof(FIT_FIELD_DEF);
-
-      // calculate read_size
-      read_size = fit_fixed_mesg_def.num_fields * sizeof(FIT_FIELD_DEF);
-
-      // read message content (fields definitions)
-      if (fit_read(buf, read_size) == read_size) {
+   if (fit_read(&fit_fixed_mesg_def, sizeof(_fit_fixed_mesg_def)) < sizeof(_fit_fixed_mesg_def))
+      return NULL;
+
+   // read message content (fields definitions)
+   read_size = fit_fixed_mesg_def.num_fields * sizeof(FIT_FIELD_DEF);
+   if (fit_read(buf, read_size) < read_size)
+      return NULL;
+
+   if (rec_hdr & FIT_HDR_DEV_DATA_BIT) {
+      // first read how many dev field there are, dev fields definitions follow fields definitions in buf
+      if (fit_read(&num_of_dev_fields, sizeof(num_of_dev_fields)) < sizeof(num_of_dev_fields))
+         return NULL;
+      if (fit_read(buf + read_size, num_of_dev_fields * sizeof(FIT_DEV_FIELD_DEF)) < num_of_dev_fields * sizeof(FIT_DEV_FIELD_DEF))
+         return NULL;
+   }
 
-         // allocate new mesg_type_def[]
-         if ((mesg_type_def[mesg_type] = malloc(alloc_size)) == NULL) {
-            fprintf(stderr, "Failed to allocate memory for mesg_type_def, %s\n", strerror(errno));
-            return NULL;
-         }
+   // check if new local message type is already set, if it does, release it first
+   mesg_type = rec_hdr & FIT_HDR_TYPE_MASK;
+   free(mesg_type_def[mesg_type]);
 
-         // update new mesg_type_def
-         mesg_type_def[mesg_type]->num_fields = fit_fixed_mesg_def.num_fields;
-         mesg_type_def[mesg_type]->num_dev_fields = 0;
-         memcpy(mesg_type_def[mesg_type]->fields, buf, fit_fixed_mesg_def.num_fields*sizeof(FIT_FIELD_DEF));
-
-         if (rec_hdr & FIT_HDR_DEV_DATA_BIT) {
-            // first read how many dev field there are
-            if (fit_read(&num_of_dev_fields, sizeof(num_of_dev_fields)) < sizeof(num_of_dev_fields))
-               return NULL;
-
-            read_size = num_of_dev_fields * sizeof(FIT_DEV_FIELD_DEF);
-            if (fit_read(buf, read_size) < read_size)
-               return NULL;
-
-            // reallocate mesg_type_def to accomodate dev fields
-            alloc_size += read_size;
-            if ((mesg_type_def[mesg_type] = realloc(mesg_type_def[mesg_type], alloc_size)) == NULL) {
-               fprintf(stderr, "Failed to allocate memory for mesg_type_def, %s\n", strerror(errno));
-               return NULL;           
-            }
-            mesg_type_def[mesg_type]->num_dev_fields = num_of_dev_fields;
-            memcpy(mesg_type_def[mesg_type]->dev_fields, buf, num_of_dev_fields*sizeof(FIT_DEV_FIELD_DEF));         
-         }
+   // allocate new mesg_type_def[] with fields, dev fields and dev fields base types
+   alloc_size = sizeof(_fit_mesg_def) + read_size + num_of_dev_fields * (sizeof(FIT_DEV_FIELD_DEF) + sizeof(FIT_UINT8));
+   if ((mesg_type_def[mesg_type] = def = malloc(alloc_size)) == NULL) {
+      fprintf(stderr, "Failed to allocate memory for mesg_type_def, %s\n", strerror(errno));
+      return NULL;
+   }
 
-         // set data_mesg_len;
-         mesg_type_def[mesg_type]->data_mesg_len = calc_data_mesg_len(mesg_type_def[mesg_type]);
+   // update new mesg_type_def
+   def->global_mesg_num = fit_fixed_mesg_def.global_mesg_num;
+   def->def_rec_hdr = rec_hdr;
+   def->arch = fit_fixed_mesg_def.arch;
+   def->num_fields = fit_fixed_mesg_def.num_fields;
+   def->num_dev_fields = num_of_dev_fields;
+   def->dev_fields = (FIT_DEV_FIELD_DEF *)&def->fields[def->num_fields];
+   def->dev_base_types = (FIT_UINT8 *)&def->dev_fields[def->num_dev_fields];
+   memcpy(def->fields, buf, read_size + num_of_dev_fields * sizeof(FIT_DEV_FIELD_DEF));
+   for (i = 0; i < def->num_dev_fields; i++)
+      def->dev_base_types[i] = dev_base_type(&def->dev_fields[i]);
+
+   // set data_mesg_len;
+   def->data_mesg_len = calc_data_mesg_len(def);
+
+   def->ts_offset = -1;
+   for (i = 0, read_size = 0; i < def->num_fields; read_size += def->fields[i].size, i++) {
+      if ((def->fields[i].field_def_num == TIMESTAMP_FIELD) && (def->fields[i].size == sizeof(FIT_UINT32))) {
+         def->ts_offset = read_size;
+         break;
       }
    }
 
-   return mesg_type_def[mesg_type];
+   return def;
 }
 
 // print file header
 void print_file_header (FIT_FILE_HDR *fit_file_header) {
    fprintf(csv_f, "FIT_PROTOCOL_VERSION, %d\n", fit_file_header->protocol_version);
    fprintf(csv_f, "FIT_PROFILE_VERSION,  %d\n", fit_file_header->profile_version);
+   // tell csv2fit how values are written
+   if (real_floats || units || bytes_format || compact)
+      fprintf(csv_f, "FIT_CSV_FORMAT%s%s%s%s\n", real_floats ? ",REAL_FLOATS" : "", units ? ",UNITS" : "",
+              (bytes_format == BYTES_HEX) ? ",HEX_BYTES" : (bytes_format == BYTES_BASE64) ? ",BASE64_BYTES" : "", compact ? ",COMPACT" : "");
 }
 
-int32_t main (int32_t argc, int8_t *argv[]) {
-   int32_t r;                                
+/*******************************************************************/
+/* --from / --to time window                                       */
+/* records outside the window are read but not formatted, and      */
+/* definitions are written only before the first record that       */
+/* needs them. with a sidecar index of a file whose timestamps are  */
+/* monotonic, reading starts at the last checkpoint before the      */
+/* window and stops after its end.                                  */
+/*******************************************************************/
+
+// timestamp of compressed timestamp header, the time offset from the last timestamp as FIT reader tracks it
+static FIT_UINT32 ct_timestamp (FIT_UINT32 ts, uint8_t hdr) {
+   if ((hdr & FIT_HDR_TIME_OFFSET_MASK) < (ts & FIT_HDR_TIME_OFFSET_MASK))
+      ts += FIT_HDR_TIME_OFFSET_MASK + 1;
+   return (ts & ~FIT_HDR_TIME_OFFSET_MASK) | (hdr & FIT_HDR_TIME_OFFSET_MASK);
+}
+
+// check if data record in buf is in time window, by its timestamp field or decoded compressed timestamp.
+// a record without timestamp goes with the record that set the last timestamp, records before the
+// first timestamp are always written and developer fields descriptions are written up to the window end
+static bool in_window (uint8_t mesg_type) {
+   _fit_mesg_def *def = mesg_type_def[mesg_type];
+   FIT_UINT32 ts = TIMESTAMP_INVALID;
+   bool in;
+
+   if (rec_hdr & FIT_HDR_TIME_REC_BIT) {
+      if (last_ts_valid)
+         ts = ct_timestamp(last_ts, rec_hdr);
+   }
+   else if (def->ts_offset >= 0)
+      memcpy(&ts, buf + def->ts_offset, sizeof(ts));
+
+   rec_ts = ts;
+   if (ts == TIMESTAMP_INVALID) {
+      if (rec_hdr & FIT_HDR_TIME_REC_BIT)
+         return true;
+      if ((def->global_mesg_num == FIT_MESG_NUM_DEVELOPER_DATA_ID) || (def->global_mesg_num == FIT_MESG_NUM_FIELD_DESCRIPTION))
+         return !last_ts_valid || (last_ts <= window_to);
+      return !last_ts_valid || last_ts_kept;
+   }
+
+   in = (ts >= window_from) && (ts <= window_to);
+   if (window_stop && (ts > window_to))
+      window_done = true;
+   last_ts = ts;
+   last_ts_valid = true;
+   last_ts_kept = in;
+   return in;
+}
+
+// --fit: write definition record of local message type, with timestamp field added before the other fields if ts_field is set
+static int32_t write_def_rec (uint8_t mesg_type, bool ts_field) {
+   uint8_t rec[1 + sizeof(_fit_fixed_mesg_def) + ((UINT8_MAX + 1) * sizeof(FIT_FIELD_DEF)) + 1 + (UINT8_MAX * sizeof(FIT_DEV_FIELD_DEF))];
+   _fit_mesg_def *def = mesg_type_def[mesg_type];
+   _fit_fixed_mesg_def *fixed = (_fit_fixed_mesg_def *)(rec + 1);
+   FIT_FIELD_DEF *f;
+   uint32_t len;
+
+   rec[0] = def->def_rec_hdr;
+   fixed->reserved_1 = 0;
+   fixed->arch = def->arch;
+   fixed->global_mesg_num = def->global_mesg_num;
+   fixed->num_fields = def->num_fields;
+   len = 1 + sizeof(_fit_fixed_mesg_def);
+   if (ts_field) {
+      f = (FIT_FIELD_DEF *)(rec + len);
+      f->field_def_num = TIMESTAMP_FIELD;
+      f->size = sizeof(FIT_UINT32);
+      f->base_type = FIT_FIT_BASE_TYPE_UINT32;
+      fixed->num_fields++;
+      len += sizeof(FIT_FIELD_DEF);
+   }
+   memcpy(rec + len, def->fields, def->num_fields * sizeof(FIT_FIELD_DEF));
+   len += def->num_fields * sizeof(FIT_FIELD_DEF);
+   if (def->def_rec_hdr & FIT_HDR_DEV_DATA_BIT) {
+      rec[len++] = def->num_dev_fields;
+      memcpy(rec + len, def->dev_fields, def->num_dev_fields * sizeof(FIT_DEV_FIELD_DEF));
+      len += def->num_dev_fields * sizeof(FIT_DEV_FIELD_DEF);
+   }
+
+   return fit_writer_write(&fit_w, rec, len);
+}
+
+// --fit: write compressed timestamp record in buf with timestamp field, after its definition with that
+// field. the definition read from the input is written again before the next record of the local message type
+static int32_t write_expanded (uint8_t mesg_type) {
+   _fit_mesg_def *def = mesg_type_def[mesg_type];
+   uint8_t ts[sizeof(FIT_UINT32)];
+
+   if (def->num_fields == UINT8_MAX) {
+      fprintf(stderr, "Compressed timestamp record can not get timestamp field\n");
+      return -1;
+   }
+
+   if (def->arch) {
+      ts[0] = rec_ts >> 24;
+      ts[1] = rec_ts >> 16;
+      ts[2] = rec_ts >> 8;
+      ts[3] = rec_ts;
+   }
+   else
+      memcpy(ts, &rec_ts, sizeof(ts));
+
+   def_pending[mesg_type] = true;
+   if ((write_def_rec(mesg_type, true) != 0) ||
+       (fit_writer_write(&fit_w, &mesg_type, sizeof(mesg_type)) != 0) ||
+       (fit_writer_write(&fit_w, ts, sizeof(ts)) != 0) ||
+       (fit_writer_write(&fit_w, buf, def->data_mesg_len) != 0))
+      return -1;
+   return 0;
+}
+
+// write data record in buf, and its definition before it if it was not written yet. in --fit output of a time
+// window, a compressed timestamp record whose time offset does not give its timestamp after the last timestamp
+// of the output file (the record before it was left out) is written with timestamp field
+static int32_t write_data_mesg (uint8_t mesg_type) {
+   if (fit_out) {
+      if (window && (rec_ts != TIMESTAMP_INVALID)) {
+         if ((rec_hdr & FIT_HDR_TIME_REC_BIT) && (!out_last_ts_valid || (ct_timestamp(out_last_ts, rec_hdr) != rec_ts))) {
+            out_last_ts = rec_ts;
+            out_last_ts_valid = true;
+            return write_expanded(mesg_type);
+         }
+         out_last_ts = rec_ts;
+         out_last_ts_valid = true;
+      }
+      if (def_pending[mesg_type] && (write_def_rec(mesg_type, false) != 0))
+         return -1;
+      def_pending[mesg_type] = false;
+      if ((fit_writer_write(&fit_w, &rec_hdr, sizeof(rec_hdr)) != 0) || (fit_writer_write(&fit_w, buf, mesg_type_def[mesg_type]->data_mesg_len) != 0))
+         return -1;
+   }
+   else if (ndjson)
+      print_json_mesg(mesg_type);
+   else {
+      if (def_pending[mesg_type])
+         print_def_mesg(mesg_type);
+      def_pending[mesg_type] = false;
+      print_data_mesg(mesg_type);
+   }
+   return 0;
+}
+
+// read one record from FIT file and write it
+// return 0 on success, -1 on error
+static int32_t process_record (void) {
+   uint32_t offset = FIT_FILE_HDR_SIZE + fit_data_read;
+   uint8_t mesg_type;
    uint16_t data_size;
-   FIT_FILE_HDR fit_file_hdr;                         // FIT file header                   
-   uint8_t mesg_type;                           // last read message type
-   _fit_mesg_def *fit_mesg_def_ptr;                   // address of last message def
 
-   // print general license note
-   printf("\
-******************************************************************************\n\
-   fit2csv (V2.0) Copyright (C) 2024  Yoram Finder\n\
-   This program comes with ABSOLUTELY NO WARRANTY;\n\
-   This is free software, and you are welcome to redistribute it under the\n\
-   GNU License (https://www.gnu.org/licenses/) conditions;\n\
-******************************************************************************\n");
+   // read fit record header
+   if (fit_read(&rec_hdr, sizeof(rec_hdr)) < sizeof(rec_hdr))
+      return -1;
 
-   if (argc < 3) {
-      fprintf(stderr, "Missing arguments\n");
-      fprintf(stderr, "USAGE: fit2csv <FIT_file_name> <CSV_file_name>\n");
-      return 1;
+   // check if definition message record or data record (compressed timestamp header has no definition bit)
+   if ((rec_hdr & (FIT_HDR_TIME_REC_BIT | FIT_HDR_TYPE_DEF_BIT)) == FIT_HDR_TYPE_DEF_BIT) {
+      // read definition message
+      if (add_new_def_mesg() == NULL)
+         return -1;
+
+      mesg_type = rec_hdr & FIT_HDR_TYPE_MASK;
+      def_offsets[mesg_type] = offset;
+      if ((units || ndjson || compact) && (set_mesg_conv(mesg_type) != 0))
+         return -1;
+      if (window)
+         def_pending[mesg_type] = true;
+      else if (fit_out)
+         return write_def_rec(mesg_type, false);
+      else if (!ndjson)
+         print_def_mesg(mesg_type);
+      return 0;
+   }
+
+   // reading data message
+   // check if Compressed Timestamp Header. If it doeas get mesg_type accordingly
+   if (rec_hdr & FIT_HDR_TIME_REC_BIT)
+      mesg_type = (rec_hdr & FIT_HDR_TIME_TYPE_MASK) >> FIT_HDR_TIME_TYPE_SHIFT;
+   else
+      mesg_type = rec_hdr & FIT_HDR_TYPE_MASK;
+
+   // validate mesg_type
+   if (mesg_type_def[mesg_type] == NULL) {
+      fprintf(stderr, "DATA record with wrong message_type number: %d\n", mesg_type);
+      return -1;
+   }
+
+   data_size = mesg_type_def[mesg_type]->data_mesg_len;
+   if (fit_read(buf, data_size) < data_size)
+      return -1;
+
+   if ((!window || in_window(mesg_type)) && !window_done && (write_data_mesg(mesg_type) != 0))
+      return -1;
+
+   // track developer fields descriptions, for the definitions that follow
+   if (fit_dev_add_mesg(&dev_table, mesg_type_def[mesg_type]->global_mesg_num, mesg_type_def[mesg_type]->fields, mesg_type_def[mesg_type]->num_fields, buf) != 0) {
+      fprintf(stderr, "Failed to allocate memory for developer fields, %s\n", strerror(errno));
+      return -1;
    }
+   return 0;
+}
+
+// read record at file offset. return 0 on success, -1 on error
+static int32_t process_record_at (uint32_t offset) {
+   if (fseek(fit_f, offset, SEEK_SET) != 0) {
+      fprintf(stderr, "Failed to seek in FIT file, %s\n", strerror(errno));
+      return -1;
+   }
+   fit_data_read = offset - FIT_FILE_HDR_SIZE;
+   return process_record();
+}
+
+// replay order of records read before checkpoint: developer fields descriptions and definitions
+typedef struct {
+   uint32_t offset;
+   uint32_t def_offset;                            // definition of description record, 0 for definition record
+} _replay_rec;
+
+// check if definition record at file offset is held by a local message type, so it is not read again
+static bool def_active (uint32_t offset) {
+   int32_t i;
+
+   for (i = 0; i <= FIT_HDR_TYPE_MASK; i++) {
+      if (def_offsets[i] == offset)
+         return true;
+   }
+   return false;
+}
+
+static int32_t cmp_replay_rec (const void *a, const void *b) {
+   const _replay_rec *ra = a, *rb = b;
+
+   return (ra->offset > rb->offset) - (ra->offset < rb->offset);
+}
+
+// with sidecar index of file with monotonic timestamps, skip to the last checkpoint before the window:
+// read the records before the first timestamp, the developer fields descriptions and the definitions
+// the checkpoint needs, in file order, and continue from the checkpoint.
+// return 0 on success (also when there is no usable index), -1 on error
+static int32_t jump_to_window (const int8_t *name, FIT_FILE_HDR *fit_file_hdr) {
+   int8_t *idx_name;
+   _fit_index idx;
+   const _fit_index_checkpoint *cp;
+   _replay_rec *replay = NULL;
+   uint32_t n = 0;
+   long file_size;
+   FIT_UINT16 file_crc;
+   int32_t r = -1;
+   uint32_t i;
+
+   // index must be of this version of the file, its size and file CRC are compared
+   if ((fseek(fit_f, 0, SEEK_END) != 0) || ((file_size = ftell(fit_f)) < 0) ||
+       (fseek(fit_f, FIT_FILE_HDR_SIZE + fit_file_hdr->data_size, SEEK_SET) != 0) || (fread(&file_crc, 1, sizeof(file_crc), fit_f) != sizeof(file_crc)) ||
+       (fseek(fit_f, FIT_FILE_HDR_SIZE, SEEK_SET) != 0)) {
+      fprintf(stderr, "Failed to seek in FIT file, %s\n", strerror(errno));
+      return -1;
+   }
+
+   if ((idx_name = malloc(strlen(name) + sizeof(FIT_INDEX_SUFFIX))) == NULL) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      return -1;
+   }
+   sprintf(idx_name, "%s%s", name, FIT_INDEX_SUFFIX);
+   r = fit_index_read(&idx, idx_name, file_size, file_crc);
+   free(idx_name);
+   if (r != 0)
+      return 0;
+
+   window_stop = idx.hdr.monotonic;
+   if ((cp = fit_index_find(&idx, window_from)) == NULL) {
+      fit_index_free(&idx);
+      return 0;
+   }
+
+   r = -1;
+   if ((replay = malloc((idx.hdr.num_dev_recs + FIT_HDR_TYPE_MASK+1) * sizeof(_replay_rec))) == NULL) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      goto done;
+   }
+   for (i = 0; (i < idx.hdr.num_dev_recs) && (idx.dev_recs[i].data_offset < cp->offset); i++, n++) {
+      replay[n].offset = idx.dev_recs[i].data_offset;
+      replay[n].def_offset = idx.dev_recs[i].def_offset;
+   }
+   for (i = 0; i <= FIT_HDR_TYPE_MASK; i++) {
+      if (cp->def_offsets[i] != 0) {
+         replay[n].offset = cp->def_offsets[i];
+         replay[n++].def_offset = 0;
+      }
+   }
+   qsort(replay, n, sizeof(_replay_rec), cmp_replay_rec);
+
+   while (fit_data_read < idx.hdr.head_end - FIT_FILE_HDR_SIZE) {
+      if (process_record() != 0)
+         goto done;
+   }
+
+   for (i = 0; i < n; i++) {
+      if ((replay[i].def_offset != 0) && !def_active(replay[i].def_offset) && (process_record_at(replay[i].def_offset) != 0))
+         goto done;
+      if (((replay[i].def_offset != 0) || !def_active(replay[i].offset)) && (process_record_at(replay[i].offset) != 0))
+         goto done;
+   }
+
+   if (fseek(fit_f, cp->offset, SEEK_SET) != 0) {
+      fprintf(stderr, "Failed to seek in FIT file, %s\n", strerror(errno));
+      goto done;
+   }
+   fit_data_read = cp->offset - FIT_FILE_HDR_SIZE;
+   jumped = true;
+   r = 0;
+
+done:
+   free(replay);
+   fit_index_free(&idx);
+   return r;
+}
+
+/*******************************************************************/
+/* verify, fix CRC and stats modes                                 */
+/* each file is read to memory and its records framing is walked   */
+/* without formatting values. files are shared between threads.    */
+/*******************************************************************/
+enum {
+   MODE_CONVERT = 0,
+   MODE_VERIFY,
+   MODE_FIX_CRC,
+   MODE_STATS,
+   MODE_INDEX
+};
+
+#define FILE_ERR_IO        -1          // file could not be read or written
+
+typedef struct {
+   const int8_t *name;
+   int32_t error;                      // _fit_scan_err or FILE_ERR_IO
+   int32_t io_errno;
+   uint32_t offset;
+   bool fixed;
+} _file_check;
+
+static int32_t check_mode;
+static _file_check *checks;
+static int32_t num_checks;
+static int32_t next_check;
+
+// read whole file to buf, grow buf if needed. return file size or -1 on error
+static long read_file (const int8_t *name, uint8_t **file_buf, long *file_buf_size) {
+   FILE *f;
+   long size;
+   uint8_t *p;
+
+   if ((f = fopen(name, "rb")) == NULL)
+      return -1;
+
+   if ((fseek(f, 0, SEEK_END) != 0) || ((size = ftell(f)) < 0) || (fseek(f, 0, SEEK_SET) != 0)) {
+      fclose(f);
+      return -1;
+   }
+
+   if (size > *file_buf_size) {
+      if ((p = realloc(*file_buf, size)) == NULL) {
+         fclose(f);
+         return -1;
+      }
+      *file_buf = p;
+      *file_buf_size = size;
+   }
+
+   if (fread(*file_buf, 1, size, f) != size) {
+      fclose(f);
+      return -1;
+   }
+
+   fclose(f);
+   return size;
+}
+
+// write header CRC and file CRC in place, only if they differ from the calculated ones
+static bool fix_file_crc (_file_check *check, _fit_scan *scan) {
+   FILE *f;
+   FIT_UINT16 hdr_crc;
+   FIT_UINT16 file_crc;
+   FIT_UINT16 old_crc;
+   bool fix_hdr = false;
+
+   // file CRC covers file header, with its new CRC
+   if (scan->hdr_size >= FIT_FILE_HDR_SIZE) {
+      hdr_crc = fit_scan_hdr_crc(scan);
+      fix_hdr = (hdr_crc != scan->hdr.crc);
+      file_crc = fit_crc16_update(hdr_crc, &hdr_crc, sizeof(hdr_crc));
+      file_crc = fit_crc16_update(file_crc, scan->file + FIT_FILE_HDR_SIZE, scan->data_end - FIT_FILE_HDR_SIZE);
+   }
+   else
+      file_crc = fit_scan_file_crc(scan);
+   memcpy(&old_crc, scan->file + scan->data_end, sizeof(old_crc));
+
+   if (!fix_hdr && (file_crc == old_crc))
+      return true;
+
+   if ((f = fopen(check->name, "r+b")) == NULL)
+      return false;
+
+   if (fix_hdr && ((fseek(f, FIT_FILE_HDR_SIZE-2, SEEK_SET) != 0) || (fwrite(&hdr_crc, 1, sizeof(hdr_crc), f) != sizeof(hdr_crc)))) {
+      fclose(f);
+      return false;
+   }
+
+   if ((fseek(f, scan->data_end, SEEK_SET) != 0) || (fwrite(&file_crc, 1, sizeof(file_crc), f) != sizeof(file_crc))) {
+      fclose(f);
+      return false;
+   }
+
+   if (fclose(f) != 0)
+      return false;
+
+   check->fixed = true;
+   return true;
+}
+
+// check one file, in stats mode add its records to stats
+static void check_file (_file_check *check, uint8_t **file_buf, long *file_buf_size, _fit_stats *stats) {
+   _fit_scan scan;
+   _fit_scan_rec rec;
+   _fit_index idx;
+   int8_t *idx_name;
+   long size;
+
+   if ((size = read_file(check->name, file_buf, file_buf_size)) < 0) {
+      check->error = FILE_ERR_IO;
+      check->io_errno = errno;
+      return;
+   }
+
+   // when fixing CRCs, bad header CRC is expected
+   fit_scan_open(&scan, *file_buf, size);
+   if (check_mode != MODE_FIX_CRC)
+      fit_scan_check_hdr_crc(&scan);
+
+   // records of a file with bad framing are counted up to the error
+   fit_index_init(&idx);
+   if (stats != NULL)
+      fit_stats_start_file(stats);
+   while (fit_scan_next(&scan, &rec) > 0) {
+      if (((stats != NULL) && (fit_stats_add(stats, &rec) != 0)) ||
+          ((check_mode == MODE_INDEX) && (fit_index_add(&idx, &scan, &rec) != 0))) {
+         if (stats != NULL)
+            fit_stats_flush(stats);
+         fit_index_free(&idx);
+         check->error = FILE_ERR_IO;
+         check->io_errno = ENOMEM;
+         return;
+      }
+   }
+   if (stats != NULL)
+      fit_stats_flush(stats);
+
+   if (check_mode != MODE_FIX_CRC)
+      fit_scan_check_crc(&scan);
+
+   if (scan.error != FIT_SCAN_OK) {
+      fit_index_free(&idx);
+      check->error = scan.error;
+      check->offset = scan.err_offset;
+      return;
+   }
+
+   // index file name is FIT file name with ".idx" suffix
+   if (check_mode == MODE_INDEX) {
+      if ((idx_name = malloc(strlen(check->name) + sizeof(FIT_INDEX_SUFFIX))) != NULL) {
+         sprintf(idx_name, "%s%s", check->name, FIT_INDEX_SUFFIX);
+         if (fit_index_write(&idx, &scan, idx_name) != 0) {
+            check->error = FILE_ERR_IO;
+            check->io_errno = errno;
+         }
+         free(idx_name);
+      }
+      else {
+         check->error = FILE_ERR_IO;
+         check->io_errno = ENOMEM;
+      }
+      fit_index_free(&idx);
+   }
+
+   if ((check_mode == MODE_FIX_CRC) && !fix_file_crc(check, &scan)) {
+      check->error = FILE_ERR_IO;
+      check->io_errno = errno;
+   }
+}
+
+// thread function - check files until all were taken. arg is the thread stats in stats mode
+static void *check_files (void *arg) {
+   uint8_t *file_buf = NULL;
+   long file_buf_size = 0;
+   int32_t i;
+
+   while ((i = __atomic_fetch_add(&next_check, 1, __ATOMIC_RELAXED)) < num_checks)
+      check_file(&checks[i], &file_buf, &file_buf_size, arg);
+
+   free(file_buf);
+   return NULL;
+}
+
+// print JSON string, escape quotes, backslashes and control characters
+static void print_json_str (FILE *f, const int8_t *str) {
+   const uint8_t *p = (const uint8_t *)str;
+
+   fputc('"', f);
+   for (; *p; p++) {
+      if ((*p == '"') || (*p == '\\'))
+         fprintf(f, "\\%c", *p);
+      else if (*p < 0x20)
+         fprintf(f, "\\u%04x", *p);
+      else
+         fputc(*p, f);
+   }
+   fputc('"', f);
+}
+
+// print JSON number, NaN and infinity are not JSON numbers
+static void print_json_double (double v) {
+   int8_t s[FLOAT_STR_SIZE];
+
+   if (!isfinite(v))
+      printf("null");
+   else {
+      format_float64(v, s);
+      printf("%s", s);
+   }
+}
+
+// print JSON array of all fields statistics
+static void print_stats (_fit_stats *stats) {
+   _fit_field_stats **sorted;
+   _fit_field_stats *acc;
+   char *title;
+   uint32_t i;
+   int32_t b;
+   bool first;
+
+   if ((sorted = fit_stats_sorted(stats)) == NULL) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      printf("null");
+      return;
+   }
+
+   printf("[");
+   for (i = 0; i < stats->num_fields; i++) {
+      acc = sorted[i];
+      printf(i ? ",\n{\"mesg\":" : "\n{\"mesg\":");
+      print_json_str(stdout, get_mesg_title(acc->global_mesg_num));
+      printf(",\"m_num\":%d,\"field\":", acc->global_mesg_num);
+      title = get_field_title(acc->global_mesg_num, acc->field_num);
+      print_json_str(stdout, (title != NULL) ? title : "unknown");
+      printf(",\"field_num\":%d,\"base_type\":%d,\"count\":%llu,\"invalid\":%llu", acc->field_num, acc->base_type,
+             (unsigned long long)acc->count, (unsigned long long)acc->invalid);
+
+      if ((acc->count > 0) && (acc->kind != FIT_STATS_STRING)) {
+         if (acc->kind == FIT_STATS_SIGNED)
+            printf(",\"min\":%lld,\"max\":%lld", (long long)acc->min.i, (long long)acc->max.i);
+         else if (acc->kind == FIT_STATS_UNSIGNED)
+            printf(",\"min\":%llu,\"max\":%llu", (unsigned long long)acc->min.u, (unsigned long long)acc->max.u);
+         else {
+            printf(",\"min\":");
+            print_json_double(acc->min.f);
+            printf(",\"max\":");
+            print_json_double(acc->max.f);
+         }
+         printf(",\"mean\":");
+         print_json_double(acc->sum / acc->count);
+
+         // [bucket, count] of non empty buckets
+         printf(",\"histogram\":[");
+         first = true;
+         for (b = 0; b < FIT_STATS_HIST_BUCKETS; b++) {
+            if (acc->hist[b] == 0)
+               continue;
+            printf(first ? "[%d,%llu]" : ",[%d,%llu]", b - FIT_STATS_HIST_BUCKETS/2, (unsigned long long)acc->hist[b]);
+            first = false;
+         }
+         printf("]");
+      }
+      printf("}");
+   }
+   printf("%s]", stats->num_fields ? "\n" : "");
+
+   free(sorted);
+}
+
+// print JSON report of all files to stdout
+static void print_check_report (_fit_stats *stats) {
+   int32_t i;
+   int32_t failed = 0;
+   int32_t fixed = 0;
+   bool first = true;
+
+   for (i = 0; i < num_checks; i++) {
+      if (checks[i].error != FIT_SCAN_OK)
+         failed++;
+      else if (checks[i].fixed)
+         fixed++;
+   }
+
+   if (check_mode == MODE_VERIFY)
+      printf("{\"mode\":\"verify\",\"files\":%d,\"ok\":%d,\"failed\":%d,\"failures\":[", num_checks, num_checks-failed, failed);
+   else if (check_mode == MODE_INDEX)
+      printf("{\"mode\":\"index\",\"files\":%d,\"ok\":%d,\"failed\":%d,\"failures\":[", num_checks, num_checks-failed, failed);
+   else if (check_mode == MODE_STATS)
+      printf("{\"mode\":\"stats\",\"files\":%d,\"ok\":%d,\"failed\":%d,\"failures\":[", num_checks, num_checks-failed, failed);
+   else
+      printf("{\"mode\":\"fix-crc\",\"files\":%d,\"fixed\":%d,\"unchanged\":%d,\"failed\":%d,\"failures\":[", num_checks, fixed, num_checks-failed-fixed, failed);
+
+   for (i = 0; i < num_checks; i++) {
+      if (checks[i].error == FIT_SCAN_OK)
+         continue;
+      printf(first ? "\n{\"file\":" : ",\n{\"file\":");
+      first = false;
+      print_json_str(stdout, checks[i].name);
+      printf(",\"error\":");
+      if (checks[i].error == FILE_ERR_IO)
+         print_json_str(stdout, strerror(checks[i].io_errno));
+      else
+         print_json_str(stdout, fit_scan_error_str(checks[i].error));
+      if (checks[i].error != FILE_ERR_IO)
+         printf(",\"offset\":%u", checks[i].offset);
+      printf("}");
+   }
+   printf("%s]", first ? "" : "\n");
+
+   if (stats != NULL) {
+      printf(",\"fields\":");
+      print_stats(stats);
+   }
+   printf("}\n");
+}
+
+// check all files with jobs threads. return number of failed files
+static int32_t check_all_files (int8_t *names[], int32_t n, int32_t jobs) {
+   pthread_t *threads;
+   _fit_stats *stats = NULL;           // stats mode: accumulators of each thread
+   int32_t i;
+   int32_t started;
+   int32_t failed = 0;
+
+   if ((checks = calloc(n, sizeof(_file_check))) == NULL) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      return n;
+   }
+   for (i = 0; i < n; i++)
+      checks[i].name = names[i];
+   num_checks = n;
+   next_check = 0;
+
+   if (jobs > n)
+      jobs = n;
+   if (((threads = malloc(jobs * sizeof(pthread_t))) == NULL) ||
+       ((check_mode == MODE_STATS) && ((stats = malloc(jobs * sizeof(_fit_stats))) == NULL))) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      free(threads);
+      free(checks);
+      return n;
+   }
+   for (i = 0; (stats != NULL) && (i < jobs); i++)
+      fit_stats_init(&stats[i]);
+
+   // if a thread can not be started, the started ones (or this one) do its share
+   for (started = 0; started < jobs; started++) {
+      if (pthread_create(&threads[started], NULL, check_files, (stats != NULL) ? &stats[started] : NULL) != 0)
+         break;
+   }
+   if (started == 0)
+      check_files(stats);
+   for (i = 0; i < started; i++)
+      pthread_join(threads[i], NULL);
+
+   // merge threads statistics to the first thread ones
+   for (i = 1; (stats != NULL) && (i < started); i++) {
+      if (fit_stats_merge(&stats[0], &stats[i]) != 0) {
+         fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+         break;
+      }
+   }
+
+   print_check_report(stats);
+
+   for (i = 0; i < n; i++) {
+      if (checks[i].error != FIT_SCAN_OK)
+         failed++;
+   }
+
+   for (i = 0; (stats != NULL) && (i < jobs); i++)
+      fit_stats_free(&stats[i]);
+   free(stats);
+   free(threads);
+   free(checks);
+   return failed;
+}
+
+// convert one FIT file to CSV, NDJSON or trimmed FIT file. all state of the previous file is reset first
+// return 0 on success, 1 on error
+static int32_t convert_file (const int8_t *fit_name, const int8_t *out_name, bool to_stdout) {
+   int32_t r;
+   FIT_FILE_HDR fit_file_hdr;                         // FIT file header
+
+   reset_state();
 
    // open fit file
-   if ((fit_f = fopen(argv[1], "rb")) == NULL) {
-      fprintf(stderr, "Failed to open FIT file: %s, %s\n", argv[1], strerror(errno));
-      return 1;
+   if ((fit_f = fopen(fit_name, "rb")) == NULL) {
+      fprintf(stderr, "Failed to open FIT file: %s, %s\n", fit_name, strerror(errno));
+      goto done_with_error;
    }
 
    // open csvfile
-   if ((csv_f = fopen(argv[2], "w")) == NULL) {
-      fprintf(stderr, "Failed to open CSV file: %s, %s\n", argv[2], strerror(errno));
-      return 1;
+   if (fit_out)
+      csv_f = NULL;
+   else if (to_stdout)
+      csv_f = stdout;
+   else if ((csv_f = fopen(out_name, "w")) == NULL) {
+      fprintf(stderr, "Failed to open CSV file: %s, %s\n", out_name, strerror(errno));
+      goto done_with_error;
    }
 
-   // allocate local buf
-   if ((buf = malloc(FIT_MAX_MESG_SIZE)) == NULL) {
+   // allocate local buf, it is kept for the next files
+   if ((buf == NULL) && ((buf = malloc(FIT_MAX_MESG_SIZE)) == NULL)) {
       fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
-      fclose(fit_f);
-      return 1;
+      goto done_with_error;
    }
 
-   // init all fit_mesg_def pointers to NULL
-   memset(&mesg_type_def, 0, sizeof(mesg_type_def));
-
    // read fit file header, but first init header record
    memset(&fit_file_hdr, 0, sizeof(fit_file_hdr));
    if ((r = fit_read(&fit_file_hdr, FIT_FILE_HDR_SIZE)) < FIT_FILE_HDR_SIZE)
@@ -433,58 +1649,41 @@ int32_t main (int32_t argc, int8_t *argv[]) {
    }
 
    // print file header
-   print_file_header(&fit_file_hdr);
+   if (fit_out) {
+      if (fit_writer_open(&fit_w, out_name, fit_file_hdr.protocol_version, fit_file_hdr.profile_version) != 0)
+         goto done_with_error;
+   }
+   else if (!ndjson)
+      print_file_header(&fit_file_hdr);
    
    // file header crc check succeeded. now reset crc to check whole file CRC
    crc = 0;
    fit_data_read = 0;
 
-   while ((fit_data_read < fit_file_hdr.data_size) && !feof(fit_f)) {
-      // read fit record header
-      if ((r = fit_read(&rec_hdr, sizeof(rec_hdr))) < sizeof(rec_hdr))
-         goto done_with_error;
-
-      // check if definition message record or data record<
-      if (rec_hdr & FIT_HDR_TYPE_DEF_BIT) {
-         // read definition message
-         if ((fit_mesg_def_ptr = add_new_def_mesg()) == NULL)
-            goto done_with_error;
-
-         mesg_type = rec_hdr & FIT_HDR_TYPE_MASK;
-         print_def_mesg(mesg_type);
-      }
-      else {
-         // reading data message
-         // check if Compressed Timestamp Header. If it doeas get mesg_type accordingly
-         if (rec_hdr & FIT_HDR_TIME_REC_BIT) {
-            mesg_type = (rec_hdr & FIT_HDR_TIME_TYPE_MASK) >> FIT_HDR_TIME_TYPE_SHIFT;
-         }
-         else
-            mesg_type = rec_hdr & FIT_HDR_TYPE_MASK;
-
-         // validate mesg_type
-         if (mesg_type_def[mesg_type] == NULL) {
-            fprintf(stderr, "DATA record with wrong message_type number: %d\n", mesg_type);
-            goto done_with_error;             
-         }
-
-         data_size = mesg_type_def[mesg_type]->data_mesg_len;
-         if ((r = fit_read(buf, data_size)) < data_size)
-            goto done_with_error; 
+   // file CRC is not checked when records are skipped by index
+   if (window && (window_from > 0) && (jump_to_window(fit_name, &fit_file_hdr) != 0))
+      goto done_with_error;
 
-         print_data_mesg(mesg_type); 
-      }
+   while ((fit_data_read < fit_file_hdr.data_size) && !feof(fit_f) && !window_done) {
+      if (process_record() != 0)
+         goto done_with_error;
    }
 
    // if we got here due to reading all data byts, check file crc
    FIT_UINT16 file_crc;
-   if (!feof(fit_f)) {
+   if (jumped || window_done) {
+      if (!fit_out && !ndjson)
+         fprintf(csv_f, "END,\n");
+   }
+   else if (!feof(fit_f)) {
       // this read must be done directly so that global CRC variable will not be updated!!
       if ((r = fread(&file_crc, 1, sizeof(file_crc), fit_f)) < sizeof(file_crc))
          goto done_with_error;
 
-      if (crc == file_crc)
-         fprintf(csv_f, "END,\n");
+      if (crc == file_crc) {
+         if (!fit_out && !ndjson)
+            fprintf(csv_f, "END,\n");
+      }
       else{
          fprintf(stderr, "Failed to verify FIT file CRC\n");
          goto done_with_error;
@@ -496,8 +1695,18 @@ int32_t main (int32_t argc, int8_t *argv[]) {
       goto done_with_error;
    }
 
+   if (fit_out && (fit_writer_close(&fit_w) != 0))
+      goto done_with_error;
+   if ((csv_f != NULL) && (csv_f != stdout)) {
+      r = fclose(csv_f);
+      csv_f = NULL;
+      if (r != 0) {
+         fprintf(stderr, "Failed to write file: %s, %s\n", out_name, strerror(errno));
+         goto done_with_error;
+      }
+   }
+
    //done ok;
-   printf("Converting FIT to CSV file completed successfully\n");
    cleanup ();
    return 0;
 
@@ -507,3 +1716,147 @@ done_with_error:
    return 1;
 }
 
+// --daemon: job of worker process
+static int32_t daemon_job (const char *in_name, const char *out_name) {
+   return convert_file(in_name, out_name, false);
+}
+
+int32_t main (int32_t argc, int8_t *argv[]) {
+   int32_t r;                                
+   int32_t argi;                                      // first file name argument
+   int32_t jobs = 0;                                  // number of checking threads, or daemon worker processes
+   bool to_stdout;                                    // output file name is "-"
+   _fit_daemon_cfg daemon = {NULL, NULL, NULL, 0, 64, daemon_job};
+
+   // read options
+   check_mode = MODE_CONVERT;
+   for (argi = 1; (argi < argc) && (strncmp(argv[argi], "--", 2) == 0); argi++) {
+      if (strcmp(argv[argi], "--verify-only") == 0)
+         check_mode = MODE_VERIFY;
+      else if (strcmp(argv[argi], "--fix-crc") == 0)
+         check_mode = MODE_FIX_CRC;
+      else if (strcmp(argv[argi], "--stats") == 0)
+         check_mode = MODE_STATS;
+      else if (strcmp(argv[argi], "--make-index") == 0)
+         check_mode = MODE_INDEX;
+      else if (strncmp(argv[argi], "--jobs=", 7) == 0)
+         jobs = atoi(argv[argi]+7);
+      else if (strcmp(argv[argi], "--real-floats") == 0)
+         real_floats = true;
+      else if (strcmp(argv[argi], "--units") == 0)
+         units = true;
+      else if (strcmp(argv[argi], "--ndjson") == 0)
+         ndjson = true;
+      else if (strcmp(argv[argi], "--skip-invalid") == 0)
+         skip_invalid = true;
+      else if (strcmp(argv[argi], "--compact") == 0)
+         compact = true;
+      else if (strcmp(argv[argi], "--bytes=hex") == 0)
+         bytes_format = BYTES_HEX;
+      else if (strcmp(argv[argi], "--bytes=base64") == 0)
+         bytes_format = BYTES_BASE64;
+      else if (strncmp(argv[argi], "--from=", 7) == 0) {
+         if (parse_fit_time(argv[argi]+7, strlen(argv[argi]+7), &window_from) != 0) {
+            fprintf(stderr, "Wrong time: %s\n", argv[argi]+7);
+            return 1;
+         }
+         window = true;
+      }
+      else if (strncmp(argv[argi], "--to=", 5) == 0) {
+         if (parse_fit_time(argv[argi]+5, strlen(argv[argi]+5), &window_to) != 0) {
+            fprintf(stderr, "Wrong time: %s\n", argv[argi]+5);
+            return 1;
+         }
+         window = true;
+      }
+      else if (strcmp(argv[argi], "--fit") == 0)
+         fit_out = true;
+      else if (strncmp(argv[argi], "--daemon=", 9) == 0)
+         daemon.socket_name = argv[argi]+9;
+      else if (strncmp(argv[argi], "--spool=", 8) == 0)
+         daemon.spool_dir = argv[argi]+8;
+      else if (strncmp(argv[argi], "--queue=", 8) == 0)
+         daemon.queue_size = atoi(argv[argi]+8);
+      else {
+         fprintf(stderr, "Unknown option: %s\n", argv[argi]);
+         return 1;
+      }
+   }
+
+   // print general license note. in verify and fix modes, and when output is written to stdout, stdout is used for the report
+   to_stdout = (check_mode == MODE_CONVERT) && (argc - argi >= 2) && (strcmp(argv[argi+1], "-") == 0);
+   fprintf(((check_mode == MODE_CONVERT) && !to_stdout) ? stdout : stderr, "\
+******************************************************************************\n\
+   fit2csv (V2.0) Copyright (C) 2024  Yoram Finder\n\
+   This program comes with ABSOLUTELY NO WARRANTY;\n\
+   This is free software, and you are welcome to redistribute it under the\n\
+   GNU License (https://www.gnu.org/licenses/) conditions;\n\
+******************************************************************************\n");
+
+   // --daemon: files are converted by worker processes, with the same options
+   if (daemon.socket_name != NULL) {
+      if ((check_mode != MODE_CONVERT) || (argc - argi != 0) || (daemon.queue_size <= 0) || (fit_out && ndjson)) {
+         fprintf(stderr, "Wrong daemon arguments\n");
+         return 1;
+      }
+#ifdef _SC_NPROCESSORS_ONLN
+      if (jobs <= 0)
+         jobs = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+      if (jobs <= 0)
+         jobs = 1;
+      daemon.workers = jobs;
+      daemon.out_ext = fit_out ? ".fit" : ndjson ? ".ndjson" : ".csv";
+      r = fit_daemon_run(&daemon);
+      free(buf);
+      return (r == 0) ? 0 : 1;
+   }
+
+   if ((check_mode != MODE_CONVERT) && (argc - argi >= 1)) {
+#ifdef _SC_NPROCESSORS_ONLN
+      if (jobs <= 0)
+         jobs = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+      if (jobs <= 0)
+         jobs = 1;
+      return (check_all_files(&argv[argi], argc - argi, jobs) == 0) ? 0 : 1;
+   }
+
+   if ((check_mode != MODE_CONVERT) || (argc - argi < 2)) {
+      fprintf(stderr, "Missing arguments\n");
+      fprintf(stderr, "USAGE: fit2csv [--real-floats] [--units] [--bytes=hex|base64] [--compact] <FIT_file_name> <CSV_file_name>\n");
+      fprintf(stderr, "       fit2csv --ndjson [--skip-invalid] [--units] <FIT_file_name> <NDJSON_file_name>\n");
+      fprintf(stderr, "       fit2csv [--from=TIME] [--to=TIME] [--fit] [options] <FIT_file_name> <CSV_or_FIT_file_name>\n");
+      fprintf(stderr, "       fit2csv --make-index [--jobs=N] <FIT_file_name> [<FIT_file_name> ...]\n");
+      fprintf(stderr, "       fit2csv --verify-only [--jobs=N] <FIT_file_name> [<FIT_file_name> ...]\n");
+      fprintf(stderr, "       fit2csv --fix-crc [--jobs=N] <FIT_file_name> [<FIT_file_name> ...]\n");
+      fprintf(stderr, "       fit2csv --stats [--jobs=N] <FIT_file_name> [<FIT_file_name> ...]\n");
+      fprintf(stderr, "       fit2csv --daemon=SOCKET [--spool=DIR] [--jobs=N] [--queue=N] [options]\n");
+      fprintf(stderr, "       --real-floats  write float values as decimal numbers instead of their binary representation\n");
+      fprintf(stderr, "       --units  write scaled values in physical units (the CSV file can not be converted back to FIT)\n");
+      fprintf(stderr, "       --bytes=hex|base64  write BYTE fields as hex or base64 text instead of \"010/234/255/\"\n");
+      fprintf(stderr, "       --compact  write integers without zero padding and invalid values as empty values\n");
+      fprintf(stderr, "       --ndjson  write one JSON object per data record instead of CSV lines\n");
+      fprintf(stderr, "       --skip-invalid  leave out fields with invalid values from JSON objects\n");
+      fprintf(stderr, "       --from=TIME --to=TIME  write only records in time window, TIME is FIT timestamp or UTC time (2021-09-09T14:00:00)\n");
+      fprintf(stderr, "       --fit  write records to a FIT file instead of CSV\n");
+      fprintf(stderr, "       --make-index  write <FIT_file_name>.idx sidecar index, used by --from to start close to the window\n");
+      fprintf(stderr, "       output file name \"-\" writes to stdout\n");
+      fprintf(stderr, "       --jobs=N  check files with N threads (default - number of CPUs)\n");
+      fprintf(stderr, "       --daemon=SOCKET  convert jobs of Unix domain socket and FIT files of spool directory with N worker processes\n");
+      fprintf(stderr, "       --queue=N  jobs waiting for a worker, more are refused (default 64)\n");
+      return 1;
+   }
+
+   if (fit_out && (ndjson || to_stdout)) {
+      fprintf(stderr, "--fit can not be used with --ndjson or output to stdout\n");
+      return 1;
+   }
+
+   r = convert_file(argv[argi], argv[argi+1], to_stdout);
+   if (r == 0)
+      fprintf(to_stdout ? stderr : stdout, "Converting FIT to %s file completed successfully\n", fit_out ? "FIT" : ndjson ? "NDJSON" : "CSV");
+   free(buf);
+   return r;
+}
+
@@ -0,0 +1,694 @@
+/*
+
+   This code uses GARMIN FIT SDK V21.141.00 (https://developer.garmin.com/downloads/fit/sdk/FitSDKRelease_21.141.00.zip)
+   Under the Flexible and Interoperable Data Transfer (FIT) Protocol License:
+   (https://www.thisisant.com/developer/ant/licensing/flexible-and-interoperable-data-transfer-fit-protocol-license).
+
+	Load FIT files records to SQLite database.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include <sqlite3.h>
+
+#include <fit_example.h>
+
+#include <fit_titles.h>
+#include <fit_scan.h>
+#include <fit_reader.h>
+#include <fit_convert.h>
+#include <fit_dev.h>
+#include <fit_file.h>
+
+#define DEFAULT_BATCH_SIZE    100000         // rows inserted in one transaction
+#define MAX_PRAGMAS           32             // --pragma arguments
+#define SQL_SIZE              65536          // longest SQL statement: 255 + 255 developer fields columns
+#define NAME_SIZE             64             // longest table or column name
+#define TIMESTAMP_FIELD       253            // timestamp field number, same in all messages
+
+// pragmas for bulk loading, --pragma arguments are executed after them
+static const int8_t *bulk_pragmas[] = {
+   "synchronous=OFF",
+   "journal_mode=MEMORY",
+   "temp_store=MEMORY",
+   "cache_size=-262144"                      // 256MB
+};
+
+/****************************************************/
+/* tables and columns                               */
+/****************************************************/
+
+// table of global message, its columns are added when new fields show up
+typedef struct {
+   int8_t name[NAME_SIZE];
+   int8_t (*columns)[NAME_SIZE];
+   int32_t num_columns;
+   int32_t columns_size;
+} _table;
+
+static sqlite3 *db;
+static _table *tables[UINT16_MAX+1];         // tables of global messages, created on first use
+
+// field value kinds
+enum {
+   KIND_SIGNED = 0,
+   KIND_UNSIGNED,
+   KIND_FLOAT,
+   KIND_STRING,
+   KIND_BYTES
+};
+
+typedef struct {
+   FIT_FIT_BASE_TYPE base_type;
+   int32_t kind;
+   uint8_t t_size;
+   uint64_t invalid;
+   const int8_t *sql_type;
+} _sql_type;
+
+// fields of other base types are loaded as bytes
+static const _sql_type sql_types[] = {
+   {FIT_FIT_BASE_TYPE_ENUM, KIND_UNSIGNED, sizeof(uint8_t), FIT_ENUM_INVALID, "INTEGER"},
+   {FIT_FIT_BASE_TYPE_SINT8, KIND_SIGNED, sizeof(int8_t), (uint8_t)FIT_SINT8_INVALID, "INTEGER"},
+   {FIT_FIT_BASE_TYPE_UINT8, KIND_UNSIGNED, sizeof(uint8_t), FIT_UINT8_INVALID, "INTEGER"},
+   {FIT_FIT_BASE_TYPE_SINT16, KIND_SIGNED, sizeof(int16_t), (uint16_t)FIT_SINT16_INVALID, "INTEGER"},
+   {FIT_FIT_BASE_TYPE_UINT16, KIND_UNSIGNED, sizeof(uint16_t), FIT_UINT16_INVALID, "INTEGER"},
+   {FIT_FIT_BASE_TYPE_SINT32, KIND_SIGNED, sizeof(int32_t), (uint32_t)FIT_SINT32_INVALID, "INTEGER"},
+   {FIT_FIT_BASE_TYPE_UINT32, KIND_UNSIGNED, sizeof(uint32_t), FIT_UINT32_INVALID, "INTEGER"},
+   {FIT_FIT_BASE_TYPE_STRING, KIND_STRING, sizeof(uint8_t), 0, "TEXT"},
+   {FIT_FIT_BASE_TYPE_FLOAT32, KIND_FLOAT, sizeof(float), UINT32_MAX, "REAL"},
+   {FIT_FIT_BASE_TYPE_FLOAT64, KIND_FLOAT, sizeof(double), UINT64_MAX, "REAL"},
+   {FIT_FIT_BASE_TYPE_UINT8Z, KIND_UNSIGNED, sizeof(uint8_t), FIT_UINT8Z_INVALID, "INTEGER"},
+   {FIT_FIT_BASE_TYPE_UINT16Z, KIND_UNSIGNED, sizeof(uint16_t), FIT_UINT16Z_INVALID, "INTEGER"},
+   {FIT_FIT_BASE_TYPE_UINT32Z, KIND_UNSIGNED, sizeof(uint32_t), FIT_UINT32Z_INVALID, "INTEGER"},
+   {FIT_FIT_BASE_TYPE_SINT64, KIND_SIGNED, sizeof(int64_t), (uint64_t)FIT_SINT64_INVALID, "INTEGER"},
+   {FIT_FIT_BASE_TYPE_UINT64, KIND_UNSIGNED, sizeof(uint64_t), FIT_UINT64_INVALID, "INTEGER"},
+   {FIT_FIT_BASE_TYPE_UINT64Z, KIND_UNSIGNED, sizeof(uint64_t), FIT_UINT64Z_INVALID, "INTEGER"}
+};
+
+static const _sql_type bytes_type = {FIT_FIT_BASE_TYPE_BYTE, KIND_BYTES, sizeof(uint8_t), FIT_BYTE_INVALID, "BLOB"};
+
+static const _sql_type *get_sql_type (FIT_UINT8 base_type, uint8_t size) {
+   int32_t t;
+
+   for (t = 0; t < sizeof(sql_types)/sizeof(sql_types[0]); t++) {
+      if (sql_types[t].base_type == base_type)
+         return (size % sql_types[t].t_size == 0) ? &sql_types[t] : &bytes_type;
+   }
+   return &bytes_type;
+}
+
+// execute SQL statement without results. return false on error
+static bool exec_sql (const int8_t *sql) {
+   char *err = NULL;
+
+   if (sqlite3_exec(db, sql, NULL, NULL, &err) != SQLITE_OK) {
+      fprintf(stderr, "SQL error: %s (%s)\n", err ? err : sqlite3_errmsg(db), sql);
+      sqlite3_free(err);
+      return false;
+   }
+   return true;
+}
+
+static bool has_column (const _table *table, const int8_t *name) {
+   int32_t i;
+
+   for (i = 0; i < table->num_columns; i++) {
+      if (strcmp(table->columns[i], name) == 0)
+         return true;
+   }
+   return false;
+}
+
+static bool add_table_column (_table *table, const int8_t *name) {
+   int8_t (*p)[NAME_SIZE];
+
+   if (table->num_columns == table->columns_size) {
+      table->columns_size = table->columns_size ? table->columns_size * 2 : 64;
+      if ((p = realloc(table->columns, table->columns_size * NAME_SIZE)) == NULL) {
+         fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+         return false;
+      }
+      table->columns = p;
+   }
+   snprintf(table->columns[table->num_columns++], NAME_SIZE, "%s", name);
+   return true;
+}
+
+// get table of global message, create it if it does not exist. columns of an existing table are read from database
+static _table *get_table (FIT_UINT16 mesg_num) {
+   int8_t sql[NAME_SIZE*2+128];
+   sqlite3_stmt *stmt;
+   _table *table;
+   char *title;
+
+   if (tables[mesg_num] != NULL)
+      return tables[mesg_num];
+
+   if ((table = calloc(1, sizeof(_table))) == NULL) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      return NULL;
+   }
+   title = get_mesg_title(mesg_num);
+   if ((title == NULL) || (strcmp(title, "unknown") == 0))
+      snprintf(table->name, NAME_SIZE, "MESG_%d", mesg_num);
+   else
+      snprintf(table->name, NAME_SIZE, "%s", title);
+   tables[mesg_num] = table;
+
+   snprintf(sql, sizeof(sql), "CREATE TABLE IF NOT EXISTS \"%s\" (FILE_ID INTEGER, REC_OFFSET INTEGER)", table->name);
+   if (!exec_sql(sql))
+      return NULL;
+
+   snprintf(sql, sizeof(sql), "PRAGMA table_info(\"%s\")", table->name);
+   if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+      fprintf(stderr, "SQL error: %s (%s)\n", sqlite3_errmsg(db), sql);
+      return NULL;
+   }
+   while (sqlite3_step(stmt) == SQLITE_ROW) {
+      if (!add_table_column(table, (const int8_t *)sqlite3_column_text(stmt, 1))) {
+         sqlite3_finalize(stmt);
+         return NULL;
+      }
+   }
+   sqlite3_finalize(stmt);
+
+   return table;
+}
+
+// add column to table, if it does not have it. return false on error
+static bool add_column (_table *table, const int8_t *name, const int8_t *sql_type) {
+   int8_t sql[NAME_SIZE*2+128];
+
+   if (has_column(table, name))
+      return true;
+
+   snprintf(sql, sizeof(sql), "ALTER TABLE \"%s\" ADD COLUMN \"%s\" %s", table->name, name, sql_type);
+   return exec_sql(sql) && add_table_column(table, name);
+}
+
+/****************************************************/
+/* insert statements of local message types         */
+/* each definition record gets a prepared INSERT    */
+/* statement, it is kept as long as the definition  */
+/* does not change (also in the next files).        */
+/****************************************************/
+
+// bound field of data record
+typedef struct {
+   uint16_t offset;                          // offset of field value in data record content
+   uint8_t size;
+   const _sql_type *type;
+} _bind;
+
+typedef struct {
+   sqlite3_stmt *stmt;
+   sqlite3_stmt *ct_stmt;                    // stmt with timestamp column, for compressed timestamp records of
+                                             // definition without timestamp field. prepared on first such record
+   uint8_t def[UINT16_MAX];                  // definition record content the statement was prepared for
+   uint32_t def_len;
+   _bind binds[2*(UINT8_MAX+1)];             // fields and developer fields
+   int32_t num_binds;
+   int32_t ts_bind;                          // bind of timestamp field, -1 if definition has none
+   int8_t ts_column[NAME_SIZE];              // timestamp column name
+} _insert;
+
+static _insert inserts[FIT_HDR_TYPE_MASK+1];
+static _fit_dev_table dev_table;             // developer fields described in current file
+
+// prepare INSERT statements again on next definitions, developer fields types may have changed
+static void reset_inserts () {
+   int32_t i;
+
+   for (i = 0; i <= FIT_HDR_TYPE_MASK; i++)
+      inserts[i].def_len = 0;
+}
+
+// column name of field: its title, or its number if it has no title or the title is used by another field of the record
+static void field_column (FIT_UINT16 mesg_num, FIT_UINT8 field_num, const int8_t *used, int8_t *name) {
+   char *title = get_field_title(mesg_num, field_num);
+
+   if ((title == NULL) || (strcmp(title, "unknown") == 0) || (strlen(title) >= NAME_SIZE))
+      snprintf(name, NAME_SIZE, "FIELD_%d", field_num);
+   else
+      snprintf(name, NAME_SIZE, "%s", title);
+
+   // used holds ",name," of record columns
+   if (strstr(used, name) != NULL)
+      snprintf(name, NAME_SIZE, "FIELD_%d", field_num);
+}
+
+// prepare INSERT statement of definition record. return false on error
+static bool set_insert (const _fit_reader_def *def) {
+   const _fit_scan_type *type = def->type;
+   _insert *ins = &inserts[def->mesg_type];
+   int8_t sql[SQL_SIZE];
+   int8_t used[SQL_SIZE];                    // ",column,column,...," of the statement, to skip duplicated fields
+   int8_t name[NAME_SIZE];
+   int8_t quoted[NAME_SIZE+3];
+   const _sql_type *t;
+   const _fit_dev_field *f;
+   _table *table;
+   uint16_t offset = 0;
+   int32_t len, values;
+   int32_t i;
+
+   // same definition as the previous one of this local message type
+   if ((ins->def_len > 0) && (ins->def_len == def->len) && (memcmp(ins->def, def->rec, ins->def_len) == 0))
+      return true;
+
+   sqlite3_finalize(ins->stmt);
+   sqlite3_finalize(ins->ct_stmt);
+   ins->stmt = NULL;
+   ins->ct_stmt = NULL;
+   ins->num_binds = 0;
+   ins->ts_bind = -1;
+   ins->def_len = def->len;
+   memcpy(ins->def, def->rec, ins->def_len);
+
+   if ((table = get_table(type->global_mesg_num)) == NULL)
+      return false;
+
+   len = snprintf(sql, sizeof(sql), "INSERT INTO \"%s\" (FILE_ID,REC_OFFSET", table->name);
+   values = 2;
+   strcpy(used, ",");
+
+   for (i = 0; i < type->num_fields + type->num_dev_fields; i++) {
+      if (i < type->num_fields) {
+         t = get_sql_type(type->fields[i].base_type, type->fields[i].size);
+         field_column(type->global_mesg_num, type->fields[i].field_def_num, used, name);
+         ins->binds[ins->num_binds].size = type->fields[i].size;
+      }
+      else {
+         // described developer fields are loaded like fields of their base type, others as bytes
+         f = fit_dev_lookup(&dev_table, type->dev_fields[i - type->num_fields].dev_index, type->dev_fields[i - type->num_fields].def_num);
+         t = (f != NULL) ? get_sql_type(f->base_type, type->dev_fields[i - type->num_fields].size) : &bytes_type;
+         snprintf(name, NAME_SIZE, "DEV_%d_%d", type->dev_fields[i - type->num_fields].dev_index, type->dev_fields[i - type->num_fields].def_num);
+         ins->binds[ins->num_binds].size = type->dev_fields[i - type->num_fields].size;
+      }
+      ins->binds[ins->num_binds].offset = offset;
+      offset += ins->binds[ins->num_binds].size;
+
+      // a field that shows up twice in definition is loaded once
+      snprintf(quoted, sizeof(quoted), ",%s,", name);
+      if ((ins->binds[ins->num_binds].size == 0) || (strstr(used, quoted) != NULL))
+         continue;
+      strcat(used, name);
+      strcat(used, ",");
+
+      if (!add_column(table, name, t->sql_type))
+         return false;
+      if ((i < type->num_fields) && (type->fields[i].field_def_num == TIMESTAMP_FIELD))
+         ins->ts_bind = ins->num_binds;
+      ins->binds[ins->num_binds++].type = t;
+      len += snprintf(sql + len, sizeof(sql) - len, ",\"%s\"", name);
+      values++;
+   }
+
+   // column of compressed timestamp header time, if definition has no timestamp field
+   if (ins->ts_bind < 0)
+      field_column(type->global_mesg_num, TIMESTAMP_FIELD, used, ins->ts_column);
+
+   len += snprintf(sql + len, sizeof(sql) - len, ") VALUES (?");
+   for (i = 1; i < values; i++)
+      len += snprintf(sql + len, sizeof(sql) - len, ",?");
+   snprintf(sql + len, sizeof(sql) - len, ")");
+
+   if (sqlite3_prepare_v2(db, sql, -1, &ins->stmt, NULL) != SQLITE_OK) {
+      fprintf(stderr, "SQL error: %s (%s)\n", sqlite3_errmsg(db), sql);
+      ins->stmt = NULL;
+      ins->def_len = 0;
+      return false;
+   }
+   return true;
+}
+
+// prepare INSERT statement of compressed timestamp records of definition without timestamp field: the definition
+// statement with timestamp column added. return false on error
+static bool set_ct_insert (_insert *ins, FIT_UINT16 mesg_num) {
+   const int8_t *sql = sqlite3_sql(ins->stmt);
+   const int8_t *values = strstr(sql, ") VALUES (");
+   int8_t ct_sql[SQL_SIZE+NAME_SIZE+8];
+   _table *table;
+
+   if (((table = get_table(mesg_num)) == NULL) || !add_column(table, ins->ts_column, get_sql_type(FIT_FIT_BASE_TYPE_UINT32, sizeof(FIT_UINT32))->sql_type))
+      return false;
+
+   // "INSERT INTO t (...,ts_column) VALUES (?,...,?)"
+   snprintf(ct_sql, sizeof(ct_sql), "%.*s,\"%s\"%.*s,?)", (int32_t)(values - sql), sql, ins->ts_column, (int32_t)strlen(values) - 1, values);
+   if (sqlite3_prepare_v2(db, ct_sql, -1, &ins->ct_stmt, NULL) != SQLITE_OK) {
+      fprintf(stderr, "SQL error: %s (%s)\n", sqlite3_errmsg(db), ct_sql);
+      ins->ct_stmt = NULL;
+      return false;
+   }
+   return true;
+}
+
+// read one element as signed or unsigned 64 bits value
+static uint64_t elem_bits (const uint8_t *v, uint8_t t_size) {
+   uint64_t bits = 0;
+
+   memcpy(&bits, v, t_size);
+   return bits;
+}
+
+static int64_t elem_signed (const uint8_t *v, uint8_t t_size) {
+   switch (t_size) {
+      case 1: return *(const int8_t *)v;
+      case 2: { int16_t x; memcpy(&x, v, sizeof(x)); return x; }
+      case 4: { int32_t x; memcpy(&x, v, sizeof(x)); return x; }
+      default: { int64_t x; memcpy(&x, v, sizeof(x)); return x; }
+   }
+}
+
+static double elem_float (const uint8_t *v, uint8_t t_size) {
+   float f;
+   double d;
+
+   if (t_size == sizeof(float)) {
+      memcpy(&f, v, sizeof(f));
+      return f;
+   }
+   memcpy(&d, v, sizeof(d));
+   return d;
+}
+
+// bind one number element. invalid values and NaN are NULL
+static int32_t bind_elem (sqlite3_stmt *stmt, int32_t col, const _sql_type *t, const uint8_t *v) {
+   uint64_t bits = elem_bits(v, t->t_size);
+   double d;
+
+   if (bits == t->invalid)
+      return sqlite3_bind_null(stmt, col);
+
+   switch (t->kind) {
+      case KIND_SIGNED:
+         return sqlite3_bind_int64(stmt, col, elem_signed(v, t->t_size));
+      case KIND_UNSIGNED:
+         // SQLite integers are signed 64 bits
+         if (bits > INT64_MAX)
+            return sqlite3_bind_double(stmt, col, (double)bits);
+         return sqlite3_bind_int64(stmt, col, (int64_t)bits);
+      default:
+         d = elem_float(v, t->t_size);
+         return isnan(d) ? sqlite3_bind_null(stmt, col) : sqlite3_bind_double(stmt, col, d);
+   }
+}
+
+// bind array of numbers as text "1|2|3", like fit2csv writes arrays. invalid elements are empty, NULL if all are
+static int32_t bind_array (sqlite3_stmt *stmt, int32_t col, const _sql_type *t, const uint8_t *v, uint8_t size) {
+   int8_t text[(UINT8_MAX+1) * FLOAT_STR_SIZE];
+   int8_t *s = text;
+   bool valid = false;
+   double d;
+
+   for (; size >= t->t_size; size -= t->t_size, v += t->t_size) {
+      if (s != text)
+         *s++ = '|';
+      if (elem_bits(v, t->t_size) == t->invalid)
+         continue;
+      if (t->kind == KIND_SIGNED)
+         s += format_int(elem_signed(v, t->t_size), 1, s);
+      else if (t->kind == KIND_UNSIGNED)
+         s += format_uint(elem_bits(v, t->t_size), 1, s);
+      else {
+         d = elem_float(v, t->t_size);
+         if (isnan(d))
+            continue;
+         s += (t->t_size == sizeof(float)) ? format_float32((float)d, s) : format_float64(d, s);
+      }
+      valid = true;
+   }
+
+   if (!valid)
+      return sqlite3_bind_null(stmt, col);
+   return sqlite3_bind_text(stmt, col, text, s - text, SQLITE_TRANSIENT);
+}
+
+// bind values of data record and insert it. time of compressed timestamp header is the timestamp value. return false on error
+static bool insert_record (const _fit_reader_mesg *mesg, sqlite3_int64 file_id) {
+   _insert *ins = &inserts[mesg->mesg_type];
+   sqlite3_stmt *stmt = ins->stmt;
+   const _sql_type *ts_type = get_sql_type(FIT_FIT_BASE_TYPE_UINT32, sizeof(FIT_UINT32));
+   const _bind *b;
+   const uint8_t *v;
+   int32_t r = SQLITE_OK;
+   int32_t i;
+
+   if (mesg->compressed_ts && (ins->ts_bind < 0)) {
+      if ((ins->ct_stmt == NULL) && !set_ct_insert(ins, mesg->type->global_mesg_num))
+         return false;
+      stmt = ins->ct_stmt;
+      r = bind_elem(stmt, ins->num_binds+3, ts_type, (const uint8_t *)&mesg->timestamp);
+   }
+
+   sqlite3_bind_int64(stmt, 1, file_id);
+   sqlite3_bind_int64(stmt, 2, mesg->offset);
+
+   for (i = 0; (i < ins->num_binds) && (r == SQLITE_OK); i++) {
+      b = &ins->binds[i];
+      v = mesg->data + b->offset;
+      if (mesg->compressed_ts && (i == ins->ts_bind)) {
+         r = bind_elem(stmt, i+3, ts_type, (const uint8_t *)&mesg->timestamp);
+         continue;
+      }
+      switch (b->type->kind) {
+         case KIND_STRING:
+            r = (v[0] == 0) ? sqlite3_bind_null(stmt, i+3) : sqlite3_bind_text(stmt, i+3, v, strnlen(v, b->size), SQLITE_STATIC);
+            break;
+         case KIND_BYTES:
+            // all bytes invalid
+            r = ((v[0] == FIT_BYTE_INVALID) && (memcmp(v, v+1, b->size-1) == 0)) ? sqlite3_bind_null(stmt, i+3) : sqlite3_bind_blob(stmt, i+3, v, b->size, SQLITE_STATIC);
+            break;
+         default:
+            r = (b->size == b->type->t_size) ? bind_elem(stmt, i+3, b->type, v) : bind_array(stmt, i+3, b->type, v, b->size);
+      }
+   }
+
+   if ((r != SQLITE_OK) || (sqlite3_step(stmt) != SQLITE_DONE)) {
+      fprintf(stderr, "Failed to insert record at offset %u: %s\n", mesg->offset, sqlite3_errmsg(db));
+      sqlite3_reset(stmt);
+      return false;
+   }
+   sqlite3_reset(stmt);
+   return true;
+}
+
+/****************************************************/
+/* load files                                       */
+/****************************************************/
+
+static _fit_file file;                             // whole FIT file, mapped or read to memory
+static int32_t batch_size = DEFAULT_BATCH_SIZE;
+static int32_t batch_rows;                         // rows inserted in current transaction
+
+// insert row in current transaction, commit it when it holds batch_size rows. return false on error
+static bool count_row () {
+   if (++batch_rows < batch_size)
+      return true;
+   batch_rows = 0;
+   return exec_sql("COMMIT") && exec_sql("BEGIN");
+}
+
+// state of file being loaded, passed to reader callbacks
+typedef struct {
+   sqlite3_int64 file_id;
+   uint32_t records;
+} _load;
+
+static int32_t load_def (void *ctx, const _fit_reader_def *def) {
+   return set_insert(def) ? 0 : -1;
+}
+
+static int32_t load_mesg (void *ctx, const _fit_reader_mesg *mesg) {
+   _load *load = ctx;
+
+   if (!insert_record(mesg, load->file_id) || !count_row())
+      return -1;
+   load->records++;
+
+   if ((mesg->type->global_mesg_num == FIT_MESG_NUM_FIELD_DESCRIPTION) || (mesg->type->global_mesg_num == FIT_MESG_NUM_DEVELOPER_DATA_ID)) {
+      if (fit_dev_add_mesg(&dev_table, mesg->type->global_mesg_num, mesg->type->fields, mesg->type->num_fields, mesg->data) != 0) {
+         fprintf(stderr, "Failed to allocate memory for developer fields, %s\n", strerror(errno));
+         return -1;
+      }
+      reset_inserts();
+   }
+   return 0;
+}
+
+// load one FIT file. file is checked before its records are inserted. return false on error
+static bool load_file (const int8_t *name, sqlite3_stmt *file_stmt, uint32_t *records) {
+   _fit_scan scan;
+   _fit_scan_rec rec;
+   _fit_reader reader;
+   _load load;
+   bool ok;
+
+   *records = 0;
+   if (!fit_file_open(&file, name))
+      return false;
+
+   // check header CRC, records framing and file CRC before anything is inserted
+   fit_scan_open(&scan, file.data, file.size);
+   fit_scan_check_hdr_crc(&scan);
+   while (fit_scan_next(&scan, &rec) > 0)
+      ;
+   fit_scan_check_crc(&scan);
+   if (scan.error != FIT_SCAN_OK) {
+      fprintf(stderr, "Invalid FIT file: %s, %s (offset %u)\n", name, fit_scan_error_str(scan.error), scan.err_offset);
+      fit_file_close(&file);
+      return false;
+   }
+
+   sqlite3_bind_text(file_stmt, 1, name, -1, SQLITE_STATIC);
+   if (sqlite3_step(file_stmt) != SQLITE_DONE) {
+      fprintf(stderr, "Failed to insert file %s: %s\n", name, sqlite3_errmsg(db));
+      sqlite3_reset(file_stmt);
+      fit_file_close(&file);
+      return false;
+   }
+   sqlite3_reset(file_stmt);
+   load.file_id = sqlite3_last_insert_rowid(db);
+   load.records = 0;
+
+   // developer fields are described in each file
+   fit_dev_free(&dev_table);
+   reset_inserts();
+
+   fit_reader_init(&reader, load_def, load_mesg, &load);
+   ok = (fit_reader_read(&reader, file.data, file.size) == 0);
+   *records = load.records;
+
+   fit_file_close(&file);
+   return ok;
+}
+
+static void print_usage () {
+   fprintf(stderr, "USAGE: fit2sqlite [--batch=N] [--pragma=NAME=VALUE ...] <DB_file_name> <FIT_file_name> [<FIT_file_name> ...]\n");
+   fprintf(stderr, "       --batch=N             insert N rows in each transaction (default %d)\n", DEFAULT_BATCH_SIZE);
+   fprintf(stderr, "       --pragma=NAME=VALUE   execute \"PRAGMA NAME=VALUE\" after the bulk loading pragmas\n");
+}
+
+int32_t main (int32_t argc, int8_t *argv[]) {
+   const int8_t *pragmas[MAX_PRAGMAS];
+   int32_t num_pragmas = 0;
+   int8_t sql[256];
+   sqlite3_stmt *file_stmt = NULL;
+   uint32_t records;
+   uint64_t v;
+   int32_t failed = 0;
+   int32_t argi;
+   int32_t i;
+
+   // print general license note
+   printf("\
+******************************************************************************\n\
+   fit2sqlite (V2.0) Copyright (C) 2024  Yoram Finder\n\
+   This program comes with ABSOLUTELY NO WARRANTY;\n\
+   This is free software, and you are welcome to redistribute it under the\n\
+   GNU License (https://www.gnu.org/licenses/) conditions;\n\
+******************************************************************************\n");
+
+   // read options
+   for (argi = 1; (argi < argc) && (strncmp(argv[argi], "--", 2) == 0); argi++) {
+      if (strncmp(argv[argi], "--batch=", 8) == 0) {
+         if ((parse_uint(argv[argi]+8, strlen(argv[argi]+8), INT32_MAX, &v) < 0) || (v == 0)) {
+            fprintf(stderr, "Invalid batch size: %s\n", argv[argi]+8);
+            return 1;
+         }
+         batch_size = v;
+      }
+      else if (strncmp(argv[argi], "--pragma=", 9) == 0) {
+         if (num_pragmas == MAX_PRAGMAS) {
+            fprintf(stderr, "Too many pragmas, at most %d pragmas can be set\n", MAX_PRAGMAS);
+            return 1;
+         }
+         pragmas[num_pragmas++] = argv[argi]+9;
+      }
+      else {
+         fprintf(stderr, "Unknown option: %s\n", argv[argi]);
+         return 1;
+      }
+   }
+
+   if (argc - argi < 2) {
+      fprintf(stderr, "Missing arguments\n");
+      print_usage();
+      return 1;
+   }
+
+   if (sqlite3_open(argv[argi], &db) != SQLITE_OK) {
+      fprintf(stderr, "Failed to open database: %s, %s\n", argv[argi], sqlite3_errmsg(db));
+      goto done_with_error;
+   }
+
+   for (i = 0; i < sizeof(bulk_pragmas)/sizeof(bulk_pragmas[0]) + num_pragmas; i++) {
+      snprintf(sql, sizeof(sql), "PRAGMA %s", (i < sizeof(bulk_pragmas)/sizeof(bulk_pragmas[0])) ? bulk_pragmas[i] : pragmas[i - sizeof(bulk_pragmas)/sizeof(bulk_pragmas[0])]);
+      if (!exec_sql(sql))
+         goto done_with_error;
+   }
+
+   if (!exec_sql("CREATE TABLE IF NOT EXISTS FILES (FILE_ID INTEGER PRIMARY KEY, NAME TEXT)") ||
+       (sqlite3_prepare_v2(db, "INSERT INTO FILES (NAME) VALUES (?)", -1, &file_stmt, NULL) != SQLITE_OK) ||
+       !exec_sql("BEGIN"))
+      goto done_with_error;
+
+   // a file that failed is skipped, its rows that were inserted before the failure are kept
+   for (i = argi+1; i < argc; i++) {
+      if (load_file(argv[i], file_stmt, &records))
+         printf("%s: %u records\n", argv[i], records);
+      else
+         failed++;
+   }
+
+   if (!exec_sql("COMMIT"))
+      goto done_with_error;
+
+   for (i = 0; i <= FIT_HDR_TYPE_MASK; i++) {
+      sqlite3_finalize(inserts[i].stmt);
+      sqlite3_finalize(inserts[i].ct_stmt);
+   }
+   sqlite3_finalize(file_stmt);
+   fit_dev_free(&dev_table);
+   if (sqlite3_close(db) != SQLITE_OK) {
+      fprintf(stderr, "Failed to close database, %s\n", sqlite3_errmsg(db));
+      return 1;
+   }
+
+   if (failed) {
+      fprintf(stderr, "%d of %d files were not loaded\n", failed, argc - argi - 1);
+      return 1;
+   }
+   printf("Loading FIT files to SQLite database completed successfully\n");
+   return 0;
+
+   //done with error
+done_with_error:
+   for (i = 0; i <= FIT_HDR_TYPE_MASK; i++) {
+      sqlite3_finalize(inserts[i].stmt);
+      sqlite3_finalize(inserts[i].ct_stmt);
+   }
+   sqlite3_finalize(file_stmt);
+   sqlite3_close(db);
+   return 1;
+}
@@ -0,0 +1,28 @@
+#ifndef FIT_CONVERT_
+#define FIT_CONVERT_
+
+#include <stdint.h>
+
+int32_t parse_uint (const int8_t *s, int32_t len, uint64_t max, uint64_t *val);
+int32_t parse_int (const int8_t *s, int32_t len, int64_t min, uint64_t max, int64_t *val);
+
+#define INT_STR_SIZE    23       // longest zero padded int64 / uint64 text (21 digits), sign and 0 terminator
+
+int32_t format_uint (uint64_t v, int32_t min_digits, int8_t *s);
+int32_t format_int (int64_t v, int32_t min_digits, int8_t *s);
+
+#define FLOAT_STR_SIZE  32       // longest float32 / float64 text and 0 terminator
+
+int32_t format_float32 (float v, int8_t *s);
+int32_t format_float64 (double v, int8_t *s);
+int32_t parse_float32 (const int8_t *s, int32_t len, float *val);
+int32_t parse_float64 (const int8_t *s, int32_t len, double *val);
+
+int32_t format_hex (const uint8_t *v, int32_t size, int8_t *s);
+int32_t parse_hex (const int8_t *s, int32_t len, uint8_t *v, int32_t size);
+int32_t format_base64 (const uint8_t *v, int32_t size, int8_t *s);
+int32_t parse_base64 (const int8_t *s, int32_t len, uint8_t *v, int32_t size);
+
+int32_t parse_fit_time (const int8_t *s, int32_t len, uint32_t *t);
+
+#endif // FIT_CONVERT_
@@ -0,0 +1,74 @@
+/*
+
+	CPU features detection, to select the kernels variant at run time.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fit_cpu.h>
+
+static const char *level_names[FIT_CPU_LEVELS] = {"generic", "sse4.2", "avx2", "avx512"};
+
+int32_t fit_cpu_selected = -1;
+
+// highest level this CPU runs
+static _fit_cpu_level detect_level () {
+#ifdef FIT_CPU_X86
+   __builtin_cpu_init();
+   if (!__builtin_cpu_supports("sse4.2") || !__builtin_cpu_supports("pclmul"))
+      return FIT_CPU_GENERIC;
+   if (!__builtin_cpu_supports("avx2") || !__builtin_cpu_supports("bmi2"))
+      return FIT_CPU_SSE42;
+   if (!__builtin_cpu_supports("avx512f") || !__builtin_cpu_supports("avx512bw") || !__builtin_cpu_supports("vpclmulqdq"))
+      return FIT_CPU_AVX2;
+   return FIT_CPU_AVX512;
+#else
+   return FIT_CPU_GENERIC;
+#endif
+}
+
+// select level of kernels variant: the highest level of the CPU, or the level set by FIT_CPU environment
+// variable (for testing and benchmarks). a forced level above the CPU level is lowered to it
+_fit_cpu_level fit_cpu_select () {
+   const char *env;
+   int32_t level;
+   int32_t cpu;
+
+   level = cpu = detect_level();
+   if (((env = getenv(FIT_CPU_ENV)) != NULL) && (*env != 0)) {
+      for (level = 0; (level < FIT_CPU_LEVELS) && (strcmp(env, level_names[level]) != 0); level++)
+         ;
+      if (level == FIT_CPU_LEVELS) {
+         fprintf(stderr, "Unknown %s=%s (generic, sse4.2, avx2 or avx512), using %s\n", FIT_CPU_ENV, env, level_names[cpu]);
+         level = cpu;
+      }
+      else if (level > cpu) {
+         fprintf(stderr, "CPU does not support %s=%s, using %s\n", FIT_CPU_ENV, env, level_names[cpu]);
+         level = cpu;
+      }
+   }
+
+   // threads that race here select the same level
+   __atomic_store_n(&fit_cpu_selected, level, __ATOMIC_RELAXED);
+   return level;
+}
+
+const char *fit_cpu_name (_fit_cpu_level level) {
+   return (level < FIT_CPU_LEVELS) ? level_names[level] : "unknown";
+}
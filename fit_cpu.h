@@ -0,0 +1,33 @@
+#ifndef FIT_CPU_
+#define FIT_CPU_
+
+#include <stdint.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define FIT_CPU_X86                             // kernels have x86-64 vector variants
+#endif
+
+#define FIT_CPU_ENV              "FIT_CPU"      // environment variable that forces kernels variant (generic, sse4.2, avx2, avx512)
+
+// kernels variants, each level includes the ones below it
+typedef enum {
+   FIT_CPU_GENERIC = 0,                         // portable C
+   FIT_CPU_SSE42,                               // SSE4.2 and PCLMULQDQ
+   FIT_CPU_AVX2,                                // AVX2 and BMI2
+   FIT_CPU_AVX512,                              // AVX-512 F/BW and VPCLMULQDQ
+   FIT_CPU_LEVELS
+} _fit_cpu_level;
+
+extern int32_t fit_cpu_selected;                // selected level, -1 until it is selected
+
+_fit_cpu_level fit_cpu_select (void);
+const char *fit_cpu_name (_fit_cpu_level level);
+
+// level of kernels variant. it is read by kernels on each call, so it is inline
+static inline _fit_cpu_level fit_cpu_level (void) {
+   int32_t level = __atomic_load_n(&fit_cpu_selected, __ATOMIC_RELAXED);
+
+   return (level >= 0) ? (_fit_cpu_level)level : fit_cpu_select();
+}
+
+#endif // FIT_CPU_
@@ -0,0 +1,8 @@
+#ifndef FIT_CRC16_
+#define FIT_CRC16_
+
+FIT_UINT16 fit_crc16_shift (FIT_UINT16 crc, uint64_t len);
+FIT_UINT16 fit_crc16_combine (FIT_UINT16 crc1, FIT_UINT16 crc2, uint64_t len2);
+FIT_UINT16 fit_crc16_update (FIT_UINT16 crc, const void *data, uint64_t len);
+
+#endif // FIT_CRC16_
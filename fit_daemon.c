@@ -0,0 +1,676 @@
+/*
+
+   This code uses GARMIN FIT SDK V21.141.00 (https://developer.garmin.com/downloads/fit/sdk/FitSDKRelease_21.141.00.zip)
+   Under the Flexible and Interoperable Data Transfer (FIT) Protocol License:
+   (https://www.thisisant.com/developer/ant/licensing/flexible-and-interoperable-data-transfer-fit-protocol-license).
+
+	Conversion daemon: spool directory, Unix domain socket jobs and a pool of worker processes.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdarg.h>
+
+#include <fit_daemon.h>
+
+#ifndef _WIN32
+#include <strings.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define LINE_SIZE             (2 * FIT_DAEMON_NAME_SIZE + 16)   // "CONVERT\t<in>\t<out>\n"
+#define SPOOL_EXT             ".fit"
+#define SPOOL_OUT             "out"          // spool directory sub directories
+#define SPOOL_DONE            "done"
+#define SPOOL_FAILED          "failed"
+
+// job request sent to worker process
+typedef struct {
+   char in_name[FIT_DAEMON_NAME_SIZE];
+   char out_name[FIT_DAEMON_NAME_SIZE];
+} _job_req;
+
+// job result sent back by worker process
+typedef struct {
+   int32_t status;
+   uint64_t bytes;                           // input file size
+} _job_res;
+
+typedef struct {
+   _job_req req;
+   uint32_t client_id;                       // connection waiting for job result, 0 for spool job
+   double start;                             // time worker got the job
+} _job;
+
+typedef struct {
+   pid_t pid;
+   int fd;                                   // socket pair end of worker process, -1 if not running
+   bool busy;
+   _job job;
+} _worker;
+
+typedef struct {
+   int fd;                                   // -1 if not connected
+   uint32_t id;
+   char line[LINE_SIZE];
+   uint32_t len;
+} _client;
+
+static const _fit_daemon_cfg *cfg;
+static _worker *workers;
+static _job *queue;                          // ring of jobs waiting for a worker
+static int32_t queue_head;
+static int32_t queue_len;
+static _client clients[FIT_DAEMON_CLIENTS];
+static int listen_fd = -1;
+static uint32_t next_client_id = 1;
+static volatile sig_atomic_t stop_signal;
+static bool stopping;                        // no new jobs, daemon stops when queued and running jobs are done
+
+// counters
+static double start_time;
+static uint64_t jobs_done;
+static uint64_t jobs_failed;
+static uint64_t jobs_refused;                // queue was full
+static uint64_t bytes_done;                  // input bytes of done jobs
+static double busy_time;                     // seconds workers spent on jobs
+
+// monotonic time in seconds
+static double now () {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void on_stop_signal (int sig) {
+   (void)sig;
+   stop_signal = 1;
+}
+
+// read or write whole buffer of worker socket. return false on error or end of file
+static bool read_full (int fd, void *p, size_t len) {
+   ssize_t r;
+
+   while (len > 0) {
+      if ((r = read(fd, p, len)) <= 0) {
+         if ((r < 0) && (errno == EINTR))
+            continue;
+         return false;
+      }
+      p = (uint8_t *)p + r;
+      len -= r;
+   }
+   return true;
+}
+
+static bool write_full (int fd, const void *p, size_t len) {
+   ssize_t r;
+
+   while (len > 0) {
+      if ((r = write(fd, p, len)) < 0) {
+         if (errno == EINTR)
+            continue;
+         return false;
+      }
+      p = (const uint8_t *)p + r;
+      len -= r;
+   }
+   return true;
+}
+
+/****************************************************/
+/* worker processes                                 */
+/****************************************************/
+
+// worker process: run jobs until daemon closes its socket. tables the job uses stay warm between jobs
+static void worker_main (int fd) {
+   _job_req req;
+   _job_res res;
+   struct stat st;
+
+   // daemon decides when workers stop
+   signal(SIGINT, SIG_IGN);
+   signal(SIGTERM, SIG_IGN);
+   while (read_full(fd, &req, sizeof(req))) {
+      res.bytes = (stat(req.in_name, &st) == 0) ? st.st_size : 0;
+      res.status = cfg->job(req.in_name, req.out_name);
+      fflush(stdout);
+      fflush(stderr);
+      if (!write_full(fd, &res, sizeof(res)))
+         break;
+   }
+   _exit(0);
+}
+
+// start worker process. return 0 on success, -1 on error
+static int32_t start_worker (int32_t n) {
+   int fds[2];
+   int32_t i;
+
+   if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      fprintf(stderr, "Failed to create worker socket, %s\n", strerror(errno));
+      return -1;
+   }
+   fflush(stdout);
+   fflush(stderr);
+   if ((workers[n].pid = fork()) < 0) {
+      fprintf(stderr, "Failed to start worker process, %s\n", strerror(errno));
+      close(fds[0]);
+      close(fds[1]);
+      return -1;
+   }
+   if (workers[n].pid == 0) {
+      // worker keeps only its own socket
+      close(fds[0]);
+      if (listen_fd >= 0)
+         close(listen_fd);
+      for (i = 0; i < FIT_DAEMON_CLIENTS; i++) {
+         if (clients[i].fd >= 0)
+            close(clients[i].fd);
+      }
+      for (i = 0; i < cfg->workers; i++) {
+         if (workers[i].fd >= 0)
+            close(workers[i].fd);
+      }
+      worker_main(fds[1]);
+   }
+   close(fds[1]);
+   workers[n].fd = fds[0];
+   workers[n].busy = false;
+   return 0;
+}
+
+// stop worker process after its job
+static void stop_worker (int32_t n) {
+   if (workers[n].fd < 0)
+      return;
+   close(workers[n].fd);
+   workers[n].fd = -1;
+   waitpid(workers[n].pid, NULL, 0);
+}
+
+/****************************************************/
+/* clients                                          */
+/****************************************************/
+
+// send reply line to connection, unless it was closed. a client that does not read its replies loses them
+static void reply (uint32_t client_id, const char *fmt, ...) {
+   char line[LINE_SIZE];
+   va_list ap;
+   int32_t len;
+   int32_t i;
+
+   for (i = 0; (i < FIT_DAEMON_CLIENTS) && ((clients[i].fd < 0) || (clients[i].id != client_id)); i++)
+      ;
+   if ((client_id == 0) || (i == FIT_DAEMON_CLIENTS))
+      return;
+
+   va_start(ap, fmt);
+   len = vsnprintf(line, sizeof(line), fmt, ap);
+   va_end(ap);
+   if (len >= (int32_t)sizeof(line))
+      len = sizeof(line) - 1;
+   send(clients[i].fd, line, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+static void close_client (int32_t n) {
+   close(clients[n].fd);
+   clients[n].fd = -1;
+}
+
+/****************************************************/
+/* jobs queue                                       */
+/****************************************************/
+
+// check if input file is queued or converted now
+static bool in_flight (const char *in_name) {
+   int32_t i;
+
+   for (i = 0; i < queue_len; i++) {
+      if (strcmp(queue[(queue_head + i) % cfg->queue_size].req.in_name, in_name) == 0)
+         return true;
+   }
+   for (i = 0; i < cfg->workers; i++) {
+      if (workers[i].busy && (strcmp(workers[i].job.req.in_name, in_name) == 0))
+         return true;
+   }
+   return false;
+}
+
+// queue job. callers reject names longer than FIT_DAEMON_NAME_SIZE-1, copies are bounded still
+// return false if queue is full
+static bool queue_job (const char *in_name, const char *out_name, uint32_t client_id) {
+   _job *job;
+
+   if (queue_len == cfg->queue_size)
+      return false;
+   job = &queue[(queue_head + queue_len++) % cfg->queue_size];
+   snprintf(job->req.in_name, sizeof(job->req.in_name), "%s", in_name);
+   snprintf(job->req.out_name, sizeof(job->req.out_name), "%s", out_name);
+   job->client_id = client_id;
+   return true;
+}
+
+// give queued jobs to idle workers
+static void dispatch () {
+   int32_t i;
+
+   for (i = 0; (i < cfg->workers) && (queue_len > 0); i++) {
+      if ((workers[i].fd < 0) || workers[i].busy)
+         continue;
+      workers[i].job = queue[queue_head];
+      queue_head = (queue_head + 1) % cfg->queue_size;
+      queue_len--;
+      workers[i].job.start = now();
+      workers[i].busy = true;
+      if (!write_full(workers[i].fd, &workers[i].job.req, sizeof(_job_req)))
+         break;                              // worker died, its result read fails
+   }
+}
+
+/****************************************************/
+/* spool directory                                  */
+/****************************************************/
+
+// move converted spool file to done or failed sub directory
+static void move_spool_file (const char *in_name, bool ok) {
+   char name[FIT_DAEMON_NAME_SIZE];
+   const char *base = strrchr(in_name, '/') + 1;
+
+   snprintf(name, sizeof(name), "%s/%s/%s", cfg->spool_dir, ok ? SPOOL_DONE : SPOOL_FAILED, base);
+   if (rename(in_name, name) != 0)
+      fprintf(stderr, "Failed to move %s to %s, %s\n", in_name, name, strerror(errno));
+}
+
+// queue FIT files of spool directory. files that do not fit in queue wait for the next scan
+static void scan_spool () {
+   char in_name[FIT_DAEMON_NAME_SIZE];
+   char out_name[FIT_DAEMON_NAME_SIZE];
+   struct dirent *e;
+   struct stat st;
+   DIR *dir;
+   size_t len;
+
+   if ((dir = opendir(cfg->spool_dir)) == NULL)
+      return;
+   while ((queue_len < cfg->queue_size) && ((e = readdir(dir)) != NULL)) {
+      len = strlen(e->d_name);
+      if ((len <= strlen(SPOOL_EXT)) || (strcasecmp(e->d_name + len - strlen(SPOOL_EXT), SPOOL_EXT) != 0))
+         continue;
+      if ((snprintf(in_name, sizeof(in_name), "%s/%s", cfg->spool_dir, e->d_name) >= (int)sizeof(in_name)) ||
+          (snprintf(out_name, sizeof(out_name), "%s/%s/%.*s%s", cfg->spool_dir, SPOOL_OUT, (int)(len - strlen(SPOOL_EXT)), e->d_name, cfg->out_ext) >= (int)sizeof(out_name)))
+         continue;
+      if ((stat(in_name, &st) != 0) || !S_ISREG(st.st_mode) || in_flight(in_name))
+         continue;
+      queue_job(in_name, out_name, 0);
+   }
+   closedir(dir);
+}
+
+/****************************************************/
+/* job results                                      */
+/****************************************************/
+
+// worker finished job, or died (res is NULL)
+static void job_done (int32_t n, const _job_res *res) {
+   _job *job = &workers[n].job;
+   double t = now() - job->start;
+   bool ok = (res != NULL) && (res->status == 0);
+
+   workers[n].busy = false;
+   busy_time += t;
+   if (ok) {
+      jobs_done++;
+      bytes_done += res->bytes;
+   }
+   else
+      jobs_failed++;
+
+   printf("%s: %s (%.3f seconds)\n", job->req.in_name, ok ? "done" : "failed", t);
+   fflush(stdout);
+   if (job->client_id == 0) {
+      // spool output of failed job is not left half written
+      if (!ok)
+         remove(job->req.out_name);
+      move_spool_file(job->req.in_name, ok);
+   }
+   else
+      reply(job->client_id, "%s\t%s\n", ok ? "OK" : "FAILED", job->req.in_name);
+}
+
+// read result of worker. a worker that died is started again
+static void read_result (int32_t n) {
+   _job_res res;
+
+   if (read_full(workers[n].fd, &res, sizeof(res))) {
+      if (workers[n].busy)
+         job_done(n, &res);
+      return;
+   }
+
+   fprintf(stderr, "Worker process %d stopped\n", (int)workers[n].pid);
+   if (workers[n].busy)
+      job_done(n, NULL);
+   stop_worker(n);
+   if (!stopping)
+      start_worker(n);
+}
+
+/****************************************************/
+/* socket commands                                  */
+/****************************************************/
+
+static void print_stats (uint32_t client_id) {
+   double uptime = now() - start_time;
+   int32_t busy = 0;
+   int32_t conns = 0;
+   int32_t i;
+
+   for (i = 0; i < cfg->workers; i++)
+      busy += workers[i].busy;
+   for (i = 0; i < FIT_DAEMON_CLIENTS; i++)
+      conns += (clients[i].fd >= 0);
+
+   reply(client_id, "{\"workers\":%d,\"busy\":%d,\"queued\":%d,\"queue_size\":%d,\"clients\":%d,\"done\":%llu,\"failed\":%llu,"
+                    "\"refused\":%llu,\"bytes\":%llu,\"uptime\":%.3f,\"busy_time\":%.3f,\"jobs_per_sec\":%.3f,\"bytes_per_sec\":%.0f}\n",
+         cfg->workers, busy, queue_len, cfg->queue_size, conns, (unsigned long long)jobs_done, (unsigned long long)jobs_failed,
+         (unsigned long long)jobs_refused, (unsigned long long)bytes_done, uptime, busy_time,
+         (jobs_done + jobs_failed) / uptime, bytes_done / uptime);
+}
+
+// run command line of connection: "CONVERT\t<in>\t<out>", "STATS" or "SHUTDOWN"
+static void run_command (int32_t n, char *line) {
+   uint32_t id = clients[n].id;
+   char *in_name;
+   char *out_name;
+
+   if (strncmp(line, "CONVERT\t", 8) == 0) {
+      in_name = line + 8;
+      if (((out_name = strchr(in_name, '\t')) == NULL) || (out_name == in_name) || (out_name[1] == '\0')) {
+         reply(id, "ERROR\tCONVERT needs input and output file names\n");
+         return;
+      }
+      *out_name++ = '\0';
+      // a line may be longer than a job file name
+      if ((strlen(in_name) >= FIT_DAEMON_NAME_SIZE) || (strlen(out_name) >= FIT_DAEMON_NAME_SIZE))
+         reply(id, "ERROR\tfile name is too long\n");
+      else if (stopping)
+         reply(id, "ERROR\tdaemon is stopping\n");
+      else if (!queue_job(in_name, out_name, id)) {
+         jobs_refused++;
+         reply(id, "BUSY\t%s\n", in_name);
+      }
+   }
+   else if (strcmp(line, "STATS") == 0)
+      print_stats(id);
+   else if (strcmp(line, "SHUTDOWN") == 0) {
+      stopping = true;
+      reply(id, "OK\tSHUTDOWN\n");
+   }
+   else
+      reply(id, "ERROR\tunknown command\n");
+}
+
+// read connection data and run its complete lines
+static void read_client (int32_t n) {
+   _client *c = &clients[n];
+   ssize_t r;
+   char *eol;
+   char *line;
+
+   if ((r = recv(c->fd, c->line + c->len, sizeof(c->line) - 1 - c->len, 0)) <= 0) {
+      if ((r < 0) && (errno == EINTR))
+         return;
+      close_client(n);
+      return;
+   }
+   c->len += r;
+   c->line[c->len] = '\0';
+
+   line = c->line;
+   while ((c->fd >= 0) && ((eol = strchr(line, '\n')) != NULL)) {
+      *eol = '\0';
+      if ((eol > line) && (eol[-1] == '\r'))
+         eol[-1] = '\0';
+      run_command(n, line);
+      line = eol + 1;
+   }
+   c->len -= line - c->line;
+   memmove(c->line, line, c->len);
+
+   if (c->len == sizeof(c->line) - 1) {
+      reply(c->id, "ERROR\tline too long\n");
+      close_client(n);
+   }
+}
+
+// accept connection, unless all connections are taken (listening socket is not polled then)
+static void accept_client () {
+   int fd;
+   int32_t i;
+
+   if ((fd = accept(listen_fd, NULL, NULL)) < 0)
+      return;
+   for (i = 0; (i < FIT_DAEMON_CLIENTS) && (clients[i].fd >= 0); i++)
+      ;
+   if (i == FIT_DAEMON_CLIENTS) {
+      close(fd);
+      return;
+   }
+   clients[i].fd = fd;
+   clients[i].id = next_client_id++;
+   clients[i].len = 0;
+   if (next_client_id == 0)
+      next_client_id = 1;
+}
+
+// open local socket, only the daemon user can connect. return 0 on success, -1 on error
+static int32_t open_socket () {
+   struct sockaddr_un addr;
+   int fd;
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   if (strlen(cfg->socket_name) >= sizeof(addr.sun_path)) {
+      fprintf(stderr, "Socket name is too long: %s\n", cfg->socket_name);
+      return -1;
+   }
+   strcpy(addr.sun_path, cfg->socket_name);
+
+   if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+      fprintf(stderr, "Failed to create socket, %s\n", strerror(errno));
+      return -1;
+   }
+
+   // socket left by a daemon that is not running is removed
+   if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+      fprintf(stderr, "Daemon is already running on socket: %s\n", cfg->socket_name);
+      close(fd);
+      return -1;
+   }
+   unlink(cfg->socket_name);
+
+   if ((bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) || (chmod(cfg->socket_name, S_IRUSR | S_IWUSR) != 0) ||
+       (listen(fd, FIT_DAEMON_CLIENTS) != 0)) {
+      fprintf(stderr, "Failed to open socket: %s, %s\n", cfg->socket_name, strerror(errno));
+      close(fd);
+      return -1;
+   }
+   listen_fd = fd;
+   return 0;
+}
+
+// create spool sub directory if it does not exist. return 0 on success, -1 on error
+static int32_t spool_subdir (const char *sub) {
+   char name[FIT_DAEMON_NAME_SIZE];
+
+   snprintf(name, sizeof(name), "%s/%s", cfg->spool_dir, sub);
+   if ((mkdir(name, S_IRWXU) != 0) && (errno != EEXIST)) {
+      fprintf(stderr, "Failed to create directory: %s, %s\n", name, strerror(errno));
+      return -1;
+   }
+   return 0;
+}
+
+/****************************************************/
+/* daemon                                           */
+/****************************************************/
+
+// run daemon until SHUTDOWN command, SIGINT or SIGTERM. return 0 on success, -1 on error
+int32_t fit_daemon_run (const _fit_daemon_cfg *daemon_cfg) {
+   struct pollfd *fds;
+   int32_t *fd_owner;                        // client index, or -1 - workers[0], -2 - workers[1]... or listening socket
+   int32_t nfds;
+   int32_t i;
+   int32_t busy;
+   double last_scan = 0;
+   int32_t r = -1;
+
+   cfg = daemon_cfg;
+   for (i = 0; i < FIT_DAEMON_CLIENTS; i++)
+      clients[i].fd = -1;
+   fds = malloc((1 + FIT_DAEMON_CLIENTS + cfg->workers) * sizeof(struct pollfd));
+   fd_owner = malloc((1 + FIT_DAEMON_CLIENTS + cfg->workers) * sizeof(int32_t));
+   workers = calloc(cfg->workers, sizeof(_worker));
+   queue = malloc(cfg->queue_size * sizeof(_job));
+   if ((fds == NULL) || (fd_owner == NULL) || (workers == NULL) || (queue == NULL)) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      goto done;
+   }
+   for (i = 0; i < cfg->workers; i++)
+      workers[i].fd = -1;
+
+   if ((cfg->spool_dir != NULL) &&
+       ((spool_subdir(SPOOL_OUT) != 0) || (spool_subdir(SPOOL_DONE) != 0) || (spool_subdir(SPOOL_FAILED) != 0)))
+      goto done;
+
+   signal(SIGPIPE, SIG_IGN);
+   signal(SIGINT, on_stop_signal);
+   signal(SIGTERM, on_stop_signal);
+   if (open_socket() != 0)
+      goto done;
+   for (i = 0; i < cfg->workers; i++) {
+      if (start_worker(i) != 0)
+         goto done;
+   }
+
+   start_time = now();
+   printf("Daemon is running: socket %s, %d workers, queue of %d jobs%s%s\n", cfg->socket_name, cfg->workers, cfg->queue_size,
+          (cfg->spool_dir != NULL) ? ", spool directory " : "", (cfg->spool_dir != NULL) ? cfg->spool_dir : "");
+   fflush(stdout);
+
+   while (true) {
+      if (stop_signal)
+         stopping = true;
+      for (i = 0, busy = 0; i < cfg->workers; i++)
+         busy += workers[i].busy;
+      if (stopping && (queue_len == 0) && (busy == 0))
+         break;
+
+      // listening socket is polled only when a connection can be taken
+      nfds = 0;
+      for (i = 0; (i < FIT_DAEMON_CLIENTS) && (clients[i].fd >= 0); i++)
+         ;
+      if (!stopping && (i < FIT_DAEMON_CLIENTS)) {
+         fds[nfds].fd = listen_fd;
+         fds[nfds].events = POLLIN;
+         fd_owner[nfds++] = FIT_DAEMON_CLIENTS;
+      }
+      for (i = 0; i < FIT_DAEMON_CLIENTS; i++) {
+         if (clients[i].fd >= 0) {
+            fds[nfds].fd = clients[i].fd;
+            fds[nfds].events = POLLIN;
+            fd_owner[nfds++] = i;
+         }
+      }
+      for (i = 0; i < cfg->workers; i++) {
+         if (workers[i].fd >= 0) {
+            fds[nfds].fd = workers[i].fd;
+            fds[nfds].events = POLLIN;
+            fd_owner[nfds++] = -1 - i;
+         }
+      }
+
+      if (poll(fds, nfds, FIT_DAEMON_SCAN_MS) < 0) {
+         if (errno == EINTR)
+            continue;
+         fprintf(stderr, "Failed to poll, %s\n", strerror(errno));
+         break;
+      }
+
+      for (i = 0; i < nfds; i++) {
+         if (fds[i].revents == 0)
+            continue;
+         if (fd_owner[i] < 0)
+            read_result(-1 - fd_owner[i]);
+         else if (fd_owner[i] == FIT_DAEMON_CLIENTS)
+            accept_client();
+         else if (clients[fd_owner[i]].fd == fds[i].fd)
+            read_client(fd_owner[i]);
+      }
+
+      // spool files wait in directory while queue is full
+      if ((cfg->spool_dir != NULL) && !stopping && (now() - last_scan >= FIT_DAEMON_SCAN_MS / 1000.0)) {
+         scan_spool();
+         last_scan = now();
+      }
+      dispatch();
+   }
+
+   printf("Daemon stopped: %llu jobs done, %llu failed, %llu refused\n", (unsigned long long)jobs_done,
+          (unsigned long long)jobs_failed, (unsigned long long)jobs_refused);
+   r = 0;
+
+done:
+   for (i = 0; (workers != NULL) && (i < cfg->workers); i++)
+      stop_worker(i);
+   for (i = 0; i < FIT_DAEMON_CLIENTS; i++) {
+      if (clients[i].fd >= 0)
+         close_client(i);
+   }
+   if (listen_fd >= 0) {
+      close(listen_fd);
+      unlink(cfg->socket_name);
+   }
+   free(fds);
+   free(fd_owner);
+   free(workers);
+   free(queue);
+   return r;
+}
+
+#else
+
+// daemon needs Unix domain sockets and worker processes
+int32_t fit_daemon_run (const _fit_daemon_cfg *daemon_cfg) {
+   fprintf(stderr, "Daemon mode is not supported on Windows\n");
+   return -1;
+}
+
+#endif // _WIN32
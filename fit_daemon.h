@@ -0,0 +1,24 @@
+#ifndef FIT_DAEMON_
+#define FIT_DAEMON_
+
+#include <stdint.h>
+
+#define FIT_DAEMON_NAME_SIZE     4096           // longest file name of a job
+#define FIT_DAEMON_CLIENTS       64             // socket connections served at the same time
+#define FIT_DAEMON_SCAN_MS       1000           // spool directory scan interval
+
+// job of worker process: convert in_name to out_name. return 0 on success
+typedef int32_t (*_fit_daemon_job) (const char *in_name, const char *out_name);
+
+typedef struct {
+   const char *socket_name;                     // Unix domain socket for jobs and counters
+   const char *spool_dir;                       // spool directory, NULL if not watched
+   const char *out_ext;                         // extension of output files of spool jobs (".csv")
+   int32_t workers;                             // worker processes
+   int32_t queue_size;                          // jobs waiting for a worker, more are refused
+   _fit_daemon_job job;
+} _fit_daemon_cfg;
+
+int32_t fit_daemon_run (const _fit_daemon_cfg *cfg);
+
+#endif // FIT_DAEMON_
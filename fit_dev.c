@@ -0,0 +1,129 @@
+/*
+
+   This code uses GARMIN FIT SDK V21.141.00 (https://developer.garmin.com/downloads/fit/sdk/FitSDKRelease_21.141.00.zip)
+   Under the Flexible and Interoperable Data Transfer (FIT) Protocol License:
+   (https://www.thisisant.com/developer/ant/licensing/flexible-and-interoperable-data-transfer-fit-protocol-license).
+
+	Developer fields descriptions, tracked from developer_data_id and field_description messages.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <fit_example.h>
+
+#include <fit_dev.h>
+
+void fit_dev_init (_fit_dev_table *table) {
+   memset(table, 0, sizeof(_fit_dev_table));
+}
+
+// copy string field value, up to its size and the table text size
+static void copy_text (char *dst, const uint8_t *v, FIT_UINT8 size) {
+   size_t len = strnlen((const char *)v, size);
+
+   if (len >= FIT_DEV_NAME_SIZE)
+      len = FIT_DEV_NAME_SIZE - 1;
+   memcpy(dst, v, len);
+   dst[len] = 0;
+}
+
+// add description of developer field from field_description message content
+// return 0 on success (also if message does not describe a field), -1 on allocation error
+static int32_t add_description (_fit_dev_table *table, const FIT_FIELD_DEF *fields, FIT_UINT8 num_fields, const uint8_t *data) {
+   FIT_UINT8 dev_index = FIT_UINT8_INVALID;
+   FIT_UINT8 def_num = FIT_UINT8_INVALID;
+   FIT_UINT8 base_type = FIT_UINT8_INVALID;
+   FIT_UINT8 scale = FIT_UINT8_INVALID;
+   FIT_SINT8 offset = FIT_SINT8_INVALID;
+   const uint8_t *name = NULL, *units = NULL;
+   FIT_UINT8 name_size = 0, units_size = 0;
+   _fit_dev_field *f;
+   int32_t i;
+
+   for (i = 0; i < num_fields; data += fields[i].size, i++) {
+      if (fields[i].size == 0)
+         continue;
+      switch (fields[i].field_def_num) {
+         case FIT_FIELD_DESCRIPTION_FIELD_NUM_DEVELOPER_DATA_INDEX: dev_index = data[0]; break;
+         case FIT_FIELD_DESCRIPTION_FIELD_NUM_FIELD_DEFINITION_NUMBER: def_num = data[0]; break;
+         case FIT_FIELD_DESCRIPTION_FIELD_NUM_FIT_BASE_TYPE_ID: base_type = data[0]; break;
+         case FIT_FIELD_DESCRIPTION_FIELD_NUM_SCALE: scale = data[0]; break;
+         case FIT_FIELD_DESCRIPTION_FIELD_NUM_OFFSET: offset = (FIT_SINT8)data[0]; break;
+         case FIT_FIELD_DESCRIPTION_FIELD_NUM_FIELD_NAME: name = data; name_size = fields[i].size; break;
+         case FIT_FIELD_DESCRIPTION_FIELD_NUM_UNITS: units = data; units_size = fields[i].size; break;
+      }
+   }
+
+   if ((dev_index == FIT_UINT8_INVALID) || (def_num == FIT_UINT8_INVALID) || (base_type == FIT_UINT8_INVALID))
+      return 0;
+
+   if ((table->fields[dev_index] == NULL) && ((table->fields[dev_index] = calloc(UINT8_MAX+1, sizeof(_fit_dev_field))) == NULL))
+      return -1;
+
+   f = &table->fields[dev_index][def_num];
+   memset(f, 0, sizeof(_fit_dev_field));
+   f->base_type = base_type;
+   if (name != NULL)
+      copy_text(f->name, name, name_size);
+   if (units != NULL)
+      copy_text(f->units_text, units, units_size);
+
+   // value = stored value / scale - offset, as for FIT profile fields
+   f->units.f_val = def_num;
+   f->units.units = f->units_text;
+   if ((scale != FIT_UINT8_INVALID) && (scale != 0)) {
+      f->units.scale = scale;
+      f->units.offset = (offset != FIT_SINT8_INVALID) ? offset : 0;
+   }
+
+   table->described[dev_index][def_num >> 3] |= 1 << (def_num & 7);
+   return 0;
+}
+
+// track developer fields from data record content of global message.
+// developer_data_id message starts a new set of descriptions for its developer data index
+// return 0 on success, -1 on allocation error
+int32_t fit_dev_add_mesg (_fit_dev_table *table, FIT_UINT16 global_mesg_num, const FIT_FIELD_DEF *fields, FIT_UINT8 num_fields, const uint8_t *data) {
+   int32_t i;
+
+   if (global_mesg_num == FIT_MESG_NUM_FIELD_DESCRIPTION)
+      return add_description(table, fields, num_fields, data);
+
+   if (global_mesg_num == FIT_MESG_NUM_DEVELOPER_DATA_ID) {
+      for (i = 0; i < num_fields; data += fields[i].size, i++) {
+         if ((fields[i].field_def_num == FIT_DEVELOPER_DATA_ID_FIELD_NUM_DEVELOPER_DATA_INDEX) && (fields[i].size > 0) && (data[0] != FIT_UINT8_INVALID))
+            memset(table->described[data[0]], 0, sizeof(table->described[data[0]]));
+      }
+   }
+   return 0;
+}
+
+// description of developer field, NULL if it was not described
+const _fit_dev_field *fit_dev_lookup (const _fit_dev_table *table, FIT_UINT8 dev_index, FIT_UINT8 def_num) {
+   if ((table->described[dev_index][def_num >> 3] & (1 << (def_num & 7))) == 0)
+      return NULL;
+   return &table->fields[dev_index][def_num];
+}
+
+void fit_dev_free (_fit_dev_table *table) {
+   int32_t i;
+
+   for (i = 0; i <= UINT8_MAX; i++)
+      free(table->fields[i]);
+   fit_dev_init(table);
+}
@@ -0,0 +1,31 @@
+#ifndef FIT_DEV_
+#define FIT_DEV_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <fit_titles.h>
+
+#define FIT_DEV_NAME_SIZE        64          // longest developer field name and units kept, including 0 terminator
+
+// developer field as described by field_description message
+typedef struct {
+   FIT_UINT8 base_type;
+   char name[FIT_DEV_NAME_SIZE];             // empty if description has no name
+   char units_text[FIT_DEV_NAME_SIZE];
+   _field_units units;                       // scale is 0 if description has no scale
+} _fit_dev_field;
+
+// developer fields of all developer data indexes. fields of an index are allocated
+// on its first description, so a field is looked up with two array indexes
+typedef struct {
+   _fit_dev_field *fields[UINT8_MAX+1];      // fields of developer data index, NULL if none described
+   uint8_t described[UINT8_MAX+1][(UINT8_MAX+1)/8];   // bit per field number
+} _fit_dev_table;
+
+void fit_dev_init (_fit_dev_table *table);
+int32_t fit_dev_add_mesg (_fit_dev_table *table, FIT_UINT16 global_mesg_num, const FIT_FIELD_DEF *fields, FIT_UINT8 num_fields, const uint8_t *data);
+const _fit_dev_field *fit_dev_lookup (const _fit_dev_table *table, FIT_UINT8 dev_index, FIT_UINT8 def_num);
+void fit_dev_free (_fit_dev_table *table);
+
+#endif // FIT_DEV_
@@ -0,0 +1,338 @@
+/*
+
+   This code uses GARMIN FIT SDK V21.141.00 (https://developer.garmin.com/downloads/fit/sdk/FitSDKRelease_21.141.00.zip)
+   Under the Flexible and Interoperable Data Transfer (FIT) Protocol License:
+   (https://www.thisisant.com/developer/ant/licensing/flexible-and-interoperable-data-transfer-fit-protocol-license).
+
+	Encoder of FIT records from fields values, for programs that write FIT files directly.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+
+#include <fit_example.h>
+
+#include <fit_writer.h>
+#include <fit_encoder.h>
+
+#define DEF_HDR_SIZE          5              // reserved, architecture, global message number and number of fields
+
+enum {
+   KIND_UNSIGNED = 0,
+   KIND_SIGNED,
+   KIND_FLOAT,
+   KIND_STRING
+};
+
+// element size and invalid value of base types. fields of other base types, or with size that is not
+// a multiple of their element size, are bytes
+typedef struct {
+   FIT_UINT8 base_type;
+   uint8_t kind;
+   uint8_t t_size;
+   uint64_t invalid;
+} _base_type;
+
+static const _base_type base_types[] = {
+   {FIT_FIT_BASE_TYPE_ENUM, KIND_UNSIGNED, sizeof(uint8_t), FIT_ENUM_INVALID},
+   {FIT_FIT_BASE_TYPE_SINT8, KIND_SIGNED, sizeof(int8_t), (uint8_t)FIT_SINT8_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT8, KIND_UNSIGNED, sizeof(uint8_t), FIT_UINT8_INVALID},
+   {FIT_FIT_BASE_TYPE_SINT16, KIND_SIGNED, sizeof(int16_t), (uint16_t)FIT_SINT16_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT16, KIND_UNSIGNED, sizeof(uint16_t), FIT_UINT16_INVALID},
+   {FIT_FIT_BASE_TYPE_SINT32, KIND_SIGNED, sizeof(int32_t), (uint32_t)FIT_SINT32_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT32, KIND_UNSIGNED, sizeof(uint32_t), FIT_UINT32_INVALID},
+   {FIT_FIT_BASE_TYPE_STRING, KIND_STRING, sizeof(uint8_t), 0},
+   {FIT_FIT_BASE_TYPE_FLOAT32, KIND_FLOAT, sizeof(float), UINT32_MAX},
+   {FIT_FIT_BASE_TYPE_FLOAT64, KIND_FLOAT, sizeof(double), UINT64_MAX},
+   {FIT_FIT_BASE_TYPE_UINT8Z, KIND_UNSIGNED, sizeof(uint8_t), FIT_UINT8Z_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT16Z, KIND_UNSIGNED, sizeof(uint16_t), FIT_UINT16Z_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT32Z, KIND_UNSIGNED, sizeof(uint32_t), FIT_UINT32Z_INVALID},
+   {FIT_FIT_BASE_TYPE_SINT64, KIND_SIGNED, sizeof(int64_t), (uint64_t)FIT_SINT64_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT64, KIND_UNSIGNED, sizeof(uint64_t), FIT_UINT64_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT64Z, KIND_UNSIGNED, sizeof(uint64_t), FIT_UINT64Z_INVALID}
+};
+
+static const _base_type *get_base_type (FIT_UINT8 base_type, uint8_t size) {
+   int32_t i;
+
+   for (i = 0; i < sizeof(base_types)/sizeof(base_types[0]); i++) {
+      if ((base_types[i].base_type == base_type) && (size % base_types[i].t_size == 0))
+         return &base_types[i];
+   }
+   return NULL;
+}
+
+bool fit_encoder_base_type (FIT_UINT8 base_type, uint8_t size, uint8_t *t_size, uint64_t *invalid) {
+   const _base_type *t = get_base_type(base_type, size);
+
+   if (t == NULL)
+      return false;
+   *t_size = t->t_size;
+   *invalid = t->invalid;
+   return true;
+}
+
+static inline const FIT_FIELD_DEF *mesg_field (const _fit_encoder_mesg *mesg, int32_t i) {
+   return (const FIT_FIELD_DEF *)(mesg->def + DEF_HDR_SIZE + i * sizeof(FIT_FIELD_DEF));
+}
+
+static inline const FIT_DEV_FIELD_DEF *mesg_dev_field (const _fit_encoder_mesg *mesg, int32_t i) {
+   return (const FIT_DEV_FIELD_DEF *)(mesg->def + DEF_HDR_SIZE + mesg->num_fields * sizeof(FIT_FIELD_DEF) + 1 + i * sizeof(FIT_DEV_FIELD_DEF));
+}
+
+// write element of t_size bytes in little endian
+static void put_elem (uint8_t *v, uint8_t t_size, uint64_t bits) {
+   int32_t i;
+
+   for (i = 0; i < t_size; i++, bits >>= 8)
+      v[i] = bits & 0xFF;
+}
+
+/****************************************************/
+/* definitions                                      */
+/****************************************************/
+
+// set message definition (little endian architecture) and allocate its data record
+// return 0 on success, -1 on error (error is printed)
+int32_t fit_encoder_def (_fit_encoder_mesg *mesg, FIT_UINT16 global_mesg_num, const FIT_FIELD_DEF *fields, uint8_t num_fields,
+                         const FIT_DEV_FIELD_DEF *dev_fields, uint8_t num_dev_fields) {
+   uint8_t *p;
+   uint32_t offset = 0;
+   int32_t i;
+
+   memset(mesg, 0, sizeof(_fit_encoder_mesg));
+   mesg->num_fields = num_fields;
+   mesg->num_dev_fields = num_dev_fields;
+   mesg->dev = (num_dev_fields > 0);
+
+   p = mesg->def;
+   *p++ = 0;                                 // reserved
+   *p++ = FIT_ARCH_ENDIAN_LITTLE;
+   put_elem(p, sizeof(FIT_UINT16), global_mesg_num);
+   p += sizeof(FIT_UINT16);
+   *p++ = num_fields;
+   memcpy(p, fields, num_fields * sizeof(FIT_FIELD_DEF));
+   p += num_fields * sizeof(FIT_FIELD_DEF);
+   if (mesg->dev) {
+      *p++ = num_dev_fields;
+      memcpy(p, dev_fields, num_dev_fields * sizeof(FIT_DEV_FIELD_DEF));
+      p += num_dev_fields * sizeof(FIT_DEV_FIELD_DEF);
+   }
+   mesg->def_len = p - mesg->def;
+
+   // a field that shows up twice in definition is set at its first place
+   memset(mesg->index, FIT_ENCODER_NO_FIELD, sizeof(mesg->index));
+   for (i = 0; i < num_fields; i++) {
+      if (mesg->index[fields[i].field_def_num] == FIT_ENCODER_NO_FIELD)
+         mesg->index[fields[i].field_def_num] = i;
+      mesg->offset[i] = offset;
+      offset += fields[i].size;
+   }
+   for (i = 0; i < num_dev_fields; i++) {
+      mesg->dev_offset[i] = offset;
+      offset += dev_fields[i].size;
+   }
+
+   mesg->data_len = offset;
+   if ((mesg->data = malloc(offset > 0 ? offset : 1)) == NULL) {
+      fprintf(stderr, "Failed to allocate memory for message %u, %s\n", global_mesg_num, strerror(errno));
+      return -1;
+   }
+   fit_encoder_clear(mesg);
+   return 0;
+}
+
+void fit_encoder_free (_fit_encoder_mesg *mesg) {
+   free(mesg->data);
+   mesg->data = NULL;
+}
+
+// set invalid values in all fields of data record. developer fields are all 0xFF bytes
+void fit_encoder_clear (_fit_encoder_mesg *mesg) {
+   const FIT_FIELD_DEF *field;
+   const _base_type *t;
+   int32_t i, e;
+
+   memset(mesg->data, FIT_BYTE_INVALID, mesg->data_len);
+   for (i = 0; i < mesg->num_fields; i++) {
+      field = mesg_field(mesg, i);
+      if ((t = get_base_type(field->base_type, field->size)) == NULL)
+         continue;
+      for (e = 0; e < field->size; e += t->t_size)
+         put_elem(mesg->data + mesg->offset[i] + e, t->t_size, t->invalid);
+   }
+}
+
+/****************************************************/
+/* fields values                                    */
+/****************************************************/
+
+// element position in data record and base type of field, NULL if field is not defined or has no such element
+static uint8_t *field_elem (_fit_encoder_mesg *mesg, FIT_UINT8 field_num, uint32_t elem, const _base_type **t) {
+   uint8_t i = mesg->index[field_num];
+   const FIT_FIELD_DEF *field;
+
+   if (i == FIT_ENCODER_NO_FIELD)
+      return NULL;
+   field = mesg_field(mesg, i);
+   if (((*t = get_base_type(field->base_type, field->size)) == NULL) || ((elem + 1) * (*t)->t_size > field->size))
+      return NULL;
+   return mesg->data + mesg->offset[i] + elem * (*t)->t_size;
+}
+
+static void put_float (uint8_t *v, uint8_t t_size, double d) {
+   uint64_t bits;
+   uint32_t bits32;
+   float f;
+
+   if (t_size == sizeof(float)) {
+      f = d;
+      memcpy(&bits32, &f, sizeof(f));
+      bits = bits32;
+   }
+   else
+      memcpy(&bits, &d, sizeof(d));
+   put_elem(v, t_size, bits);
+}
+
+bool fit_encoder_set_uint (_fit_encoder_mesg *mesg, FIT_UINT8 field_num, uint32_t elem, uint64_t v) {
+   const _base_type *t;
+   uint8_t *p;
+
+   if ((p = field_elem(mesg, field_num, elem, &t)) == NULL)
+      return false;
+   switch (t->kind) {
+      case KIND_UNSIGNED:
+         if ((t->t_size < sizeof(v)) && (v >> (t->t_size * 8) != 0))
+            return false;
+         break;
+      case KIND_SIGNED:
+         if (v >> (t->t_size * 8 - 1) != 0)
+            return false;
+         break;
+      case KIND_FLOAT:
+         put_float(p, t->t_size, v);
+         return true;
+      default:
+         return false;
+   }
+   put_elem(p, t->t_size, v);
+   return true;
+}
+
+bool fit_encoder_set_sint (_fit_encoder_mesg *mesg, FIT_UINT8 field_num, uint32_t elem, int64_t v) {
+   const _base_type *t;
+   uint8_t *p;
+   int64_t min;
+
+   if ((p = field_elem(mesg, field_num, elem, &t)) == NULL)
+      return false;
+   switch (t->kind) {
+      case KIND_UNSIGNED:
+         return (v >= 0) && fit_encoder_set_uint(mesg, field_num, elem, v);
+      case KIND_SIGNED:
+         if (t->t_size < sizeof(v)) {
+            min = -((int64_t)1 << (t->t_size * 8 - 1));
+            if ((v < min) || (v > -(min + 1)))
+               return false;
+         }
+         break;
+      case KIND_FLOAT:
+         put_float(p, t->t_size, v);
+         return true;
+      default:
+         return false;
+   }
+   put_elem(p, t->t_size, v);
+   return true;
+}
+
+// float fields take the value as is, integer fields take it rounded (scale and offset are not applied)
+bool fit_encoder_set_float (_fit_encoder_mesg *mesg, FIT_UINT8 field_num, uint32_t elem, double v) {
+   const _base_type *t;
+   uint8_t *p;
+
+   if ((p = field_elem(mesg, field_num, elem, &t)) == NULL)
+      return false;
+   switch (t->kind) {
+      case KIND_FLOAT:
+         put_float(p, t->t_size, v);
+         return true;
+      case KIND_UNSIGNED:
+      case KIND_SIGNED:
+         // out of int64 range values fail range check of 64 bits fields too
+         if (!(v > -9.3e18 && v < 9.3e18))
+            return false;
+         return fit_encoder_set_sint(mesg, field_num, elem, llround(v));
+      default:
+         return false;
+   }
+}
+
+// string is 0 padded to field size. it fails if it is longer than the field
+bool fit_encoder_set_string (_fit_encoder_mesg *mesg, FIT_UINT8 field_num, const char *s) {
+   uint8_t i = mesg->index[field_num];
+   const FIT_FIELD_DEF *field;
+   size_t len = strlen(s);
+
+   if (i == FIT_ENCODER_NO_FIELD)
+      return false;
+   field = mesg_field(mesg, i);
+   if ((field->base_type != FIT_FIT_BASE_TYPE_STRING) || (len > field->size))
+      return false;
+   memset(mesg->data + mesg->offset[i], 0, field->size);
+   memcpy(mesg->data + mesg->offset[i], s, len);
+   return true;
+}
+
+// binary value of whole field, len must be the field size. multi byte values must be little endian
+bool fit_encoder_set_bytes (_fit_encoder_mesg *mesg, FIT_UINT8 field_num, const void *v, uint32_t len) {
+   uint8_t i = mesg->index[field_num];
+
+   if ((i == FIT_ENCODER_NO_FIELD) || (len != mesg_field(mesg, i)->size))
+      return false;
+   memcpy(mesg->data + mesg->offset[i], v, len);
+   return true;
+}
+
+// binary value of developer field, len must be the field size
+bool fit_encoder_set_dev (_fit_encoder_mesg *mesg, FIT_UINT8 dev_index, FIT_UINT8 field_num, const void *v, uint32_t len) {
+   const FIT_DEV_FIELD_DEF *field;
+   int32_t i;
+
+   for (i = 0; i < mesg->num_dev_fields; i++) {
+      field = mesg_dev_field(mesg, i);
+      if ((field->dev_index == dev_index) && (field->def_num == field_num)) {
+         if (len != field->size)
+            return false;
+         memcpy(mesg->data + mesg->dev_offset[i], v, len);
+         return true;
+      }
+   }
+   return false;
+}
+
+// write data record of message, with compressed timestamp header if time_offset is not -1 (the timestamp
+// field must then be left out of the definition). the definition record is written when no local message
+// type holds it
+// return 0 on success, -1 on error (error is printed)
+int32_t fit_encoder_write (_fit_writer *w, const _fit_encoder_mesg *mesg, int32_t time_offset) {
+   return fit_writer_mesg(w, mesg->def, mesg->def_len, mesg->dev, time_offset, mesg->data, mesg->data_len);
+}
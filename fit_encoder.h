@@ -0,0 +1,46 @@
+#ifndef FIT_ENCODER_
+#define FIT_ENCODER_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <fit_writer.h>
+
+#define FIT_ENCODER_NO_FIELD     0xFF           // field is not in definition
+
+// message of one definition, and its data record being built. field values are set by field
+// number and written in little endian. a new record holds invalid values in all fields
+typedef struct {
+   uint8_t def[FIT_WRITER_DEF_SIZE];            // definition record content (after record header)
+   uint32_t def_len;
+   bool dev;                                    // definition has developer fields
+   uint8_t num_fields;
+   uint8_t num_dev_fields;
+   uint8_t index[UINT8_MAX+1];                  // field index by field number, FIT_ENCODER_NO_FIELD if not defined
+   uint16_t offset[UINT8_MAX+1];                // data offset by field index
+   uint16_t dev_offset[UINT8_MAX+1];            // data offset by developer field index
+   uint8_t *data;                               // data record content (after record header)
+   uint32_t data_len;
+} _fit_encoder_mesg;
+
+int32_t fit_encoder_def (_fit_encoder_mesg *mesg, FIT_UINT16 global_mesg_num, const FIT_FIELD_DEF *fields, uint8_t num_fields,
+                         const FIT_DEV_FIELD_DEF *dev_fields, uint8_t num_dev_fields);
+void fit_encoder_free (_fit_encoder_mesg *mesg);
+void fit_encoder_clear (_fit_encoder_mesg *mesg);
+
+// set field value. elem is array element index (0 for single value fields). return false if field is not
+// in definition, its base type does not take the value or the value is out of its range
+bool fit_encoder_set_uint (_fit_encoder_mesg *mesg, FIT_UINT8 field_num, uint32_t elem, uint64_t v);
+bool fit_encoder_set_sint (_fit_encoder_mesg *mesg, FIT_UINT8 field_num, uint32_t elem, int64_t v);
+bool fit_encoder_set_float (_fit_encoder_mesg *mesg, FIT_UINT8 field_num, uint32_t elem, double v);
+bool fit_encoder_set_string (_fit_encoder_mesg *mesg, FIT_UINT8 field_num, const char *s);
+bool fit_encoder_set_bytes (_fit_encoder_mesg *mesg, FIT_UINT8 field_num, const void *v, uint32_t len);
+bool fit_encoder_set_dev (_fit_encoder_mesg *mesg, FIT_UINT8 dev_index, FIT_UINT8 field_num, const void *v, uint32_t len);
+
+int32_t fit_encoder_write (_fit_writer *w, const _fit_encoder_mesg *mesg, int32_t time_offset);
+
+// element size and invalid value of base type, for fields of size bytes. false if base type is not known
+// or size is not a multiple of its element size (field is bytes)
+bool fit_encoder_base_type (FIT_UINT8 base_type, uint8_t size, uint8_t *t_size, uint64_t *invalid);
+
+#endif // FIT_ENCODER_
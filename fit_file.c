@@ -0,0 +1,89 @@
+/*
+
+   This code uses GARMIN FIT SDK V21.141.00 (https://developer.garmin.com/downloads/fit/sdk/FitSDKRelease_21.141.00.zip)
+   Under the Flexible and Interoperable Data Transfer (FIT) Protocol License:
+   (https://www.thisisant.com/developer/ant/licensing/flexible-and-interoperable-data-transfer-fit-protocol-license).
+
+	Map FIT file to memory for reading.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <fit_file.h>
+
+// map FIT file for reading, if it can not be mapped read it to memory
+// return false on error (error is printed)
+bool fit_file_open (_fit_file *file, const char *name) {
+   FILE *f;
+#ifndef _WIN32
+   struct stat st;
+   void *p;
+   int32_t fd;
+
+   if ((fd = open(name, O_RDONLY)) < 0) {
+      fprintf(stderr, "Failed to open FIT file: %s, %s\n", name, strerror(errno));
+      return false;
+   }
+   if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0)) {
+      if ((p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) != MAP_FAILED) {
+         close(fd);
+         file->data = p;
+         file->size = st.st_size;
+         file->mapped = true;
+         return true;
+      }
+   }
+   close(fd);
+#endif
+
+   file->mapped = false;
+   if ((f = fopen(name, "rb")) == NULL) {
+      fprintf(stderr, "Failed to open FIT file: %s, %s\n", name, strerror(errno));
+      return false;
+   }
+   if ((fseek(f, 0, SEEK_END) != 0) || ((long)(file->size = ftell(f)) < 0) || (fseek(f, 0, SEEK_SET) != 0) ||
+       ((file->data = malloc(file->size + 1)) == NULL) || (fread(file->data, 1, file->size, f) != file->size)) {
+      fprintf(stderr, "Failed to read FIT file: %s, %s\n", name, strerror(errno));
+      free(file->data);
+      file->data = NULL;
+      fclose(f);
+      return false;
+   }
+   fclose(f);
+   return true;
+}
+
+void fit_file_close (_fit_file *file) {
+#ifndef _WIN32
+   if (file->mapped) {
+      munmap(file->data, file->size);
+      file->data = NULL;
+      return;
+   }
+#endif
+   free(file->data);
+   file->data = NULL;
+}
@@ -0,0 +1,18 @@
+#ifndef FIT_FILE_
+#define FIT_FILE_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// whole FIT file, mapped or read to memory
+typedef struct {
+   uint8_t *data;
+   size_t size;
+   bool mapped;
+} _fit_file;
+
+bool fit_file_open (_fit_file *file, const char *name);
+void fit_file_close (_fit_file *file);
+
+#endif // FIT_FILE_
@@ -0,0 +1,210 @@
+/*
+
+   This code uses GARMIN FIT SDK V21.141.00 (https://developer.garmin.com/downloads/fit/sdk/FitSDKRelease_21.141.00.zip)
+   Under the Flexible and Interoperable Data Transfer (FIT) Protocol License:
+   (https://www.thisisant.com/developer/ant/licensing/flexible-and-interoperable-data-transfer-fit-protocol-license).
+
+	Sidecar index of FIT file records timestamps, to start reading records close to a time.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fit_example.h>
+
+#include <fit_index.h>
+
+#define TIMESTAMP_FIELD       253            // timestamp field number, same in all messages
+#define TIMESTAMP_INVALID     0xFFFFFFFF
+
+void fit_index_init (_fit_index *idx) {
+   memset(idx, 0, sizeof(_fit_index));
+   memcpy(idx->hdr.magic, FIT_INDEX_MAGIC, sizeof(idx->hdr.magic));
+   idx->hdr.monotonic = 1;
+}
+
+// grow array of entries of size bytes to hold n+1 entries. return 0 on success, -1 on allocation error
+static int32_t grow (void **entries, uint32_t *allocated, uint32_t n, size_t size) {
+   void *p;
+   uint32_t new_size;
+
+   if (n < *allocated)
+      return 0;
+   new_size = *allocated ? *allocated * 2 : 64;
+   if ((p = realloc(*entries, new_size * size)) == NULL)
+      return -1;
+   *entries = p;
+   *allocated = new_size;
+   return 0;
+}
+
+// timestamp field value of data record, TIMESTAMP_INVALID if it has none
+static FIT_UINT32 rec_timestamp (const _fit_scan_rec *rec) {
+   const uint8_t *v = rec->data;
+   FIT_UINT32 ts = TIMESTAMP_INVALID;
+   int32_t i;
+
+   for (i = 0; i < rec->type->num_fields; v += rec->type->fields[i].size, i++) {
+      if ((rec->type->fields[i].field_def_num == TIMESTAMP_FIELD) && (rec->type->fields[i].size == sizeof(ts))) {
+         memcpy(&ts, v, sizeof(ts));
+         break;
+      }
+   }
+   return ts;
+}
+
+// offset of definition record of local message type in file
+static uint32_t def_offset (const _fit_scan *scan, const _fit_scan_type *type) {
+   return (type->def != NULL) ? type->def - scan->file - 1 : 0;
+}
+
+// add record walked by scan to index. return 0 on success, -1 on allocation error
+int32_t fit_index_add (_fit_index *idx, const _fit_scan *scan, const _fit_scan_rec *rec) {
+   _fit_index_checkpoint *cp;
+   FIT_UINT32 ts;
+   int32_t i;
+
+   if (rec->def)
+      return 0;
+   idx->records++;
+
+   // developer fields descriptions are read again after a jump
+   if ((rec->type->global_mesg_num == FIT_MESG_NUM_DEVELOPER_DATA_ID) || (rec->type->global_mesg_num == FIT_MESG_NUM_FIELD_DESCRIPTION)) {
+      if (idx->hdr.head_end == 0)
+         return 0;
+      if (grow((void **)&idx->dev_recs, &idx->dev_recs_size, idx->hdr.num_dev_recs, sizeof(_fit_index_dev_rec)) != 0)
+         return -1;
+      idx->dev_recs[idx->hdr.num_dev_recs].def_offset = def_offset(scan, rec->type);
+      idx->dev_recs[idx->hdr.num_dev_recs].data_offset = rec->offset;
+      idx->hdr.num_dev_recs++;
+      return 0;
+   }
+
+   // compressed timestamp is the time offset from the last timestamp, the way FIT reader tracks it
+   if (rec->rec_hdr & FIT_HDR_TIME_REC_BIT) {
+      if (!idx->last_ts_valid)
+         return 0;
+      ts = idx->last_ts;
+      if ((rec->rec_hdr & FIT_HDR_TIME_OFFSET_MASK) < (ts & FIT_HDR_TIME_OFFSET_MASK))
+         ts += FIT_HDR_TIME_OFFSET_MASK + 1;
+      ts = (ts & ~FIT_HDR_TIME_OFFSET_MASK) | (rec->rec_hdr & FIT_HDR_TIME_OFFSET_MASK);
+   }
+   else if ((ts = rec_timestamp(rec)) == TIMESTAMP_INVALID)
+      return 0;
+
+   if (idx->hdr.head_end == 0)
+      idx->hdr.head_end = rec->offset;
+   if (idx->last_ts_valid && (ts < idx->last_ts))
+      idx->hdr.monotonic = 0;
+   idx->last_ts = ts;
+   idx->last_ts_valid = true;
+
+   // checkpoints are records with timestamp field, so reading can start from them without the last timestamp
+   if ((rec->rec_hdr & FIT_HDR_TIME_REC_BIT) || (idx->records < FIT_INDEX_INTERVAL))
+      return 0;
+
+   if (grow((void **)&idx->checkpoints, &idx->checkpoints_size, idx->hdr.num_checkpoints, sizeof(_fit_index_checkpoint)) != 0)
+      return -1;
+   cp = &idx->checkpoints[idx->hdr.num_checkpoints++];
+   cp->offset = rec->offset;
+   cp->timestamp = ts;
+   for (i = 0; i <= FIT_HDR_TYPE_MASK; i++)
+      cp->def_offsets[i] = def_offset(scan, &scan->types[i]);
+   idx->records = 0;
+   return 0;
+}
+
+// write index of scanned file. return 0 on success, -1 on error (errno is set)
+int32_t fit_index_write (_fit_index *idx, const _fit_scan *scan, const char *name) {
+   FILE *f;
+   int32_t r = 0;
+
+   idx->hdr.file_size = scan->file_size;
+   memcpy(&idx->hdr.file_crc, scan->file + scan->data_end, sizeof(idx->hdr.file_crc));
+
+   if ((f = fopen(name, "wb")) == NULL)
+      return -1;
+
+   if ((fwrite(&idx->hdr, sizeof(_fit_index_hdr), 1, f) != 1) ||
+       (fwrite(idx->dev_recs, sizeof(_fit_index_dev_rec), idx->hdr.num_dev_recs, f) != idx->hdr.num_dev_recs) ||
+       (fwrite(idx->checkpoints, sizeof(_fit_index_checkpoint), idx->hdr.num_checkpoints, f) != idx->hdr.num_checkpoints))
+      r = -1;
+
+   if ((fclose(f) != 0) || (r != 0)) {
+      remove(name);
+      return -1;
+   }
+   return 0;
+}
+
+// read index of FIT file with file_size and file_crc.
+// return 0 on success, -1 if index can not be read or was made for another file (or older version of the file)
+int32_t fit_index_read (_fit_index *idx, const char *name, uint32_t file_size, FIT_UINT16 file_crc) {
+   FILE *f;
+   int32_t r = -1;
+
+   fit_index_init(idx);
+   if ((f = fopen(name, "rb")) == NULL)
+      return -1;
+
+   if ((fread(&idx->hdr, sizeof(_fit_index_hdr), 1, f) != 1) || (memcmp(idx->hdr.magic, FIT_INDEX_MAGIC, sizeof(idx->hdr.magic)) != 0) ||
+       (idx->hdr.file_size != file_size) || (idx->hdr.file_crc != file_crc))
+      goto done;
+
+   if (((idx->dev_recs = malloc(idx->hdr.num_dev_recs * sizeof(_fit_index_dev_rec) + 1)) == NULL) ||
+       ((idx->checkpoints = malloc(idx->hdr.num_checkpoints * sizeof(_fit_index_checkpoint) + 1)) == NULL))
+      goto done;
+
+   if ((fread(idx->dev_recs, sizeof(_fit_index_dev_rec), idx->hdr.num_dev_recs, f) != idx->hdr.num_dev_recs) ||
+       (fread(idx->checkpoints, sizeof(_fit_index_checkpoint), idx->hdr.num_checkpoints, f) != idx->hdr.num_checkpoints))
+      goto done;
+
+   idx->dev_recs_size = idx->hdr.num_dev_recs;
+   idx->checkpoints_size = idx->hdr.num_checkpoints;
+   r = 0;
+
+done:
+   fclose(f);
+   if (r != 0)
+      fit_index_free(idx);
+   return r;
+}
+
+// last checkpoint with timestamp before timestamp, NULL if none. checkpoints of index of file
+// with monotonic timestamps are sorted by timestamp, so they are binary searched
+const _fit_index_checkpoint *fit_index_find (const _fit_index *idx, FIT_UINT32 timestamp) {
+   uint32_t lo = 0, hi = idx->hdr.num_checkpoints, mid;
+
+   if (!idx->hdr.monotonic)
+      return NULL;
+
+   while (lo < hi) {
+      mid = lo + (hi - lo) / 2;
+      if (idx->checkpoints[mid].timestamp < timestamp)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   return (lo > 0) ? &idx->checkpoints[lo-1] : NULL;
+}
+
+void fit_index_free (_fit_index *idx) {
+   free(idx->dev_recs);
+   free(idx->checkpoints);
+   fit_index_init(idx);
+}
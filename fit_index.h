@@ -0,0 +1,56 @@
+#ifndef FIT_INDEX_
+#define FIT_INDEX_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <fit_scan.h>
+
+#define FIT_INDEX_MAGIC       "FITIDX1"      // 8 bytes with 0 terminator
+#define FIT_INDEX_INTERVAL    1024           // data records between checkpoints
+#define FIT_INDEX_SUFFIX      ".idx"         // index file name is FIT file name with this suffix
+
+// index file header. the index is valid only for the FIT file of this size and file CRC
+typedef struct {
+   int8_t magic[8];
+   uint32_t file_size;
+   FIT_UINT16 file_crc;
+   uint8_t monotonic;                        // 1 if records timestamps never go back
+   uint8_t reserved;
+   uint32_t head_end;                        // offset of first record with timestamp, 0 if none
+   uint32_t num_dev_recs;
+   uint32_t num_checkpoints;
+} _fit_index_hdr;
+
+// developer_data_id and field_description records after head_end, with their definitions
+typedef struct {
+   uint32_t def_offset;
+   uint32_t data_offset;
+} _fit_index_dev_rec;
+
+// record with timestamp field, and the definitions of all local message types before it (0 if not defined)
+typedef struct {
+   uint32_t offset;
+   FIT_UINT32 timestamp;
+   uint32_t def_offsets[FIT_HDR_TYPE_MASK+1];
+} _fit_index_checkpoint;
+
+typedef struct {
+   _fit_index_hdr hdr;
+   _fit_index_dev_rec *dev_recs;
+   _fit_index_checkpoint *checkpoints;
+   uint32_t dev_recs_size;                   // allocated entries
+   uint32_t checkpoints_size;
+   uint32_t records;                         // data records since last checkpoint
+   FIT_UINT32 last_ts;
+   bool last_ts_valid;
+} _fit_index;
+
+void fit_index_init (_fit_index *idx);
+int32_t fit_index_add (_fit_index *idx, const _fit_scan *scan, const _fit_scan_rec *rec);
+int32_t fit_index_write (_fit_index *idx, const _fit_scan *scan, const char *name);
+int32_t fit_index_read (_fit_index *idx, const char *name, uint32_t file_size, FIT_UINT16 file_crc);
+const _fit_index_checkpoint *fit_index_find (const _fit_index *idx, FIT_UINT32 timestamp);
+void fit_index_free (_fit_index *idx);
+
+#endif // FIT_INDEX_
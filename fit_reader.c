@@ -0,0 +1,296 @@
+/*
+
+   This code uses GARMIN FIT SDK V21.141.00 (https://developer.garmin.com/downloads/fit/sdk/FitSDKRelease_21.141.00.zip)
+   Under the Flexible and Interoperable Data Transfer (FIT) Protocol License:
+   (https://www.thisisant.com/developer/ant/licensing/flexible-and-interoperable-data-transfer-fit-protocol-license).
+
+	Callback reader of FIT records, with typed accessors of fields values.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fit_example.h>
+
+#include <fit_scan.h>
+#include <fit_reader.h>
+
+#define TIMESTAMP_FIELD       253            // timestamp field number, same in all messages
+
+enum {
+   KIND_UNSIGNED = 0,
+   KIND_SIGNED,
+   KIND_FLOAT
+};
+
+typedef struct {
+   FIT_UINT8 base_type;
+   uint8_t kind;
+   uint8_t t_size;
+   uint64_t invalid;
+} _num_type;
+
+// numeric base types, other types have no numeric value
+static const _num_type num_types[] = {
+   {FIT_FIT_BASE_TYPE_ENUM, KIND_UNSIGNED, sizeof(uint8_t), FIT_ENUM_INVALID},
+   {FIT_FIT_BASE_TYPE_SINT8, KIND_SIGNED, sizeof(int8_t), (uint8_t)FIT_SINT8_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT8, KIND_UNSIGNED, sizeof(uint8_t), FIT_UINT8_INVALID},
+   {FIT_FIT_BASE_TYPE_SINT16, KIND_SIGNED, sizeof(int16_t), (uint16_t)FIT_SINT16_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT16, KIND_UNSIGNED, sizeof(uint16_t), FIT_UINT16_INVALID},
+   {FIT_FIT_BASE_TYPE_SINT32, KIND_SIGNED, sizeof(int32_t), (uint32_t)FIT_SINT32_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT32, KIND_UNSIGNED, sizeof(uint32_t), FIT_UINT32_INVALID},
+   {FIT_FIT_BASE_TYPE_FLOAT32, KIND_FLOAT, sizeof(float), UINT32_MAX},
+   {FIT_FIT_BASE_TYPE_FLOAT64, KIND_FLOAT, sizeof(double), UINT64_MAX},
+   {FIT_FIT_BASE_TYPE_UINT8Z, KIND_UNSIGNED, sizeof(uint8_t), FIT_UINT8Z_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT16Z, KIND_UNSIGNED, sizeof(uint16_t), FIT_UINT16Z_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT32Z, KIND_UNSIGNED, sizeof(uint32_t), FIT_UINT32Z_INVALID},
+   {FIT_FIT_BASE_TYPE_SINT64, KIND_SIGNED, sizeof(int64_t), (uint64_t)FIT_SINT64_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT64, KIND_UNSIGNED, sizeof(uint64_t), FIT_UINT64_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT64Z, KIND_UNSIGNED, sizeof(uint64_t), FIT_UINT64Z_INVALID}
+};
+
+static const _num_type *get_num_type (FIT_UINT8 base_type) {
+   int32_t t;
+
+   for (t = 0; t < sizeof(num_types)/sizeof(num_types[0]); t++) {
+      if (num_types[t].base_type == base_type)
+         return &num_types[t];
+   }
+   return NULL;
+}
+
+// read element of t_size bytes in arch byte order
+static uint64_t elem_bits (const uint8_t *v, uint8_t t_size, FIT_UINT8 arch) {
+   uint64_t bits = 0;
+   int32_t i;
+
+   if (arch == FIT_ARCH_ENDIAN_BIG) {
+      for (i = 0; i < t_size; i++)
+         bits = (bits << 8) | v[i];
+   }
+   else {
+      for (i = t_size - 1; i >= 0; i--)
+         bits = (bits << 8) | v[i];
+   }
+   return bits;
+}
+
+/****************************************************/
+/* reading                                          */
+/****************************************************/
+
+void fit_reader_init (_fit_reader *reader, _fit_reader_def_cb on_def, _fit_reader_mesg_cb on_mesg, void *ctx) {
+   memset(reader, 0, sizeof(_fit_reader));
+   reader->on_def = on_def;
+   reader->on_mesg = on_mesg;
+   reader->ctx = ctx;
+}
+
+// fields lookup tables of local message type definition
+static void set_fields (_fit_reader_fields *f, const _fit_scan_type *type) {
+   uint16_t offset = 0;
+   int32_t i;
+
+   memset(f->index, FIT_READER_NO_FIELD, sizeof(f->index));
+   for (i = 0; i < type->num_fields; i++) {
+      // a field that shows up twice in definition is found at its first place
+      if (f->index[type->fields[i].field_def_num] == FIT_READER_NO_FIELD)
+         f->index[type->fields[i].field_def_num] = i;
+      f->offset[i] = offset;
+      offset += type->fields[i].size;
+   }
+   for (i = 0; i < type->num_dev_fields; i++) {
+      f->dev_offset[i] = offset;
+      offset += type->dev_fields[i].size;
+   }
+}
+
+// walk all records of file and call the callbacks. the file header CRC and file CRC are not checked
+// return 0 when all records were read, 1 if a callback stopped reading and -1 on error (reader->scan.error)
+int32_t fit_reader_read (_fit_reader *reader, const uint8_t *file, size_t file_size) {
+   _fit_scan_rec rec;
+   _fit_reader_def def;
+   _fit_reader_mesg mesg;
+   FIT_UINT64 ts;
+   int32_t r;
+
+   reader->last_ts_valid = false;
+   if (fit_scan_open(&reader->scan, file, file_size) != 0)
+      return -1;
+
+   while ((r = fit_scan_next(&reader->scan, &rec)) > 0) {
+      if (rec.def) {
+         set_fields(&reader->fields[rec.mesg_type], rec.type);
+         if (reader->on_def == NULL)
+            continue;
+         def.offset = rec.offset;
+         def.mesg_type = rec.mesg_type;
+         def.type = rec.type;
+         def.rec = rec.data;
+         def.len = rec.len - 1;
+         if (reader->on_def(reader->ctx, &def) != 0)
+            return 1;
+         continue;
+      }
+
+      mesg.offset = rec.offset;
+      mesg.mesg_type = rec.mesg_type;
+      mesg.type = rec.type;
+      mesg.data = rec.data;
+      mesg.len = rec.len - 1;
+      mesg.fields = &reader->fields[rec.mesg_type];
+      mesg.compressed_ts = (rec.rec_hdr & FIT_HDR_TIME_REC_BIT) != 0;
+      mesg.timestamp = FIT_UINT32_INVALID;
+
+      // compressed timestamp header time offset is added to the last timestamp
+      if (mesg.compressed_ts) {
+         if (reader->last_ts_valid) {
+            ts = reader->last_ts;
+            if ((rec.rec_hdr & FIT_HDR_TIME_OFFSET_MASK) < (ts & FIT_HDR_TIME_OFFSET_MASK))
+               ts += FIT_HDR_TIME_OFFSET_MASK + 1;
+            mesg.timestamp = reader->last_ts = (ts & ~FIT_HDR_TIME_OFFSET_MASK) | (rec.rec_hdr & FIT_HDR_TIME_OFFSET_MASK);
+         }
+      }
+      else if (fit_reader_uint(&mesg, TIMESTAMP_FIELD, 0, &ts)) {
+         mesg.timestamp = reader->last_ts = ts;
+         reader->last_ts_valid = true;
+      }
+
+      if ((reader->on_mesg != NULL) && (reader->on_mesg(reader->ctx, &mesg) != 0))
+         return 1;
+   }
+   return (r < 0) ? -1 : 0;
+}
+
+/****************************************************/
+/* accessors                                        */
+/****************************************************/
+
+// field value bytes in data record, NULL if field is not in record
+const uint8_t *fit_reader_field (const _fit_reader_mesg *mesg, FIT_UINT8 field_num, const FIT_FIELD_DEF **field) {
+   uint8_t i = mesg->fields->index[field_num];
+
+   if (i == FIT_READER_NO_FIELD)
+      return NULL;
+   if (field != NULL)
+      *field = &mesg->type->fields[i];
+   return mesg->data + mesg->fields->offset[i];
+}
+
+// number of array elements of numeric field, 0 if field is not in record or is not numeric
+uint32_t fit_reader_elems (const _fit_reader_mesg *mesg, FIT_UINT8 field_num) {
+   const FIT_FIELD_DEF *field;
+   const _num_type *t;
+
+   if ((fit_reader_field(mesg, field_num, &field) == NULL) || ((t = get_num_type(field->base_type)) == NULL))
+      return 0;
+   return field->size / t->t_size;
+}
+
+// element bits and numeric type of field, NULL if it has no valid value
+static const _num_type *field_elem (const _fit_reader_mesg *mesg, FIT_UINT8 field_num, uint32_t elem, uint64_t *bits) {
+   const FIT_FIELD_DEF *field;
+   const uint8_t *v;
+   const _num_type *t;
+
+   if (((v = fit_reader_field(mesg, field_num, &field)) == NULL) || ((t = get_num_type(field->base_type)) == NULL) ||
+       ((elem + 1) * t->t_size > field->size))
+      return NULL;
+   *bits = elem_bits(v + elem * t->t_size, t->t_size, mesg->type->arch);
+   return (*bits == t->invalid) ? NULL : t;
+}
+
+bool fit_reader_uint (const _fit_reader_mesg *mesg, FIT_UINT8 field_num, uint32_t elem, uint64_t *v) {
+   const _num_type *t;
+   uint64_t bits;
+
+   if (((t = field_elem(mesg, field_num, elem, &bits)) == NULL) || (t->kind != KIND_UNSIGNED))
+      return false;
+   *v = bits;
+   return true;
+}
+
+bool fit_reader_sint (const _fit_reader_mesg *mesg, FIT_UINT8 field_num, uint32_t elem, int64_t *v) {
+   const _num_type *t;
+   uint64_t bits;
+
+   if ((t = field_elem(mesg, field_num, elem, &bits)) == NULL)
+      return false;
+   if (t->kind == KIND_SIGNED) {
+      // sign extend
+      if ((t->t_size < sizeof(bits)) && (bits & (1ULL << (t->t_size * 8 - 1))))
+         bits |= ~0ULL << (t->t_size * 8);
+      *v = (int64_t)bits;
+   }
+   else if ((t->kind == KIND_UNSIGNED) && (bits <= INT64_MAX))
+      *v = bits;
+   else
+      return false;
+   return true;
+}
+
+// any numeric field as double. NaN and infinite floats are not valid values
+bool fit_reader_float (const _fit_reader_mesg *mesg, FIT_UINT8 field_num, uint32_t elem, double *v) {
+   const _num_type *t;
+   uint64_t bits;
+   uint32_t bits32;
+   float f;
+   int64_t s;
+
+   if ((t = field_elem(mesg, field_num, elem, &bits)) == NULL)
+      return false;
+   if (t->kind == KIND_FLOAT) {
+      if (t->t_size == sizeof(float)) {
+         bits32 = bits;
+         memcpy(&f, &bits32, sizeof(f));
+         *v = f;
+      }
+      else
+         memcpy(v, &bits, sizeof(*v));
+      return (*v == *v) && (*v - *v == 0);
+   }
+   if ((t->kind == KIND_SIGNED) && fit_reader_sint(mesg, field_num, elem, &s))
+      *v = s;
+   else
+      *v = bits;
+   return true;
+}
+
+// string field, not 0 terminated if it fills the field. NULL if field is not a string or it is empty
+const char *fit_reader_string (const _fit_reader_mesg *mesg, FIT_UINT8 field_num, uint32_t *len) {
+   const FIT_FIELD_DEF *field;
+   const uint8_t *v;
+
+   if (((v = fit_reader_field(mesg, field_num, &field)) == NULL) || (field->base_type != FIT_FIT_BASE_TYPE_STRING) || (v[0] == 0))
+      return NULL;
+   *len = strnlen((const char *)v, field->size);
+   return (const char *)v;
+}
+
+// developer field bytes in data record, NULL if field is not in record
+const uint8_t *fit_reader_dev_field (const _fit_reader_mesg *mesg, FIT_UINT8 dev_index, FIT_UINT8 field_num, uint8_t *size) {
+   int32_t i;
+
+   for (i = 0; i < mesg->type->num_dev_fields; i++) {
+      if ((mesg->type->dev_fields[i].dev_index == dev_index) && (mesg->type->dev_fields[i].def_num == field_num)) {
+         *size = mesg->type->dev_fields[i].size;
+         return mesg->data + mesg->fields->dev_offset[i];
+      }
+   }
+   return NULL;
+}
@@ -0,0 +1,67 @@
+#ifndef FIT_READER_
+#define FIT_READER_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <fit_scan.h>
+
+#define FIT_READER_NO_FIELD      0xFF           // field is not in definition
+
+// fields of local message type: index in definition and offset in data record
+typedef struct {
+   uint8_t index[UINT8_MAX+1];                  // field index by field number, FIT_READER_NO_FIELD if not defined
+   uint16_t offset[UINT8_MAX+1];                // data offset by field index
+   uint16_t dev_offset[UINT8_MAX+1];            // data offset by developer field index
+} _fit_reader_fields;
+
+// definition record view, valid during the callback only
+typedef struct {
+   uint32_t offset;                             // record offset in file
+   uint8_t mesg_type;                           // local message type
+   const _fit_scan_type *type;                  // global message number, architecture, fields and developer fields
+   const uint8_t *rec;                          // record content (after record header), points into file
+   uint32_t len;                                // content length
+} _fit_reader_def;
+
+// data record view, valid during the callback only
+typedef struct {
+   uint32_t offset;                             // record offset in file
+   uint8_t mesg_type;                           // local message type
+   const _fit_scan_type *type;                  // global message number, architecture, fields and developer fields
+   const uint8_t *data;                         // record content (after record header), points into file
+   uint32_t len;                                // content length
+   FIT_UINT32 timestamp;                        // timestamp field, or time of compressed timestamp header, FIT_UINT32_INVALID if none
+   bool compressed_ts;                          // record has compressed timestamp header
+   const _fit_reader_fields *fields;
+} _fit_reader_mesg;
+
+// callbacks return 0 to go on reading, other values stop reading
+typedef int32_t (*_fit_reader_def_cb) (void *ctx, const _fit_reader_def *def);
+typedef int32_t (*_fit_reader_mesg_cb) (void *ctx, const _fit_reader_mesg *mesg);
+
+typedef struct {
+   _fit_scan scan;
+   _fit_reader_def_cb on_def;                   // NULL if definitions are not needed
+   _fit_reader_mesg_cb on_mesg;
+   void *ctx;
+   _fit_reader_fields fields[FIT_HDR_TYPE_MASK+1];
+   FIT_UINT32 last_ts;
+   bool last_ts_valid;
+} _fit_reader;
+
+void fit_reader_init (_fit_reader *reader, _fit_reader_def_cb on_def, _fit_reader_mesg_cb on_mesg, void *ctx);
+int32_t fit_reader_read (_fit_reader *reader, const uint8_t *file, size_t file_size);
+
+// typed accessors of data record fields. elem is array element index (0 for single value fields).
+// numeric accessors return false if field is not in record, is not of numeric base type or its value is invalid
+const uint8_t *fit_reader_field (const _fit_reader_mesg *mesg, FIT_UINT8 field_num, const FIT_FIELD_DEF **field);
+uint32_t fit_reader_elems (const _fit_reader_mesg *mesg, FIT_UINT8 field_num);
+bool fit_reader_uint (const _fit_reader_mesg *mesg, FIT_UINT8 field_num, uint32_t elem, uint64_t *v);
+bool fit_reader_sint (const _fit_reader_mesg *mesg, FIT_UINT8 field_num, uint32_t elem, int64_t *v);
+bool fit_reader_float (const _fit_reader_mesg *mesg, FIT_UINT8 field_num, uint32_t elem, double *v);
+const char *fit_reader_string (const _fit_reader_mesg *mesg, FIT_UINT8 field_num, uint32_t *len);
+const uint8_t *fit_reader_dev_field (const _fit_reader_mesg *mesg, FIT_UINT8 dev_index, FIT_UINT8 field_num, uint8_t *size);
+
+#endif // FIT_READER_
@@ -0,0 +1,206 @@
+/*
+
+   This code uses GARMIN FIT SDK V21.141.00 (https://developer.garmin.com/downloads/fit/sdk/FitSDKRelease_21.141.00.zip)
+   Under the Flexible and Interoperable Data Transfer (FIT) Protocol License:
+   (https://www.thisisant.com/developer/ant/licensing/flexible-and-interoperable-data-transfer-fit-protocol-license).
+
+	Walk FIT file records framing in memory, without decoding fields values.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include <fit_example.h>
+#include <fit_crc.h>
+
+#include <fit_crc16.h>
+#include <fit_scan.h>
+
+#define FIT_MIN_HDR_SIZE      12          // old FIT files header has no CRC
+#define DEF_FIXED_SIZE        5           // reserved, arch, global message number, number of fields
+
+static const char *scan_err_str[FIT_SCAN_ERR_COUNT] = {
+   "ok",
+   "file is shorter than FIT header",
+   "not a FIT file",
+   "file header CRC check failed",
+   "file is shorter than header data size",
+   "record crosses end of data",
+   "data record with undefined message type",
+   "file CRC check failed"
+};
+
+const char *fit_scan_error_str (_fit_scan_err error) {
+   if (error >= FIT_SCAN_ERR_COUNT)
+      return "unknown error";
+   return scan_err_str[error];
+}
+
+static int32_t scan_error (_fit_scan *scan, _fit_scan_err error, uint32_t offset) {
+   scan->error = error;
+   scan->err_offset = offset;
+   return -1;
+}
+
+// calculate file header CRC (file header must have CRC field)
+FIT_UINT16 fit_scan_hdr_crc (const _fit_scan *scan) {
+   return FitCRC_Calc16(scan->file, FIT_FILE_HDR_SIZE-2);
+}
+
+// calculate file CRC over file header and all records
+FIT_UINT16 fit_scan_file_crc (const _fit_scan *scan) {
+   return fit_crc16_update(0, scan->file, scan->data_end);
+}
+
+// check file header size and signature and prepare to walk records
+// return 0 on success, -1 on error (scan->error is set)
+int32_t fit_scan_open (_fit_scan *scan, const uint8_t *file, size_t file_size) {
+   memset(scan, 0, sizeof(_fit_scan));
+   scan->file = file;
+   scan->file_size = file_size;
+
+   if ((file_size < FIT_MIN_HDR_SIZE) || (file[0] < FIT_MIN_HDR_SIZE) || (file_size < file[0]))
+      return scan_error(scan, FIT_SCAN_SHORT_HDR, 0);
+
+   scan->hdr_size = file[0];
+   memcpy(&scan->hdr, file, (scan->hdr_size < FIT_FILE_HDR_SIZE) ? scan->hdr_size : FIT_FILE_HDR_SIZE);
+
+   if (memcmp(scan->hdr.data_type, ".FIT", 4) != 0)
+      return scan_error(scan, FIT_SCAN_NOT_FIT, 8);
+
+   // data must be followed by 2 bytes file CRC
+   if ((uint64_t)scan->hdr_size + scan->hdr.data_size + sizeof(FIT_UINT16) > file_size)
+      return scan_error(scan, FIT_SCAN_TRUNCATED, file_size);
+
+   scan->data_end = scan->hdr_size + scan->hdr.data_size;
+   scan->pos = scan->hdr_size;
+
+   return 0;
+}
+
+// set local message type from definition record
+// return definition record length, 0 if record crosses end of data
+static uint32_t scan_def (_fit_scan *scan, uint8_t rec_hdr, const uint8_t *p, uint32_t avail) {
+   _fit_scan_type *type = &scan->types[rec_hdr & FIT_HDR_TYPE_MASK];
+   uint32_t len = DEF_FIXED_SIZE;
+   uint32_t i;
+
+   if (len > avail)
+      return 0;
+
+   type->num_fields = p[4];
+   len += type->num_fields * sizeof(FIT_FIELD_DEF);
+   type->num_dev_fields = 0;
+   if (rec_hdr & FIT_HDR_DEV_DATA_BIT) {
+      if (len + 1 > avail)
+         return 0;
+      type->num_dev_fields = p[len];
+      len += 1 + type->num_dev_fields * sizeof(FIT_DEV_FIELD_DEF);
+   }
+   if (len > avail)
+      return 0;
+
+   type->def = p;
+   type->arch = p[1];
+   type->global_mesg_num = type->arch ? (p[2] << 8) | p[3] : p[2] | (p[3] << 8);
+   type->fields = (const FIT_FIELD_DEF *)(p + DEF_FIXED_SIZE);
+   type->dev_fields = (const FIT_DEV_FIELD_DEF *)(p + DEF_FIXED_SIZE + type->num_fields * sizeof(FIT_FIELD_DEF) + 1);
+
+   type->data_mesg_len = 0;
+   for (i = 0; i < type->num_fields; i++)
+      type->data_mesg_len += type->fields[i].size;
+   for (i = 0; i < type->num_dev_fields; i++)
+      type->data_mesg_len += type->dev_fields[i].size;
+
+   return len;
+}
+
+// walk to next record
+// return 1 if record was found, 0 at end of data and -1 on error (scan->error is set)
+int32_t fit_scan_next (_fit_scan *scan, _fit_scan_rec *rec) {
+   const uint8_t *p;
+   uint32_t avail;
+   uint32_t len;
+
+   if (scan->error != FIT_SCAN_OK)
+      return -1;
+   if (scan->pos >= scan->data_end)
+      return 0;
+
+   p = scan->file + scan->pos;
+   avail = scan->data_end - scan->pos - 1;
+
+   rec->offset = scan->pos;
+   rec->rec_hdr = *p++;
+   rec->data = p;
+
+   if ((rec->rec_hdr & (FIT_HDR_TIME_REC_BIT | FIT_HDR_TYPE_DEF_BIT)) == FIT_HDR_TYPE_DEF_BIT) {
+      if ((len = scan_def(scan, rec->rec_hdr, p, avail)) == 0)
+         return scan_error(scan, FIT_SCAN_BAD_RECORD, rec->offset);
+      rec->def = true;
+      rec->mesg_type = rec->rec_hdr & FIT_HDR_TYPE_MASK;
+   }
+   else {
+      // check if Compressed Timestamp Header. If it does get mesg_type accordingly
+      if (rec->rec_hdr & FIT_HDR_TIME_REC_BIT)
+         rec->mesg_type = (rec->rec_hdr & FIT_HDR_TIME_TYPE_MASK) >> FIT_HDR_TIME_TYPE_SHIFT;
+      else
+         rec->mesg_type = rec->rec_hdr & FIT_HDR_TYPE_MASK;
+
+      if (scan->types[rec->mesg_type].def == NULL)
+         return scan_error(scan, FIT_SCAN_UNDEF_TYPE, rec->offset);
+
+      len = scan->types[rec->mesg_type].data_mesg_len;
+      if (len > avail)
+         return scan_error(scan, FIT_SCAN_BAD_RECORD, rec->offset);
+      rec->def = false;
+   }
+
+   rec->type = &scan->types[rec->mesg_type];
+   rec->len = len + 1;
+   scan->pos += rec->len;
+   scan->records++;
+
+   return 1;
+}
+
+// check file header CRC
+// return 0 on success, -1 on error (scan->error is set)
+int32_t fit_scan_check_hdr_crc (_fit_scan *scan) {
+   if (scan->error != FIT_SCAN_OK)
+      return -1;
+
+   // header CRC is optional, 0 means it was not set
+   if ((scan->hdr_size >= FIT_FILE_HDR_SIZE) && (scan->hdr.crc != 0) && (fit_scan_hdr_crc(scan) != scan->hdr.crc))
+      return scan_error(scan, FIT_SCAN_HDR_CRC, FIT_FILE_HDR_SIZE-2);
+
+   return 0;
+}
+
+// check file CRC. records framing is not checked
+// return 0 on success, -1 on error (scan->error is set)
+int32_t fit_scan_check_crc (_fit_scan *scan) {
+   FIT_UINT16 file_crc;
+
+   if (scan->error != FIT_SCAN_OK)
+      return -1;
+
+   memcpy(&file_crc, scan->file + scan->data_end, sizeof(file_crc));
+   if (fit_scan_file_crc(scan) != file_crc)
+      return scan_error(scan, FIT_SCAN_FILE_CRC, scan->data_end);
+
+   return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef FIT_SCAN_
+#define FIT_SCAN_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// scan errors
+typedef enum {
+   FIT_SCAN_OK = 0,
+   FIT_SCAN_SHORT_HDR,           // file is shorter than FIT file header
+   FIT_SCAN_NOT_FIT,             // missing ".FIT" signature
+   FIT_SCAN_HDR_CRC,             // file header CRC check failed
+   FIT_SCAN_TRUNCATED,           // file is shorter than header data size + CRC
+   FIT_SCAN_BAD_RECORD,          // record crosses end of data
+   FIT_SCAN_UNDEF_TYPE,          // data record of undefined local message type
+   FIT_SCAN_FILE_CRC,            // file CRC check failed
+   FIT_SCAN_ERR_COUNT
+} _fit_scan_err;
+
+// local message type definition, points into scanned file
+typedef struct {
+   const uint8_t *def;           // definition record content (after record header), NULL if not defined
+   FIT_UINT16 global_mesg_num;
+   FIT_UINT8 arch;
+   FIT_UINT8 num_fields;
+   FIT_UINT8 num_dev_fields;
+   const FIT_FIELD_DEF *fields;
+   const FIT_DEV_FIELD_DEF *dev_fields;
+   uint16_t data_mesg_len;
+} _fit_scan_type;
+
+// one record
+typedef struct {
+   uint32_t offset;              // offset of record header in file
+   uint32_t len;                 // record length including record header
+   uint8_t rec_hdr;
+   uint8_t mesg_type;            // local message type
+   bool def;                     // definition record
+   const _fit_scan_type *type;   // local message type definition
+   const uint8_t *data;          // record content (after record header)
+} _fit_scan_rec;
+
+// scanner state
+typedef struct {
+   const uint8_t *file;
+   size_t file_size;
+   FIT_FILE_HDR hdr;
+   uint32_t hdr_size;
+   uint32_t data_end;            // offset of file CRC
+   uint32_t pos;                 // offset of next record
+   uint32_t records;             // records walked so far
+   _fit_scan_err error;
+   uint32_t err_offset;          // file offset where error was found
+   _fit_scan_type types[FIT_HDR_TYPE_MASK+1];
+} _fit_scan;
+
+int32_t fit_scan_open (_fit_scan *scan, const uint8_t *file, size_t file_size);
+int32_t fit_scan_next (_fit_scan *scan, _fit_scan_rec *rec);
+int32_t fit_scan_check_hdr_crc (_fit_scan *scan);
+int32_t fit_scan_check_crc (_fit_scan *scan);
+FIT_UINT16 fit_scan_hdr_crc (const _fit_scan *scan);
+FIT_UINT16 fit_scan_file_crc (const _fit_scan *scan);
+const char *fit_scan_error_str (_fit_scan_err error);
+
+#endif // FIT_SCAN_
@@ -0,0 +1,459 @@
+/*
+
+   This code uses GARMIN FIT SDK V21.141.00 (https://developer.garmin.com/downloads/fit/sdk/FitSDKRelease_21.141.00.zip)
+   Under the Flexible and Interoperable Data Transfer (FIT) Protocol License:
+   (https://www.thisisant.com/developer/ant/licensing/flexible-and-interoperable-data-transfer-fit-protocol-license).
+
+	Per field statistics of FIT files, accumulated from scanned records bytes.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <fit_example.h>
+
+#include <fit_scan.h>
+#include <fit_stats.h>
+
+#define STATS_TABLE_MIN_SIZE  256         // hash table size, power of 2
+#define HIST_ZERO             64          // index of histogram bucket 0
+#define TIMESTAMP_FIELD       253         // timestamp field number, same in all messages
+
+typedef struct {
+   FIT_FIT_BASE_TYPE base_type;
+   _fit_stats_kind kind;
+   uint8_t t_size;
+   uint64_t invalid;
+} _stats_type;
+
+// fields of other base types are counted as bytes
+static const _stats_type stats_types[] = {
+   {FIT_FIT_BASE_TYPE_ENUM, FIT_STATS_UNSIGNED, sizeof(uint8_t), FIT_ENUM_INVALID},
+   {FIT_FIT_BASE_TYPE_SINT8, FIT_STATS_SIGNED, sizeof(int8_t), (uint8_t)FIT_SINT8_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT8, FIT_STATS_UNSIGNED, sizeof(uint8_t), FIT_UINT8_INVALID},
+   {FIT_FIT_BASE_TYPE_SINT16, FIT_STATS_SIGNED, sizeof(int16_t), (uint16_t)FIT_SINT16_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT16, FIT_STATS_UNSIGNED, sizeof(uint16_t), FIT_UINT16_INVALID},
+   {FIT_FIT_BASE_TYPE_SINT32, FIT_STATS_SIGNED, sizeof(int32_t), (uint32_t)FIT_SINT32_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT32, FIT_STATS_UNSIGNED, sizeof(uint32_t), FIT_UINT32_INVALID},
+   {FIT_FIT_BASE_TYPE_STRING, FIT_STATS_STRING, sizeof(uint8_t), 0},
+   {FIT_FIT_BASE_TYPE_FLOAT32, FIT_STATS_FLOAT, sizeof(float), UINT32_MAX},
+   {FIT_FIT_BASE_TYPE_FLOAT64, FIT_STATS_FLOAT, sizeof(double), UINT64_MAX},
+   {FIT_FIT_BASE_TYPE_UINT8Z, FIT_STATS_UNSIGNED, sizeof(uint8_t), FIT_UINT8Z_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT16Z, FIT_STATS_UNSIGNED, sizeof(uint16_t), FIT_UINT16Z_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT32Z, FIT_STATS_UNSIGNED, sizeof(uint32_t), FIT_UINT32Z_INVALID},
+   {FIT_FIT_BASE_TYPE_BYTE, FIT_STATS_UNSIGNED, sizeof(uint8_t), FIT_BYTE_INVALID},
+   {FIT_FIT_BASE_TYPE_SINT64, FIT_STATS_SIGNED, sizeof(int64_t), (uint64_t)FIT_SINT64_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT64, FIT_STATS_UNSIGNED, sizeof(uint64_t), FIT_UINT64_INVALID},
+   {FIT_FIT_BASE_TYPE_UINT64Z, FIT_STATS_UNSIGNED, sizeof(uint64_t), FIT_UINT64Z_INVALID}
+};
+
+static const _stats_type bytes_type = {FIT_FIT_BASE_TYPE_BYTE, FIT_STATS_UNSIGNED, sizeof(uint8_t), FIT_BYTE_INVALID};
+
+static const _stats_type *get_stats_type (FIT_UINT8 base_type, uint8_t size) {
+   int32_t t;
+
+   for (t = 0; t < sizeof(stats_types)/sizeof(stats_types[0]); t++) {
+      if (stats_types[t].base_type == base_type)
+         return (size % stats_types[t].t_size == 0) ? &stats_types[t] : &bytes_type;
+   }
+   return &bytes_type;
+}
+
+/*******************************************************************/
+/* accumulators table, one entry for each                          */
+/* (global message, field number, base type)                       */
+/*******************************************************************/
+
+static inline uint32_t stats_key (FIT_UINT16 global_mesg_num, FIT_UINT8 field_num, FIT_UINT8 base_type) {
+   return ((uint32_t)global_mesg_num << 16) | (field_num << 8) | base_type;
+}
+
+static inline uint32_t acc_key (const _fit_field_stats *acc) {
+   return stats_key(acc->global_mesg_num, acc->field_num, acc->base_type);
+}
+
+static inline uint32_t stats_hash (uint32_t key, uint32_t table_size) {
+   return (key * 2654435761U) & (table_size - 1);
+}
+
+void fit_stats_init (_fit_stats *stats) {
+   memset(stats, 0, sizeof(_fit_stats));
+}
+
+// compressed timestamps of a new file do not follow the last timestamp of the previous one
+void fit_stats_start_file (_fit_stats *stats) {
+   stats->last_ts_valid = false;
+}
+
+// double hash table size. return 0 on success, -1 on error
+static int32_t grow_table (_fit_stats *stats) {
+   uint32_t size = stats->table_size ? stats->table_size * 2 : STATS_TABLE_MIN_SIZE;
+   _fit_field_stats **table;
+   uint32_t i, h;
+
+   if ((table = calloc(size, sizeof(_fit_field_stats *))) == NULL)
+      return -1;
+
+   for (i = 0; i < stats->table_size; i++) {
+      if (stats->table[i] == NULL)
+         continue;
+      for (h = stats_hash(acc_key(stats->table[i]), size); table[h] != NULL; h = (h + 1) & (size - 1))
+         ;
+      table[h] = stats->table[i];
+   }
+
+   free(stats->table);
+   stats->table = table;
+   stats->table_size = size;
+   return 0;
+}
+
+// find field accumulator, add it if it is new. return NULL on error
+static _fit_field_stats *get_acc (_fit_stats *stats, FIT_UINT16 global_mesg_num, FIT_UINT8 field_num, FIT_UINT8 base_type, _fit_stats_kind kind) {
+   uint32_t key = stats_key(global_mesg_num, field_num, base_type);
+   _fit_field_stats *acc;
+   uint32_t h;
+
+   if ((stats->num_fields + 1) * 2 > stats->table_size) {
+      if (grow_table(stats) != 0)
+         return NULL;
+   }
+
+   for (h = stats_hash(key, stats->table_size); stats->table[h] != NULL; h = (h + 1) & (stats->table_size - 1)) {
+      if (acc_key(stats->table[h]) == key)
+         return stats->table[h];
+   }
+
+   if ((acc = calloc(1, sizeof(_fit_field_stats))) == NULL)
+      return NULL;
+   acc->global_mesg_num = global_mesg_num;
+   acc->field_num = field_num;
+   acc->base_type = base_type;
+   acc->kind = kind;
+   switch (kind) {
+      case FIT_STATS_SIGNED:
+         acc->min.i = INT64_MAX;
+         acc->max.i = INT64_MIN;
+         break;
+      case FIT_STATS_UNSIGNED:
+         acc->min.u = UINT64_MAX;
+         acc->max.u = 0;
+         break;
+      default:
+         acc->min.f = INFINITY;
+         acc->max.f = -INFINITY;
+   }
+
+   stats->table[h] = acc;
+   stats->num_fields++;
+   return acc;
+}
+
+/*******************************************************************/
+/* accumulate batch of records                                     */
+/* a batch holds contiguous data records of one local message type */
+/* so each field is accumulated over all records with one loop of  */
+/* its element type, with no type dispatch inside the loop.        */
+/*******************************************************************/
+
+static inline int32_t uint_bucket (uint64_t v) {
+   return v ? HIST_ZERO + 64 - __builtin_clzll(v) : HIST_ZERO;
+}
+
+static inline int32_t sint_bucket (int64_t v) {
+   return (v < 0) ? HIST_ZERO - (64 - __builtin_clzll(0 - (uint64_t)v)) : uint_bucket(v);
+}
+
+// bucket of |v| >= 1 is its binary exponent + 1, taken from the double bits
+static inline int32_t float_bucket (double v) {
+   uint64_t bits;
+   int32_t k;
+
+   if ((v > -1.0) && (v < 1.0))
+      return HIST_ZERO;
+   memcpy(&bits, &v, sizeof(bits));
+   k = (int32_t)((bits >> 52) & 0x7FF) - 1023 + 1;
+   if (k > 64)
+      k = 64;
+   return (v < 0) ? HIST_ZERO - k : HIST_ZERO + k;
+}
+
+// accumulate one field of all batch records. invalid value bits are the low bytes of f->invalid
+#define ACCUMULATE(name, ctype, m, bucket, skip)                                          \
+static void name (_fit_field_stats *acc, const uint8_t **batch, uint32_t n, const _fit_stats_field *f) { \
+   ctype invalid_value;                                                                   \
+   __typeof__(acc->min.m) min = acc->min.m;                                               \
+   __typeof__(acc->max.m) max = acc->max.m;                                               \
+   double sum = 0;                                                                        \
+   uint64_t invalid = 0;                                                                  \
+   uint64_t total = 0;                                                                    \
+   uint32_t r, e;                                                                         \
+   ctype v;                                                                               \
+                                                                                          \
+   memcpy(&invalid_value, &f->invalid, sizeof(invalid_value));                           \
+   for (r = 0; r < n; r++) {                                                              \
+      const uint8_t *p = batch[r] + f->offset;                                            \
+      for (e = 0; e < f->size; e += sizeof(ctype)) {                                      \
+         memcpy(&v, p + e, sizeof(v));                                                    \
+         total++;                                                                         \
+         if ((memcmp(&v, &invalid_value, sizeof(v)) == 0) || skip) {                      \
+            invalid++;                                                                    \
+            continue;                                                                     \
+         }                                                                                \
+         if (v < min)                                                                     \
+            min = v;                                                                      \
+         if (v > max)                                                                     \
+            max = v;                                                                      \
+         sum += v;                                                                        \
+         acc->hist[bucket(v)]++;                                                          \
+      }                                                                                   \
+   }                                                                                      \
+                                                                                          \
+   acc->min.m = min;                                                                      \
+   acc->max.m = max;                                                                      \
+   acc->sum += sum;                                                                       \
+   acc->count += total - invalid;                                                         \
+   acc->invalid += invalid;                                                               \
+}
+
+// NaN values are counted as invalid
+ACCUMULATE(accumulate_int8, int8_t, i, sint_bucket, false)
+ACCUMULATE(accumulate_int16, int16_t, i, sint_bucket, false)
+ACCUMULATE(accumulate_int32, int32_t, i, sint_bucket, false)
+ACCUMULATE(accumulate_int64, int64_t, i, sint_bucket, false)
+ACCUMULATE(accumulate_uint8, uint8_t, u, uint_bucket, false)
+ACCUMULATE(accumulate_uint16, uint16_t, u, uint_bucket, false)
+ACCUMULATE(accumulate_uint32, uint32_t, u, uint_bucket, false)
+ACCUMULATE(accumulate_uint64, uint64_t, u, uint_bucket, false)
+ACCUMULATE(accumulate_float32, float, f, float_bucket, isnan(v))
+ACCUMULATE(accumulate_float64, double, f, float_bucket, isnan(v))
+
+// strings are only counted, empty strings are invalid
+static void accumulate_string (_fit_field_stats *acc, const uint8_t **batch, uint32_t n, const _fit_stats_field *f) {
+   uint32_t r;
+
+   for (r = 0; r < n; r++) {
+      if (batch[r][f->offset] == 0)
+         acc->invalid++;
+      else
+         acc->count++;
+   }
+}
+
+// accumulate decoded time of compressed timestamp record as its timestamp field value
+static void accumulate_time (_fit_field_stats *acc, FIT_UINT32 ts) {
+   if (ts < acc->min.u)
+      acc->min.u = ts;
+   if (ts > acc->max.u)
+      acc->max.u = ts;
+   acc->sum += ts;
+   acc->count++;
+   acc->hist[uint_bucket(ts)]++;
+}
+
+// accumulate batch records, all fields
+void fit_stats_flush (_fit_stats *stats) {
+   const _fit_stats_field *f;
+   uint32_t i;
+
+   if (stats->batch_len == 0)
+      return;
+
+   for (i = 0; i < stats->type_fields[stats->batch_type]; i++) {
+      f = &stats->types[stats->batch_type][i];
+      switch (f->acc->kind) {
+         case FIT_STATS_SIGNED:
+            switch (f->t_size) {
+               case 1: accumulate_int8(f->acc, stats->batch, stats->batch_len, f); break;
+               case 2: accumulate_int16(f->acc, stats->batch, stats->batch_len, f); break;
+               case 4: accumulate_int32(f->acc, stats->batch, stats->batch_len, f); break;
+               default: accumulate_int64(f->acc, stats->batch, stats->batch_len, f);
+            }
+            break;
+         case FIT_STATS_UNSIGNED:
+            switch (f->t_size) {
+               case 1: accumulate_uint8(f->acc, stats->batch, stats->batch_len, f); break;
+               case 2: accumulate_uint16(f->acc, stats->batch, stats->batch_len, f); break;
+               case 4: accumulate_uint32(f->acc, stats->batch, stats->batch_len, f); break;
+               default: accumulate_uint64(f->acc, stats->batch, stats->batch_len, f);
+            }
+            break;
+         case FIT_STATS_FLOAT:
+            if (f->t_size == sizeof(float))
+               accumulate_float32(f->acc, stats->batch, stats->batch_len, f);
+            else
+               accumulate_float64(f->acc, stats->batch, stats->batch_len, f);
+            break;
+         default:
+            accumulate_string(f->acc, stats->batch, stats->batch_len, f);
+      }
+   }
+
+   stats->batch_len = 0;
+}
+
+// set fields of local message type from definition record. developer fields are not counted
+// return 0 on success, -1 on error
+static int32_t set_type (_fit_stats *stats, const _fit_scan_rec *rec) {
+   const _fit_scan_type *type = rec->type;
+   const _stats_type *t;
+   _fit_stats_field *f;
+   uint16_t offset = 0;
+   uint32_t i;
+
+   // number of fields is one byte
+   if ((stats->types[rec->mesg_type] == NULL) && ((stats->types[rec->mesg_type] = malloc((UINT8_MAX + 1) * sizeof(_fit_stats_field))) == NULL))
+      return -1;
+
+   stats->type_fields[rec->mesg_type] = 0;
+   stats->ts_offset[rec->mesg_type] = -1;
+   for (i = 0; i < type->num_fields; offset += type->fields[i].size, i++) {
+      if ((type->fields[i].field_def_num == TIMESTAMP_FIELD) && (type->fields[i].size == sizeof(FIT_UINT32)))
+         stats->ts_offset[rec->mesg_type] = offset;
+      if (type->fields[i].size == 0)
+         continue;
+      t = get_stats_type(type->fields[i].base_type, type->fields[i].size);
+      f = &stats->types[rec->mesg_type][stats->type_fields[rec->mesg_type]];
+      if ((f->acc = get_acc(stats, type->global_mesg_num, type->fields[i].field_def_num, type->fields[i].base_type, t->kind)) == NULL)
+         return -1;
+      f->offset = offset;
+      f->size = type->fields[i].size;
+      f->t_size = t->t_size;
+      f->invalid = t->invalid;
+      stats->type_fields[rec->mesg_type]++;
+   }
+   stats->ts_acc[rec->mesg_type] = NULL;
+   return 0;
+}
+
+// track timestamp the way FIT reader does, compressed timestamp is the time offset from the last timestamp.
+// time of compressed timestamp record is counted as its timestamp field, unless it has one
+// return 0 on success, -1 on error
+static int32_t add_time (_fit_stats *stats, const _fit_scan_rec *rec) {
+   _fit_field_stats **acc = &stats->ts_acc[rec->mesg_type];
+   FIT_UINT32 ts;
+
+   if (rec->rec_hdr & FIT_HDR_TIME_REC_BIT) {
+      if (!stats->last_ts_valid)
+         return 0;
+      ts = stats->last_ts;
+      if ((rec->rec_hdr & FIT_HDR_TIME_OFFSET_MASK) < (ts & FIT_HDR_TIME_OFFSET_MASK))
+         ts += FIT_HDR_TIME_OFFSET_MASK + 1;
+      ts = (ts & ~FIT_HDR_TIME_OFFSET_MASK) | (rec->rec_hdr & FIT_HDR_TIME_OFFSET_MASK);
+      if (stats->ts_offset[rec->mesg_type] < 0) {
+         if ((*acc == NULL) && ((*acc = get_acc(stats, rec->type->global_mesg_num, TIMESTAMP_FIELD, FIT_FIT_BASE_TYPE_UINT32, FIT_STATS_UNSIGNED)) == NULL))
+            return -1;
+         accumulate_time(*acc, ts);
+      }
+   }
+   else if (stats->ts_offset[rec->mesg_type] >= 0) {
+      memcpy(&ts, rec->data + stats->ts_offset[rec->mesg_type], sizeof(ts));
+      if (ts == FIT_UINT32_INVALID)
+         return 0;
+   }
+   else
+      return 0;
+   stats->last_ts = ts;
+   stats->last_ts_valid = true;
+   return 0;
+}
+
+// add scanned record. records content must stay in memory until fit_stats_flush() is called
+// return 0 on success, -1 on error
+int32_t fit_stats_add (_fit_stats *stats, const _fit_scan_rec *rec) {
+   if (rec->def) {
+      fit_stats_flush(stats);
+      return set_type(stats, rec);
+   }
+
+   if ((stats->batch_len > 0) && ((stats->batch_type != rec->mesg_type) || (stats->batch_len == FIT_STATS_BATCH)))
+      fit_stats_flush(stats);
+   stats->batch_type = rec->mesg_type;
+   stats->batch[stats->batch_len++] = rec->data;
+   return add_time(stats, rec);
+}
+
+// add accumulators of src to dst
+// return 0 on success, -1 on error
+int32_t fit_stats_merge (_fit_stats *dst, const _fit_stats *src) {
+   const _fit_field_stats *s;
+   _fit_field_stats *d;
+   uint32_t i, b;
+
+   for (i = 0; i < src->table_size; i++) {
+      if ((s = src->table[i]) == NULL)
+         continue;
+      if ((d = get_acc(dst, s->global_mesg_num, s->field_num, s->base_type, s->kind)) == NULL)
+         return -1;
+
+      switch (s->kind) {
+         case FIT_STATS_SIGNED:
+            d->min.i = (s->min.i < d->min.i) ? s->min.i : d->min.i;
+            d->max.i = (s->max.i > d->max.i) ? s->max.i : d->max.i;
+            break;
+         case FIT_STATS_UNSIGNED:
+            d->min.u = (s->min.u < d->min.u) ? s->min.u : d->min.u;
+            d->max.u = (s->max.u > d->max.u) ? s->max.u : d->max.u;
+            break;
+         default:
+            d->min.f = (s->min.f < d->min.f) ? s->min.f : d->min.f;
+            d->max.f = (s->max.f > d->max.f) ? s->max.f : d->max.f;
+      }
+      d->count += s->count;
+      d->invalid += s->invalid;
+      d->sum += s->sum;
+      for (b = 0; b < FIT_STATS_HIST_BUCKETS; b++)
+         d->hist[b] += s->hist[b];
+   }
+   return 0;
+}
+
+static int compare_acc (const void *a, const void *b) {
+   uint32_t ka = acc_key(*(_fit_field_stats * const *)a);
+   uint32_t kb = acc_key(*(_fit_field_stats * const *)b);
+
+   return (ka > kb) - (ka < kb);
+}
+
+// return array of num_fields accumulators sorted by global message, field number and base type
+// the array should be freed by the caller. return NULL on error
+_fit_field_stats **fit_stats_sorted (const _fit_stats *stats) {
+   _fit_field_stats **sorted;
+   uint32_t i, n = 0;
+
+   if ((sorted = malloc((stats->num_fields + 1) * sizeof(_fit_field_stats *))) == NULL)
+      return NULL;
+
+   for (i = 0; i < stats->table_size; i++) {
+      if (stats->table[i] != NULL)
+         sorted[n++] = stats->table[i];
+   }
+   qsort(sorted, n, sizeof(_fit_field_stats *), compare_acc);
+   return sorted;
+}
+
+void fit_stats_free (_fit_stats *stats) {
+   uint32_t i;
+
+   for (i = 0; i < stats->table_size; i++)
+      free(stats->table[i]);
+   free(stats->table);
+   for (i = 0; i <= FIT_HDR_TYPE_MASK; i++)
+      free(stats->types[i]);
+   memset(stats, 0, sizeof(_fit_stats));
+}
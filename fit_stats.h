@@ -0,0 +1,70 @@
+#ifndef FIT_STATS_
+#define FIT_STATS_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FIT_STATS_HIST_BUCKETS   129         // bucket -64..64 is kept at index bucket+64
+#define FIT_STATS_BATCH          64          // data records of same local message type accumulated together
+
+// kind of field elements values
+typedef enum {
+   FIT_STATS_SIGNED = 0,
+   FIT_STATS_UNSIGNED,
+   FIT_STATS_FLOAT,
+   FIT_STATS_STRING
+} _fit_stats_kind;
+
+// running accumulators of one field of one global message.
+// histogram bucket k > 0 counts values in [2^(k-1), 2^k), bucket -k values in (-2^k, -2^(k-1)]
+// and bucket 0 values in (-1, 1)
+typedef struct {
+   FIT_UINT16 global_mesg_num;
+   FIT_UINT8 field_num;
+   FIT_UINT8 base_type;
+   _fit_stats_kind kind;
+   uint64_t count;                     // valid elements
+   uint64_t invalid;                   // elements with FIT invalid value (empty strings)
+   union {
+      int64_t i;
+      uint64_t u;
+      double f;
+   } min, max;
+   double sum;
+   uint64_t hist[FIT_STATS_HIST_BUCKETS];
+} _fit_field_stats;
+
+// field of local message type, set from definition record
+typedef struct {
+   _fit_field_stats *acc;
+   uint16_t offset;                    // offset of field value in data record content
+   uint8_t size;
+   uint8_t t_size;                     // element size
+   uint64_t invalid;                   // element invalid value bits
+} _fit_stats_field;
+
+// accumulators of one thread
+typedef struct {
+   _fit_field_stats **table;           // open addressing hash table of accumulators
+   uint32_t table_size;
+   uint32_t num_fields;
+   _fit_stats_field *types[FIT_HDR_TYPE_MASK+1]; // fields of local message types
+   uint8_t type_fields[FIT_HDR_TYPE_MASK+1];
+   int32_t ts_offset[FIT_HDR_TYPE_MASK+1];       // offset of timestamp field of local message types, -1 if none
+   _fit_field_stats *ts_acc[FIT_HDR_TYPE_MASK+1]; // timestamp accumulator of compressed timestamp records
+   FIT_UINT32 last_ts;                 // last timestamp of file, as FIT reader tracks it
+   bool last_ts_valid;
+   const uint8_t *batch[FIT_STATS_BATCH];        // contiguous data records of batch_type
+   uint32_t batch_len;
+   uint8_t batch_type;
+} _fit_stats;
+
+void fit_stats_init (_fit_stats *stats);
+void fit_stats_start_file (_fit_stats *stats);
+int32_t fit_stats_add (_fit_stats *stats, const _fit_scan_rec *rec);
+void fit_stats_flush (_fit_stats *stats);
+int32_t fit_stats_merge (_fit_stats *dst, const _fit_stats *src);
+_fit_field_stats **fit_stats_sorted (const _fit_stats *stats);
+void fit_stats_free (_fit_stats *stats);
+
+#endif // FIT_STATS_
@@ -21,9 +21,17 @@
    along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <stddef.h>
+
 #include <fit_example.h>
 
+#include <fit_titles.h>
+
 #define MESG_TITLES 66
+#define MESG_UNITS 12
+
+// FIT semicircles to degrees: 2^31 semicircles are 180 degrees
+#define SEMICIRCLES_PER_DEGREE (2147483648.0 / 180.0)
 
 static char *unknown = "unknown";
 
@@ -39,6 +47,12 @@ typedef struct {
 	char *mesg_title;
 } _mesg_titles;
 
+typedef struct {
+	FIT_MESG_NUM g_mesg_num;
+	FIT_UINT8 num_of_fields;
+	_field_units *fields;
+} _mesg_units;
+
 static _field_title file_id_mesg[FIT_FILE_ID_MESG_FIELDS] = {
 	{FIT_FILE_ID_FIELD_NUM_SERIAL_NUMBER, "SERIAL_NUMBER"},
 	{FIT_FILE_ID_FIELD_NUM_TIME_CREATED, "TIME_CREATED"},
@@ -529,7 +543,7 @@ static _field_title record_mesg[FIT_RECORD_MESG_FIELDS] = {
 	{FIT_RECORD_FIELD_NUM_CADENCE, "CADENCE"},
 	{FIT_RECORD_FIELD_NUM_COMPRESSED_SPEED_DISTANCE, "COMPRESSED_SPEED_DISTANCE"},
 	{FIT_RECORD_FIELD_NUM_RESISTANCE, "RESISTANCE"},
-	{FIT_RECORD_FIELD_NUM_TEMPERATURE, "TEMPERATURE,"},
+	{FIT_RECORD_FIELD_NUM_TEMPERATURE, "TEMPERATURE"},
 	{FIT_RECORD_FIELD_NUM_SPEED_1S, "SPEED_1S"},
 	{FIT_RECORD_FIELD_NUM_CYCLES, "CYCLES"},
 	{FIT_RECORD_FIELD_NUM_LEFT_RIGHT_BALANCE, "LEFT_RIGHT_BALANCE"},
@@ -1078,6 +1092,275 @@ static _mesg_titles mesg_titles[MESG_TITLES] = {
 	{FIT_MESG_NUM_HRV, FIT_HRV_MESG_FIELDS, hrv_mesg, "HRV"}
 };
 
+// fields scale, offset and units from FIT profile: value = stored value / scale - offset
+static _field_units user_profile_units[] = {
+	{FIT_USER_PROFILE_FIELD_NUM_WEIGHT, 10, 0, "kg"},
+	{FIT_USER_PROFILE_FIELD_NUM_USER_RUNNING_STEP_LENGTH, 1000, 0, "m"},
+	{FIT_USER_PROFILE_FIELD_NUM_USER_WALKING_STEP_LENGTH, 1000, 0, "m"},
+	{FIT_USER_PROFILE_FIELD_NUM_AGE, 1, 0, "years"},
+	{FIT_USER_PROFILE_FIELD_NUM_HEIGHT, 100, 0, "m"},
+	{FIT_USER_PROFILE_FIELD_NUM_RESTING_HEART_RATE, 1, 0, "bpm"},
+	{FIT_USER_PROFILE_FIELD_NUM_DEFAULT_MAX_RUNNING_HEART_RATE, 1, 0, "bpm"},
+	{FIT_USER_PROFILE_FIELD_NUM_DEFAULT_MAX_BIKING_HEART_RATE, 1, 0, "bpm"},
+	{FIT_USER_PROFILE_FIELD_NUM_DEFAULT_MAX_HEART_RATE, 1, 0, "bpm"}
+};
+
+static _field_units session_units[] = {
+	{FIT_SESSION_FIELD_NUM_START_POSITION_LAT, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_SESSION_FIELD_NUM_START_POSITION_LONG, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_SESSION_FIELD_NUM_TOTAL_ELAPSED_TIME, 1000, 0, "s"},
+	{FIT_SESSION_FIELD_NUM_TOTAL_TIMER_TIME, 1000, 0, "s"},
+	{FIT_SESSION_FIELD_NUM_TOTAL_DISTANCE, 100, 0, "m"},
+	{FIT_SESSION_FIELD_NUM_TOTAL_CYCLES, 1, 0, "cycles"},
+	{FIT_SESSION_FIELD_NUM_NEC_LAT, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_SESSION_FIELD_NUM_NEC_LONG, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_SESSION_FIELD_NUM_SWC_LAT, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_SESSION_FIELD_NUM_SWC_LONG, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_SESSION_FIELD_NUM_END_POSITION_LAT, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_SESSION_FIELD_NUM_END_POSITION_LONG, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_SESSION_FIELD_NUM_TOTAL_WORK, 1, 0, "J"},
+	{FIT_SESSION_FIELD_NUM_TOTAL_MOVING_TIME, 1000, 0, "s"},
+	{FIT_SESSION_FIELD_NUM_TIME_IN_HR_ZONE, 1000, 0, "s"},
+	{FIT_SESSION_FIELD_NUM_TIME_IN_SPEED_ZONE, 1000, 0, "s"},
+	{FIT_SESSION_FIELD_NUM_TIME_IN_CADENCE_ZONE, 1000, 0, "s"},
+	{FIT_SESSION_FIELD_NUM_TIME_IN_POWER_ZONE, 1000, 0, "s"},
+	{FIT_SESSION_FIELD_NUM_AVG_LAP_TIME, 1000, 0, "s"},
+	{FIT_SESSION_FIELD_NUM_ENHANCED_AVG_SPEED, 1000, 0, "m/s"},
+	{FIT_SESSION_FIELD_NUM_ENHANCED_MAX_SPEED, 1000, 0, "m/s"},
+	{FIT_SESSION_FIELD_NUM_ENHANCED_AVG_ALTITUDE, 5, 500, "m"},
+	{FIT_SESSION_FIELD_NUM_ENHANCED_MIN_ALTITUDE, 5, 500, "m"},
+	{FIT_SESSION_FIELD_NUM_ENHANCED_MAX_ALTITUDE, 5, 500, "m"},
+	{FIT_SESSION_FIELD_NUM_TOTAL_FAT_CALORIES, 1, 0, "kcal"},
+	{FIT_SESSION_FIELD_NUM_AVG_SPEED, 1000, 0, "m/s"},
+	{FIT_SESSION_FIELD_NUM_MAX_SPEED, 1000, 0, "m/s"},
+	{FIT_SESSION_FIELD_NUM_AVG_POWER, 1, 0, "watts"},
+	{FIT_SESSION_FIELD_NUM_MAX_POWER, 1, 0, "watts"},
+	{FIT_SESSION_FIELD_NUM_TOTAL_ASCENT, 1, 0, "m"},
+	{FIT_SESSION_FIELD_NUM_TOTAL_DESCENT, 1, 0, "m"},
+	{FIT_SESSION_FIELD_NUM_NORMALIZED_POWER, 1, 0, "watts"},
+	{FIT_SESSION_FIELD_NUM_TRAINING_STRESS_SCORE, 10, 0, "tss"},
+	{FIT_SESSION_FIELD_NUM_INTENSITY_FACTOR, 1000, 0, "if"},
+	{FIT_SESSION_FIELD_NUM_AVG_STROKE_DISTANCE, 100, 0, "m"},
+	{FIT_SESSION_FIELD_NUM_POOL_LENGTH, 100, 0, "m"},
+	{FIT_SESSION_FIELD_NUM_THRESHOLD_POWER, 1, 0, "watts"},
+	{FIT_SESSION_FIELD_NUM_AVG_ALTITUDE, 5, 500, "m"},
+	{FIT_SESSION_FIELD_NUM_MAX_ALTITUDE, 5, 500, "m"},
+	{FIT_SESSION_FIELD_NUM_AVG_GRADE, 100, 0, "%"},
+	{FIT_SESSION_FIELD_NUM_AVG_POS_GRADE, 100, 0, "%"},
+	{FIT_SESSION_FIELD_NUM_AVG_NEG_GRADE, 100, 0, "%"},
+	{FIT_SESSION_FIELD_NUM_MAX_POS_GRADE, 100, 0, "%"},
+	{FIT_SESSION_FIELD_NUM_MAX_NEG_GRADE, 100, 0, "%"},
+	{FIT_SESSION_FIELD_NUM_AVG_POS_VERTICAL_SPEED, 1000, 0, "m/s"},
+	{FIT_SESSION_FIELD_NUM_AVG_NEG_VERTICAL_SPEED, 1000, 0, "m/s"},
+	{FIT_SESSION_FIELD_NUM_MAX_POS_VERTICAL_SPEED, 1000, 0, "m/s"},
+	{FIT_SESSION_FIELD_NUM_MAX_NEG_VERTICAL_SPEED, 1000, 0, "m/s"},
+	{FIT_SESSION_FIELD_NUM_MIN_ALTITUDE, 5, 500, "m"},
+	{FIT_SESSION_FIELD_NUM_MAX_BALL_SPEED, 100, 0, "m/s"},
+	{FIT_SESSION_FIELD_NUM_AVG_BALL_SPEED, 100, 0, "m/s"},
+	{FIT_SESSION_FIELD_NUM_AVG_VERTICAL_OSCILLATION, 10, 0, "mm"},
+	{FIT_SESSION_FIELD_NUM_AVG_STANCE_TIME_PERCENT, 100, 0, "%"},
+	{FIT_SESSION_FIELD_NUM_AVG_STANCE_TIME, 10, 0, "ms"},
+	{FIT_SESSION_FIELD_NUM_AVG_VAM, 1000, 0, "m/s"},
+	{FIT_SESSION_FIELD_NUM_AVG_HEART_RATE, 1, 0, "bpm"},
+	{FIT_SESSION_FIELD_NUM_MAX_HEART_RATE, 1, 0, "bpm"},
+	{FIT_SESSION_FIELD_NUM_AVG_CADENCE, 1, 0, "rpm"},
+	{FIT_SESSION_FIELD_NUM_MAX_CADENCE, 1, 0, "rpm"},
+	{FIT_SESSION_FIELD_NUM_TOTAL_TRAINING_EFFECT, 10, 0, ""},
+	{FIT_SESSION_FIELD_NUM_GPS_ACCURACY, 1, 0, "m"},
+	{FIT_SESSION_FIELD_NUM_AVG_TEMPERATURE, 1, 0, "C"},
+	{FIT_SESSION_FIELD_NUM_MAX_TEMPERATURE, 1, 0, "C"},
+	{FIT_SESSION_FIELD_NUM_MIN_HEART_RATE, 1, 0, "bpm"},
+	{FIT_SESSION_FIELD_NUM_AVG_FRACTIONAL_CADENCE, 128, 0, "rpm"},
+	{FIT_SESSION_FIELD_NUM_MAX_FRACTIONAL_CADENCE, 128, 0, "rpm"},
+	{FIT_SESSION_FIELD_NUM_TOTAL_FRACTIONAL_CYCLES, 128, 0, "cycles"},
+	{FIT_SESSION_FIELD_NUM_TOTAL_ANAEROBIC_TRAINING_EFFECT, 10, 0, ""},
+	{FIT_SESSION_FIELD_NUM_MIN_TEMPERATURE, 1, 0, "C"}
+};
+
+static _field_units lap_units[] = {
+	{FIT_LAP_FIELD_NUM_START_POSITION_LAT, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_LAP_FIELD_NUM_START_POSITION_LONG, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_LAP_FIELD_NUM_END_POSITION_LAT, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_LAP_FIELD_NUM_END_POSITION_LONG, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_LAP_FIELD_NUM_TOTAL_ELAPSED_TIME, 1000, 0, "s"},
+	{FIT_LAP_FIELD_NUM_TOTAL_TIMER_TIME, 1000, 0, "s"},
+	{FIT_LAP_FIELD_NUM_TOTAL_DISTANCE, 100, 0, "m"},
+	{FIT_LAP_FIELD_NUM_TOTAL_CYCLES, 1, 0, "cycles"},
+	{FIT_LAP_FIELD_NUM_TOTAL_WORK, 1, 0, "J"},
+	{FIT_LAP_FIELD_NUM_TOTAL_MOVING_TIME, 1000, 0, "s"},
+	{FIT_LAP_FIELD_NUM_TIME_IN_HR_ZONE, 1000, 0, "s"},
+	{FIT_LAP_FIELD_NUM_TIME_IN_SPEED_ZONE, 1000, 0, "s"},
+	{FIT_LAP_FIELD_NUM_TIME_IN_CADENCE_ZONE, 1000, 0, "s"},
+	{FIT_LAP_FIELD_NUM_TIME_IN_POWER_ZONE, 1000, 0, "s"},
+	{FIT_LAP_FIELD_NUM_ENHANCED_AVG_SPEED, 1000, 0, "m/s"},
+	{FIT_LAP_FIELD_NUM_ENHANCED_MAX_SPEED, 1000, 0, "m/s"},
+	{FIT_LAP_FIELD_NUM_ENHANCED_AVG_ALTITUDE, 5, 500, "m"},
+	{FIT_LAP_FIELD_NUM_ENHANCED_MIN_ALTITUDE, 5, 500, "m"},
+	{FIT_LAP_FIELD_NUM_ENHANCED_MAX_ALTITUDE, 5, 500, "m"},
+	{FIT_LAP_FIELD_NUM_TOTAL_CALORIES, 1, 0, "kcal"},
+	{FIT_LAP_FIELD_NUM_TOTAL_FAT_CALORIES, 1, 0, "kcal"},
+	{FIT_LAP_FIELD_NUM_AVG_SPEED, 1000, 0, "m/s"},
+	{FIT_LAP_FIELD_NUM_MAX_SPEED, 1000, 0, "m/s"},
+	{FIT_LAP_FIELD_NUM_AVG_POWER, 1, 0, "watts"},
+	{FIT_LAP_FIELD_NUM_MAX_POWER, 1, 0, "watts"},
+	{FIT_LAP_FIELD_NUM_TOTAL_ASCENT, 1, 0, "m"},
+	{FIT_LAP_FIELD_NUM_TOTAL_DESCENT, 1, 0, "m"},
+	{FIT_LAP_FIELD_NUM_NORMALIZED_POWER, 1, 0, "watts"},
+	{FIT_LAP_FIELD_NUM_AVG_STROKE_DISTANCE, 100, 0, "m"},
+	{FIT_LAP_FIELD_NUM_AVG_ALTITUDE, 5, 500, "m"},
+	{FIT_LAP_FIELD_NUM_MAX_ALTITUDE, 5, 500, "m"},
+	{FIT_LAP_FIELD_NUM_AVG_GRADE, 100, 0, "%"},
+	{FIT_LAP_FIELD_NUM_AVG_POS_GRADE, 100, 0, "%"},
+	{FIT_LAP_FIELD_NUM_AVG_NEG_GRADE, 100, 0, "%"},
+	{FIT_LAP_FIELD_NUM_MAX_POS_GRADE, 100, 0, "%"},
+	{FIT_LAP_FIELD_NUM_MAX_NEG_GRADE, 100, 0, "%"},
+	{FIT_LAP_FIELD_NUM_AVG_POS_VERTICAL_SPEED, 1000, 0, "m/s"},
+	{FIT_LAP_FIELD_NUM_AVG_NEG_VERTICAL_SPEED, 1000, 0, "m/s"},
+	{FIT_LAP_FIELD_NUM_MAX_POS_VERTICAL_SPEED, 1000, 0, "m/s"},
+	{FIT_LAP_FIELD_NUM_MAX_NEG_VERTICAL_SPEED, 1000, 0, "m/s"},
+	{FIT_LAP_FIELD_NUM_MIN_ALTITUDE, 5, 500, "m"},
+	{FIT_LAP_FIELD_NUM_AVG_VERTICAL_OSCILLATION, 10, 0, "mm"},
+	{FIT_LAP_FIELD_NUM_AVG_STANCE_TIME_PERCENT, 100, 0, "%"},
+	{FIT_LAP_FIELD_NUM_AVG_STANCE_TIME, 10, 0, "ms"},
+	{FIT_LAP_FIELD_NUM_AVG_TOTAL_HEMOGLOBIN_CONC, 100, 0, "g/dL"},
+	{FIT_LAP_FIELD_NUM_MIN_TOTAL_HEMOGLOBIN_CONC, 100, 0, "g/dL"},
+	{FIT_LAP_FIELD_NUM_MAX_TOTAL_HEMOGLOBIN_CONC, 100, 0, "g/dL"},
+	{FIT_LAP_FIELD_NUM_AVG_SATURATED_HEMOGLOBIN_PERCENT, 10, 0, "%"},
+	{FIT_LAP_FIELD_NUM_MIN_SATURATED_HEMOGLOBIN_PERCENT, 10, 0, "%"},
+	{FIT_LAP_FIELD_NUM_MAX_SATURATED_HEMOGLOBIN_PERCENT, 10, 0, "%"},
+	{FIT_LAP_FIELD_NUM_AVG_VAM, 1000, 0, "m/s"},
+	{FIT_LAP_FIELD_NUM_AVG_HEART_RATE, 1, 0, "bpm"},
+	{FIT_LAP_FIELD_NUM_MAX_HEART_RATE, 1, 0, "bpm"},
+	{FIT_LAP_FIELD_NUM_AVG_CADENCE, 1, 0, "rpm"},
+	{FIT_LAP_FIELD_NUM_MAX_CADENCE, 1, 0, "rpm"},
+	{FIT_LAP_FIELD_NUM_GPS_ACCURACY, 1, 0, "m"},
+	{FIT_LAP_FIELD_NUM_AVG_TEMPERATURE, 1, 0, "C"},
+	{FIT_LAP_FIELD_NUM_MAX_TEMPERATURE, 1, 0, "C"},
+	{FIT_LAP_FIELD_NUM_MIN_HEART_RATE, 1, 0, "bpm"},
+	{FIT_LAP_FIELD_NUM_AVG_FRACTIONAL_CADENCE, 128, 0, "rpm"},
+	{FIT_LAP_FIELD_NUM_MAX_FRACTIONAL_CADENCE, 128, 0, "rpm"},
+	{FIT_LAP_FIELD_NUM_TOTAL_FRACTIONAL_CYCLES, 128, 0, "cycles"},
+	{FIT_LAP_FIELD_NUM_MIN_TEMPERATURE, 1, 0, "C"}
+};
+
+static _field_units length_units[] = {
+	{FIT_LENGTH_FIELD_NUM_TOTAL_ELAPSED_TIME, 1000, 0, "s"},
+	{FIT_LENGTH_FIELD_NUM_TOTAL_TIMER_TIME, 1000, 0, "s"},
+	{FIT_LENGTH_FIELD_NUM_TOTAL_STROKES, 1, 0, "strokes"},
+	{FIT_LENGTH_FIELD_NUM_AVG_SPEED, 1000, 0, "m/s"},
+	{FIT_LENGTH_FIELD_NUM_TOTAL_CALORIES, 1, 0, "kcal"},
+	{FIT_LENGTH_FIELD_NUM_AVG_SWIMMING_CADENCE, 1, 0, "strokes/min"}
+};
+
+static _field_units record_units[] = {
+	{FIT_RECORD_FIELD_NUM_POSITION_LAT, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_RECORD_FIELD_NUM_POSITION_LONG, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_RECORD_FIELD_NUM_DISTANCE, 100, 0, "m"},
+	{FIT_RECORD_FIELD_NUM_TIME_FROM_COURSE, 1000, 0, "s"},
+	{FIT_RECORD_FIELD_NUM_TOTAL_CYCLES, 1, 0, "cycles"},
+	{FIT_RECORD_FIELD_NUM_ACCUMULATED_POWER, 1, 0, "watts"},
+	{FIT_RECORD_FIELD_NUM_ENHANCED_SPEED, 1000, 0, "m/s"},
+	{FIT_RECORD_FIELD_NUM_ENHANCED_ALTITUDE, 5, 500, "m"},
+	{FIT_RECORD_FIELD_NUM_ALTITUDE, 5, 500, "m"},
+	{FIT_RECORD_FIELD_NUM_SPEED, 1000, 0, "m/s"},
+	{FIT_RECORD_FIELD_NUM_POWER, 1, 0, "watts"},
+	{FIT_RECORD_FIELD_NUM_GRADE, 100, 0, "%"},
+	{FIT_RECORD_FIELD_NUM_VERTICAL_SPEED, 1000, 0, "m/s"},
+	{FIT_RECORD_FIELD_NUM_CALORIES, 1, 0, "kcal"},
+	{FIT_RECORD_FIELD_NUM_VERTICAL_OSCILLATION, 10, 0, "mm"},
+	{FIT_RECORD_FIELD_NUM_STANCE_TIME_PERCENT, 100, 0, "%"},
+	{FIT_RECORD_FIELD_NUM_STANCE_TIME, 10, 0, "ms"},
+	{FIT_RECORD_FIELD_NUM_BALL_SPEED, 100, 0, "m/s"},
+	{FIT_RECORD_FIELD_NUM_CADENCE256, 256, 0, "rpm"},
+	{FIT_RECORD_FIELD_NUM_TOTAL_HEMOGLOBIN_CONC, 100, 0, "g/dL"},
+	{FIT_RECORD_FIELD_NUM_TOTAL_HEMOGLOBIN_CONC_MIN, 100, 0, "g/dL"},
+	{FIT_RECORD_FIELD_NUM_TOTAL_HEMOGLOBIN_CONC_MAX, 100, 0, "g/dL"},
+	{FIT_RECORD_FIELD_NUM_SATURATED_HEMOGLOBIN_PERCENT, 10, 0, "%"},
+	{FIT_RECORD_FIELD_NUM_SATURATED_HEMOGLOBIN_PERCENT_MIN, 10, 0, "%"},
+	{FIT_RECORD_FIELD_NUM_SATURATED_HEMOGLOBIN_PERCENT_MAX, 10, 0, "%"},
+	{FIT_RECORD_FIELD_NUM_HEART_RATE, 1, 0, "bpm"},
+	{FIT_RECORD_FIELD_NUM_TEMPERATURE, 1, 0, "C"},
+	{FIT_RECORD_FIELD_NUM_CADENCE, 1, 0, "rpm"},
+	{FIT_RECORD_FIELD_NUM_SPEED_1S, 16, 0, "m/s"},
+	{FIT_RECORD_FIELD_NUM_CYCLES, 1, 0, "cycles"},
+	{FIT_RECORD_FIELD_NUM_GPS_ACCURACY, 1, 0, "m"},
+	{FIT_RECORD_FIELD_NUM_LEFT_TORQUE_EFFECTIVENESS, 2, 0, "percent"},
+	{FIT_RECORD_FIELD_NUM_RIGHT_TORQUE_EFFECTIVENESS, 2, 0, "percent"},
+	{FIT_RECORD_FIELD_NUM_LEFT_PEDAL_SMOOTHNESS, 2, 0, "percent"},
+	{FIT_RECORD_FIELD_NUM_RIGHT_PEDAL_SMOOTHNESS, 2, 0, "percent"},
+	{FIT_RECORD_FIELD_NUM_COMBINED_PEDAL_SMOOTHNESS, 2, 0, "percent"},
+	{FIT_RECORD_FIELD_NUM_TIME128, 128, 0, "s"},
+	{FIT_RECORD_FIELD_NUM_FRACTIONAL_CADENCE, 128, 0, "rpm"}
+};
+
+static _field_units device_info_units[] = {
+	{FIT_DEVICE_INFO_FIELD_NUM_CUM_OPERATING_TIME, 1, 0, "s"},
+	{FIT_DEVICE_INFO_FIELD_NUM_BATTERY_VOLTAGE, 256, 0, "V"}
+};
+
+static _field_units course_point_units[] = {
+	{FIT_COURSE_POINT_FIELD_NUM_POSITION_LAT, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_COURSE_POINT_FIELD_NUM_POSITION_LONG, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_COURSE_POINT_FIELD_NUM_DISTANCE, 100, 0, "m"}
+};
+
+static _field_units segment_point_units[] = {
+	{FIT_SEGMENT_POINT_FIELD_NUM_POSITION_LAT, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_SEGMENT_POINT_FIELD_NUM_POSITION_LONG, SEMICIRCLES_PER_DEGREE, 0, "deg"},
+	{FIT_SEGMENT_POINT_FIELD_NUM_DISTANCE, 100, 0, "m"},
+	{FIT_SEGMENT_POINT_FIELD_NUM_ALTITUDE, 5, 500, "m"}
+};
+
+static _field_units totals_units[] = {
+	{FIT_TOTALS_FIELD_NUM_TIMER_TIME, 1, 0, "s"},
+	{FIT_TOTALS_FIELD_NUM_DISTANCE, 1, 0, "m"},
+	{FIT_TOTALS_FIELD_NUM_CALORIES, 1, 0, "kcal"},
+	{FIT_TOTALS_FIELD_NUM_ELAPSED_TIME, 1, 0, "s"},
+	{FIT_TOTALS_FIELD_NUM_ACTIVE_TIME, 1, 0, "s"}
+};
+
+static _field_units weight_scale_units[] = {
+	{FIT_WEIGHT_SCALE_FIELD_NUM_WEIGHT, 100, 0, "kg"},
+	{FIT_WEIGHT_SCALE_FIELD_NUM_PERCENT_FAT, 100, 0, "%"},
+	{FIT_WEIGHT_SCALE_FIELD_NUM_PERCENT_HYDRATION, 100, 0, "%"},
+	{FIT_WEIGHT_SCALE_FIELD_NUM_VISCERAL_FAT_MASS, 100, 0, "kg"},
+	{FIT_WEIGHT_SCALE_FIELD_NUM_BONE_MASS, 100, 0, "kg"},
+	{FIT_WEIGHT_SCALE_FIELD_NUM_MUSCLE_MASS, 100, 0, "kg"},
+	{FIT_WEIGHT_SCALE_FIELD_NUM_BASAL_MET, 4, 0, "kcal/day"},
+	{FIT_WEIGHT_SCALE_FIELD_NUM_ACTIVE_MET, 4, 0, "kcal/day"},
+	{FIT_WEIGHT_SCALE_FIELD_NUM_BMI, 10, 0, "kg/m^2"},
+	{FIT_WEIGHT_SCALE_FIELD_NUM_METABOLIC_AGE, 1, 0, "years"}
+};
+
+static _field_units monitoring_units[] = {
+	{FIT_MONITORING_FIELD_NUM_DISTANCE, 100, 0, "m"},
+	{FIT_MONITORING_FIELD_NUM_CYCLES, 2, 0, "cycles"},
+	{FIT_MONITORING_FIELD_NUM_ACTIVE_TIME, 1000, 0, "s"},
+	{FIT_MONITORING_FIELD_NUM_CALORIES, 1, 0, "kcal"},
+	{FIT_MONITORING_FIELD_NUM_DISTANCE_16, 1, 0, "100 * m"},
+	{FIT_MONITORING_FIELD_NUM_CYCLES_16, 1, 0, "2 * cycles"},
+	{FIT_MONITORING_FIELD_NUM_ACTIVE_TIME_16, 1, 0, "s"}
+};
+
+static _field_units hrv_units[] = {
+	{FIT_HRV_FIELD_NUM_TIME, 1000, 0, "s"}
+};
+
+static _mesg_units mesg_units[MESG_UNITS] = {
+	{FIT_MESG_NUM_USER_PROFILE, sizeof(user_profile_units)/sizeof(_field_units), user_profile_units},
+	{FIT_MESG_NUM_SESSION, sizeof(session_units)/sizeof(_field_units), session_units},
+	{FIT_MESG_NUM_LAP, sizeof(lap_units)/sizeof(_field_units), lap_units},
+	{FIT_MESG_NUM_LENGTH, sizeof(length_units)/sizeof(_field_units), length_units},
+	{FIT_MESG_NUM_RECORD, sizeof(record_units)/sizeof(_field_units), record_units},
+	{FIT_MESG_NUM_DEVICE_INFO, sizeof(device_info_units)/sizeof(_field_units), device_info_units},
+	{FIT_MESG_NUM_COURSE_POINT, sizeof(course_point_units)/sizeof(_field_units), course_point_units},
+	{FIT_MESG_NUM_SEGMENT_POINT, sizeof(segment_point_units)/sizeof(_field_units), segment_point_units},
+	{FIT_MESG_NUM_TOTALS, sizeof(totals_units)/sizeof(_field_units), totals_units},
+	{FIT_MESG_NUM_WEIGHT_SCALE, sizeof(weight_scale_units)/sizeof(_field_units), weight_scale_units},
+	{FIT_MESG_NUM_MONITORING, sizeof(monitoring_units)/sizeof(_field_units), monitoring_units},
+	{FIT_MESG_NUM_HRV, sizeof(hrv_units)/sizeof(_field_units), hrv_units}
+};
+
 char *get_field_title (FIT_MESG_NUM mesg_num, FIT_UINT8 field_val) {
 	int m, f;
 
@@ -1104,3 +1387,18 @@ char *get_mesg_title (FIT_MESG_NUM mesg_num) {
 
 	return unknown;
 }
+
+_field_units *get_field_units (FIT_MESG_NUM mesg_num, FIT_UINT8 field_val) {
+	int m, f;
+
+	for (m = 0; m < MESG_UNITS; m++) {
+		if (mesg_units[m].g_mesg_num == mesg_num) {
+			for (f = 0; f < mesg_units[m].num_of_fields; f++) {
+				if (mesg_units[m].fields[f].f_val == field_val)
+					return &mesg_units[m].fields[f];
+			}
+		}
+	}
+
+	return NULL;
+}
@@ -1,7 +1,16 @@
 #ifndef FIT_TITLES_
 #define FIT_TITLES_
 
+// field physical units
+typedef struct {
+	FIT_UINT8 f_val;
+	double scale;
+	double offset;
+	char *units;
+} _field_units;
+
 char *get_field_title (FIT_MESG_NUM mesg_num, FIT_UINT8 field_val);
 char *get_mesg_title (FIT_MESG_NUM mesg_num);
+_field_units *get_field_units (FIT_MESG_NUM mesg_num, FIT_UINT8 field_val);
 
 #endif // FIT_TITLES_
\ No newline at end of file
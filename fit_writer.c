@@ -0,0 +1,199 @@
+/*
+
+   This code uses GARMIN FIT SDK V21.141.00 (https://developer.garmin.com/downloads/fit/sdk/FitSDKRelease_21.141.00.zip)
+   Under the Flexible and Interoperable Data Transfer (FIT) Protocol License:
+   (https://www.thisisant.com/developer/ant/licensing/flexible-and-interoperable-data-transfer-fit-protocol-license).
+
+	Write FIT file from records, with file header data size and CRCs.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <fit_example.h>
+#include <fit_crc.h>
+
+#include <fit_crc16.h>
+#include <fit_writer.h>
+
+// open output file and write file header placeholder
+// return 0 on success, -1 on error (error is printed)
+int32_t fit_writer_open (_fit_writer *w, const char *name, FIT_UINT8 protocol_version, FIT_UINT16 profile_version) {
+   memset(w, 0, sizeof(_fit_writer));
+   w->name = name;
+
+   if ((w->f = fopen(name, "wb")) == NULL) {
+      fprintf(stderr, "Failed to open FIT file: %s, %s\n", name, strerror(errno));
+      return -1;
+   }
+   setvbuf(w->f, NULL, _IOFBF, FIT_WRITER_BUF_SIZE);
+
+   w->hdr.header_size = FIT_FILE_HDR_SIZE;
+   w->hdr.protocol_version = protocol_version;
+   w->hdr.profile_version = profile_version;
+   memcpy(w->hdr.data_type, ".FIT", 4);
+
+   if (fwrite(&w->hdr, 1, FIT_FILE_HDR_SIZE, w->f) != FIT_FILE_HDR_SIZE) {
+      fprintf(stderr, "Failed to write to FIT file: %s, %s\n", name, strerror(errno));
+      fit_writer_abort(w);
+      return -1;
+   }
+   return 0;
+}
+
+// write one record (record header and content)
+// return 0 on success, -1 on error (error is printed)
+int32_t fit_writer_write (_fit_writer *w, const void *rec, uint32_t len) {
+   if (w->data_size + len > UINT32_MAX) {
+      fprintf(stderr, "FIT file: %s is larger than 4GB\n", w->name);
+      return -1;
+   }
+
+   if (fwrite(rec, 1, len, w->f) != len) {
+      fprintf(stderr, "Failed to write to FIT file: %s, %s\n", w->name, strerror(errno));
+      return -1;
+   }
+
+   w->data_crc = fit_crc16_update(w->data_crc, rec, len);
+   w->data_size += len;
+   return 0;
+}
+
+// check if local message type holds definition (definition record content, after record header)
+static bool slot_holds (const _fit_writer_slot *slot, const uint8_t *def, uint32_t def_len, bool dev) {
+   return (slot->len == def_len) && (slot->dev == dev) && (memcmp(slot->def, def, def_len) == 0);
+}
+
+// find local message type 0 to num_slots-1 holding definition, without using it
+// return local message type, -1 if none holds it
+int32_t fit_writer_find_slot (const _fit_writer_slots *slots, const uint8_t *def, uint32_t def_len, bool dev, int32_t num_slots) {
+   int32_t s;
+
+   for (s = 0; s < num_slots; s++) {
+      if (slot_holds(&slots->slot[s], def, def_len, dev))
+         return s;
+   }
+   return -1;
+}
+
+// get local message type holding definition (definition record content, after record header). if no local
+// message type holds it, least recently used one is taken and new_def is set: the caller writes the definition
+// record with it. compressed timestamp records (ct) must use local message types 0-3, other records get 4-15
+// so they do not evict them.
+// return local message type
+int32_t fit_writer_get_slot (_fit_writer_slots *slots, const uint8_t *def, uint32_t def_len, bool dev, bool ct, bool *new_def) {
+   int32_t first = ct ? 0 : FIT_WRITER_CT_SLOTS;
+   int32_t last = ct ? FIT_WRITER_CT_SLOTS : FIT_HDR_TYPE_MASK+1;
+   _fit_writer_slot *slot;
+   int32_t s;
+   int32_t lru;
+
+   slots->use_tick++;
+   *new_def = false;
+
+   // fast path - local message type used last time still holds definition
+   s = slots->last_slot;
+   if ((s >= last) || !slot_holds(&slots->slot[s], def, def_len, dev)) {
+      // identical definition may be held by another local message type
+      s = fit_writer_find_slot(slots, def, def_len, dev, last);
+   }
+   if (s >= 0) {
+      slots->slot[s].used = slots->use_tick;
+      slots->last_slot = s;
+      return s;
+   }
+
+   // take least recently used local message type
+   lru = first;
+   for (s = first; s < last; s++) {
+      if (slots->slot[s].used < slots->slot[lru].used)
+         lru = s;
+   }
+
+   slot = &slots->slot[lru];
+   memcpy(slot->def, def, def_len);
+   slot->len = def_len;
+   slot->dev = dev;
+   slot->used = slots->use_tick;
+   slots->last_slot = lru;
+   *new_def = true;
+   return lru;
+}
+
+// write data record of definition def (definition record content, after record header, def_len bytes),
+// with compressed timestamp header if time_offset is not -1. local message types are assigned by fit_writer_get_slot()
+// return 0 on success, -1 on error (error is printed)
+int32_t fit_writer_mesg (_fit_writer *w, const uint8_t *def, uint32_t def_len, bool dev, int32_t time_offset, const uint8_t *data, uint32_t data_len) {
+   uint8_t rec_hdr;
+   bool new_def;
+   int32_t s;
+
+   // write definition record with its new local message type
+   s = fit_writer_get_slot(&w->slots, def, def_len, dev, time_offset >= 0, &new_def);
+   if (new_def) {
+      rec_hdr = FIT_HDR_TYPE_DEF_BIT | (dev ? FIT_HDR_DEV_DATA_BIT : 0) | s;
+      if ((fit_writer_write(w, &rec_hdr, sizeof(rec_hdr)) != 0) || (fit_writer_write(w, def, def_len) != 0))
+         return -1;
+      w->def_recs++;
+   }
+
+   if (time_offset >= 0)
+      rec_hdr = FIT_HDR_TIME_REC_BIT | (s << FIT_HDR_TIME_TYPE_SHIFT) | (time_offset & FIT_HDR_TIME_OFFSET_MASK);
+   else
+      rec_hdr = s;
+
+   if ((fit_writer_write(w, &rec_hdr, sizeof(rec_hdr)) != 0) || (fit_writer_write(w, data, data_len) != 0))
+      return -1;
+   return 0;
+}
+
+// write file CRC, rewrite file header with data size and header CRC, and close file.
+// file CRC covers the file header, so it is combined from the header CRC and the records CRC
+// return 0 on success, -1 on error (error is printed)
+int32_t fit_writer_close (_fit_writer *w) {
+   FIT_UINT16 crc;
+
+   w->hdr.data_size = w->data_size;
+   w->hdr.crc = FitCRC_Calc16(&w->hdr, FIT_FILE_HDR_SIZE-2);
+   crc = fit_crc16_combine(FitCRC_Calc16(&w->hdr, FIT_FILE_HDR_SIZE), w->data_crc, w->data_size);
+
+   if ((fwrite(&crc, 1, sizeof(crc), w->f) != sizeof(crc)) || (fseek(w->f, 0, SEEK_SET) != 0) ||
+       (fwrite(&w->hdr, 1, FIT_FILE_HDR_SIZE, w->f) != FIT_FILE_HDR_SIZE)) {
+      fprintf(stderr, "Failed to write to FIT file: %s, %s\n", w->name, strerror(errno));
+      fit_writer_abort(w);
+      return -1;
+   }
+
+   if (fclose(w->f) != 0) {
+      fprintf(stderr, "Failed to write to FIT file: %s, %s\n", w->name, strerror(errno));
+      w->f = NULL;
+      remove(w->name);
+      return -1;
+   }
+   w->f = NULL;
+   return 0;
+}
+
+// close and remove partly written file
+void fit_writer_abort (_fit_writer *w) {
+   if (w->f == NULL)
+      return;
+   fclose(w->f);
+   w->f = NULL;
+   remove(w->name);
+}
@@ -0,0 +1,48 @@
+#ifndef FIT_WRITER_
+#define FIT_WRITER_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define FIT_WRITER_BUF_SIZE   (1 << 20)      // output file buffer size
+#define FIT_WRITER_DEF_SIZE   (5 + UINT8_MAX * 3 + 1 + UINT8_MAX * 3)   // longest definition record content
+#define FIT_WRITER_CT_SLOTS   4              // compressed timestamp header addresses local message types 0-3 only
+
+// local message type held by written definition
+typedef struct {
+   uint8_t def[FIT_WRITER_DEF_SIZE];         // definition record content (after record header)
+   uint32_t len;                             // 0 if local message type was not defined
+   bool dev;                                 // definition has developer fields
+   uint64_t used;
+} _fit_writer_slot;
+
+// local message types held by written definitions, a new definition takes the least recently used one
+typedef struct {
+   _fit_writer_slot slot[FIT_HDR_TYPE_MASK+1];
+   uint64_t use_tick;
+   int32_t last_slot;                        // local message type looked up last
+} _fit_writer_slots;
+
+// FIT file writer. records are written as they are (record header and content), or by
+// fit_writer_mesg() that assigns local message types. the file header is written with
+// data size 0 and rewritten when the file is closed
+typedef struct {
+   FILE *f;
+   const char *name;
+   FIT_FILE_HDR hdr;
+   FIT_UINT16 data_crc;                      // CRC of records written so far (without file header)
+   uint64_t data_size;
+   _fit_writer_slots slots;
+   uint32_t def_recs;                        // definition records written by fit_writer_mesg()
+} _fit_writer;
+
+int32_t fit_writer_open (_fit_writer *w, const char *name, FIT_UINT8 protocol_version, FIT_UINT16 profile_version);
+int32_t fit_writer_write (_fit_writer *w, const void *rec, uint32_t len);
+int32_t fit_writer_get_slot (_fit_writer_slots *slots, const uint8_t *def, uint32_t def_len, bool dev, bool ct, bool *new_def);
+int32_t fit_writer_find_slot (const _fit_writer_slots *slots, const uint8_t *def, uint32_t def_len, bool dev, int32_t num_slots);
+int32_t fit_writer_mesg (_fit_writer *w, const uint8_t *def, uint32_t def_len, bool dev, int32_t time_offset, const uint8_t *data, uint32_t data_len);
+int32_t fit_writer_close (_fit_writer *w);
+void fit_writer_abort (_fit_writer *w);
+
+#endif // FIT_WRITER_
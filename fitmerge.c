@@ -0,0 +1,375 @@
+/*
+
+   This code uses GARMIN FIT SDK V21.141.00 (https://developer.garmin.com/downloads/fit/sdk/FitSDKRelease_21.141.00.zip)
+   Under the Flexible and Interoperable Data Transfer (FIT) Protocol License:
+   (https://www.thisisant.com/developer/ant/licensing/flexible-and-interoperable-data-transfer-fit-protocol-license).
+
+	Merge FIT files records to one FIT file.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include <fit_example.h>
+
+#include <fit_scan.h>
+#include <fit_file.h>
+#include <fit_writer.h>
+
+#define TIMESTAMP_FIELD       253            // timestamp field number, same in all messages
+#define TIMESTAMP_INVALID     0xFFFFFFFF
+#define DEF_FIXED_SIZE        5              // reserved, arch, global message number, number of fields
+
+// duplicate file_id and device_info messages policy
+enum {
+   DUP_KEEP = 0,                             // write all of them
+   DUP_FIRST,                                // write only the ones of the first file
+   DUP_UNIQUE                                // file_id of the first file, device_info unless the same was written
+};
+
+static int32_t duplicates = DUP_UNIQUE;
+static _fit_writer out;
+
+// --duplicates=unique: written device_info messages, fields (without timestamp) and values
+typedef struct {
+   uint8_t *key;
+   uint32_t len;
+} _dev_info_key;
+
+static _dev_info_key *dev_infos;
+static uint32_t num_dev_infos;
+static uint32_t dev_infos_size;
+
+// timestamps as FIT reader tracks them, in input file and in output file
+static FIT_UINT32 in_last_ts;
+static bool in_last_ts_valid;
+static FIT_UINT32 out_last_ts;
+static bool out_last_ts_valid;
+
+static uint32_t dropped;                     // duplicate records that were not written
+static uint32_t expanded;                    // compressed timestamp records written with timestamp field
+
+/****************************************************/
+/* record fields                                    */
+/****************************************************/
+
+// definition record content length
+static uint32_t def_len (const _fit_scan_type *type) {
+   uint32_t len = DEF_FIXED_SIZE + type->num_fields * sizeof(FIT_FIELD_DEF);
+
+   if (type->num_dev_fields > 0)
+      len += 1 + type->num_dev_fields * sizeof(FIT_DEV_FIELD_DEF);
+   return len;
+}
+
+// timestamp field value of data record, TIMESTAMP_INVALID if it has none
+static FIT_UINT32 rec_timestamp (const _fit_scan_rec *rec) {
+   const uint8_t *v = rec->data;
+   FIT_UINT32 ts = TIMESTAMP_INVALID;
+   int32_t i;
+
+   for (i = 0; i < rec->type->num_fields; v += rec->type->fields[i].size, i++) {
+      if ((rec->type->fields[i].field_def_num == TIMESTAMP_FIELD) && (rec->type->fields[i].size == sizeof(ts))) {
+         ts = rec->type->arch ? ((FIT_UINT32)v[0] << 24) | (v[1] << 16) | (v[2] << 8) | v[3] : v[0] | (v[1] << 8) | (v[2] << 16) | ((FIT_UINT32)v[3] << 24);
+         break;
+      }
+   }
+   return ts;
+}
+
+// timestamp of compressed timestamp header time offset, after last timestamp
+static FIT_UINT32 ct_timestamp (FIT_UINT32 last_ts, uint8_t rec_hdr) {
+   FIT_UINT32 ts = last_ts;
+
+   if ((rec_hdr & FIT_HDR_TIME_OFFSET_MASK) < (ts & FIT_HDR_TIME_OFFSET_MASK))
+      ts += FIT_HDR_TIME_OFFSET_MASK + 1;
+   return (ts & ~FIT_HDR_TIME_OFFSET_MASK) | (rec_hdr & FIT_HDR_TIME_OFFSET_MASK);
+}
+
+/****************************************************/
+/* duplicates policy                                */
+/****************************************************/
+
+// device_info key: fields definitions and values, without timestamp field
+static uint32_t dev_info_key (const _fit_scan_rec *rec, uint8_t *key) {
+   const uint8_t *v = rec->data;
+   uint32_t len = 0;
+   int32_t i;
+
+   for (i = 0; i < rec->type->num_fields; v += rec->type->fields[i].size, i++) {
+      if (rec->type->fields[i].field_def_num == TIMESTAMP_FIELD)
+         continue;
+      memcpy(key + len, &rec->type->fields[i], sizeof(FIT_FIELD_DEF));
+      len += sizeof(FIT_FIELD_DEF);
+      memcpy(key + len, v, rec->type->fields[i].size);
+      len += rec->type->fields[i].size;
+   }
+   for (i = 0; i < rec->type->num_dev_fields; v += rec->type->dev_fields[i].size, i++) {
+      memcpy(key + len, &rec->type->dev_fields[i], sizeof(FIT_DEV_FIELD_DEF));
+      len += sizeof(FIT_DEV_FIELD_DEF);
+      memcpy(key + len, v, rec->type->dev_fields[i].size);
+      len += rec->type->dev_fields[i].size;
+   }
+   return len;
+}
+
+// check if data record is a duplicate that is not written, file is input file number.
+// records of the first file are all written, its device_info messages are the first unique ones
+// return 1 if record is dropped, 0 if it is written and -1 on allocation error
+static int32_t is_duplicate (const _fit_scan_rec *rec, int32_t file) {
+   static uint8_t key[UINT8_MAX * (sizeof(FIT_FIELD_DEF) + UINT8_MAX) * 2];
+   uint32_t len;
+   uint32_t i;
+   void *p;
+
+   if (duplicates == DUP_KEEP)
+      return 0;
+
+   if (rec->type->global_mesg_num == FIT_MESG_NUM_FILE_ID)
+      return file != 0;
+   if (rec->type->global_mesg_num != FIT_MESG_NUM_DEVICE_INFO)
+      return 0;
+   if (duplicates == DUP_FIRST)
+      return file != 0;
+
+   len = dev_info_key(rec, key);
+   for (i = 0; i < num_dev_infos; i++) {
+      if ((dev_infos[i].len == len) && (memcmp(dev_infos[i].key, key, len) == 0))
+         return file != 0;
+   }
+
+   if (num_dev_infos == dev_infos_size) {
+      if ((p = realloc(dev_infos, (dev_infos_size ? dev_infos_size * 2 : 16) * sizeof(_dev_info_key))) == NULL)
+         return -1;
+      dev_infos = p;
+      dev_infos_size = dev_infos_size ? dev_infos_size * 2 : 16;
+   }
+   if ((dev_infos[num_dev_infos].key = malloc(len + 1)) == NULL)
+      return -1;
+   memcpy(dev_infos[num_dev_infos].key, key, len);
+   dev_infos[num_dev_infos++].len = len;
+   return 0;
+}
+
+/****************************************************/
+/* merge                                            */
+/****************************************************/
+
+// write compressed timestamp record whose time offset does not give its timestamp after the last
+// timestamp of the output file (e.g. the record before it was dropped), with timestamp field instead
+static int32_t write_expanded (const _fit_scan_rec *rec, FIT_UINT32 ts) {
+   static uint8_t def[FIT_WRITER_DEF_SIZE + sizeof(FIT_FIELD_DEF)];
+   static uint8_t data[sizeof(FIT_UINT32) + UINT8_MAX * UINT8_MAX * 2];
+   FIT_FIELD_DEF *ts_field;
+   uint32_t len = def_len(rec->type);
+
+   if (rec->type->num_fields == UINT8_MAX) {
+      fprintf(stderr, "Compressed timestamp record at offset %u can not get timestamp field\n", rec->offset);
+      return -1;
+   }
+
+   // timestamp field is added before the other fields
+   memcpy(def, rec->type->def, DEF_FIXED_SIZE);
+   def[DEF_FIXED_SIZE-1]++;
+   ts_field = (FIT_FIELD_DEF *)(def + DEF_FIXED_SIZE);
+   ts_field->field_def_num = TIMESTAMP_FIELD;
+   ts_field->size = sizeof(FIT_UINT32);
+   ts_field->base_type = FIT_FIT_BASE_TYPE_UINT32;
+   memcpy(def + DEF_FIXED_SIZE + sizeof(FIT_FIELD_DEF), rec->type->def + DEF_FIXED_SIZE, len - DEF_FIXED_SIZE);
+
+   if (rec->type->arch) {
+      data[0] = ts >> 24;
+      data[1] = ts >> 16;
+      data[2] = ts >> 8;
+      data[3] = ts;
+   }
+   else
+      memcpy(data, &ts, sizeof(ts));
+   memcpy(data + sizeof(ts), rec->data, rec->len - 1);
+
+   expanded++;
+   return fit_writer_mesg(&out, def, len + sizeof(FIT_FIELD_DEF), rec->type->num_dev_fields > 0, -1, data, rec->len - 1 + sizeof(ts));
+}
+
+// write data record with definition held by output local message type
+static int32_t write_rec (const _fit_scan_rec *rec) {
+   FIT_UINT32 ts;
+
+   if (rec->rec_hdr & FIT_HDR_TIME_REC_BIT) {
+      if (!in_last_ts_valid) {
+         fprintf(stderr, "Compressed timestamp record at offset %u before any timestamp\n", rec->offset);
+         return -1;
+      }
+      ts = in_last_ts = ct_timestamp(in_last_ts, rec->rec_hdr);
+
+      // the output file has its own last timestamp
+      if (!out_last_ts_valid || (ct_timestamp(out_last_ts, rec->rec_hdr) != ts)) {
+         out_last_ts = ts;
+         out_last_ts_valid = true;
+         return write_expanded(rec, ts);
+      }
+      out_last_ts = ts;
+      return fit_writer_mesg(&out, rec->type->def, def_len(rec->type), rec->type->num_dev_fields > 0, rec->rec_hdr & FIT_HDR_TIME_OFFSET_MASK, rec->data, rec->len - 1);
+   }
+
+   if ((ts = rec_timestamp(rec)) != TIMESTAMP_INVALID) {
+      in_last_ts = out_last_ts = ts;
+      in_last_ts_valid = out_last_ts_valid = true;
+   }
+   return fit_writer_mesg(&out, rec->type->def, def_len(rec->type), rec->type->num_dev_fields > 0, -1, rec->data, rec->len - 1);
+}
+
+// merge records of one input file. file is checked before its records are written
+// return 0 on success, -1 on error
+static int32_t merge_file (const int8_t *name, int32_t file, uint32_t *records) {
+   _fit_file in;
+   _fit_scan scan;
+   _fit_scan_rec rec;
+   int32_t r = 0;
+   int32_t dup;
+
+   *records = 0;
+   if (!fit_file_open(&in, name))
+      return -1;
+
+   // check header CRC, records framing and file CRC before anything is written
+   fit_scan_open(&scan, in.data, in.size);
+   fit_scan_check_hdr_crc(&scan);
+   while (fit_scan_next(&scan, &rec) > 0)
+      ;
+   fit_scan_check_crc(&scan);
+   if (scan.error != FIT_SCAN_OK) {
+      fprintf(stderr, "Invalid FIT file: %s, %s (offset %u)\n", name, fit_scan_error_str(scan.error), scan.err_offset);
+      fit_file_close(&in);
+      return -1;
+   }
+
+   // output file gets the latest protocol and profile versions of its inputs
+   if (scan.hdr.protocol_version > out.hdr.protocol_version)
+      out.hdr.protocol_version = scan.hdr.protocol_version;
+   if (scan.hdr.profile_version > out.hdr.profile_version)
+      out.hdr.profile_version = scan.hdr.profile_version;
+
+   in_last_ts_valid = false;
+   fit_scan_open(&scan, in.data, in.size);
+   while (fit_scan_next(&scan, &rec) > 0) {
+      if (rec.def)
+         continue;
+
+      if ((dup = is_duplicate(&rec, file)) < 0) {
+         fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+         r = -1;
+         break;
+      }
+      if (dup) {
+         // dropped record still sets the input file last timestamp
+         if (rec.rec_hdr & FIT_HDR_TIME_REC_BIT)
+            in_last_ts = ct_timestamp(in_last_ts, rec.rec_hdr);
+         else if (rec_timestamp(&rec) != TIMESTAMP_INVALID) {
+            in_last_ts = rec_timestamp(&rec);
+            in_last_ts_valid = true;
+         }
+         dropped++;
+         continue;
+      }
+
+      if (write_rec(&rec) != 0) {
+         r = -1;
+         break;
+      }
+      (*records)++;
+   }
+
+   fit_file_close(&in);
+   return r;
+}
+
+static void print_usage () {
+   fprintf(stderr, "USAGE: fitmerge [--duplicates=keep|first|unique] <output_FIT_file_name> <FIT_file_name> [<FIT_file_name> ...]\n");
+   fprintf(stderr, "       --duplicates=keep     write file_id and device_info messages of all files\n");
+   fprintf(stderr, "       --duplicates=first    write file_id and device_info messages of the first file only\n");
+   fprintf(stderr, "       --duplicates=unique   write file_id of the first file, and device_info messages unless the same\n");
+   fprintf(stderr, "                             device_info (timestamp aside) was written (default)\n");
+}
+
+int32_t main (int32_t argc, int8_t *argv[]) {
+   uint32_t records;
+   uint32_t total = 0;
+   int32_t argi;
+   int32_t i;
+
+   // print general license note
+   printf("\
+******************************************************************************\n\
+   fitmerge (V2.0) Copyright (C) 2024  Yoram Finder\n\
+   This program comes with ABSOLUTELY NO WARRANTY;\n\
+   This is free software, and you are welcome to redistribute it under the\n\
+   GNU License (https://www.gnu.org/licenses/) conditions;\n\
+******************************************************************************\n");
+
+   // read options
+   for (argi = 1; (argi < argc) && (strncmp(argv[argi], "--", 2) == 0); argi++) {
+      if (strcmp(argv[argi], "--duplicates=keep") == 0)
+         duplicates = DUP_KEEP;
+      else if (strcmp(argv[argi], "--duplicates=first") == 0)
+         duplicates = DUP_FIRST;
+      else if (strcmp(argv[argi], "--duplicates=unique") == 0)
+         duplicates = DUP_UNIQUE;
+      else {
+         fprintf(stderr, "Unknown option: %s\n", argv[argi]);
+         return 1;
+      }
+   }
+
+   if (argc - argi < 2) {
+      fprintf(stderr, "Missing arguments\n");
+      print_usage();
+      return 1;
+   }
+
+   // header versions are set from the input files
+   if (fit_writer_open(&out, argv[argi], 0, 0) != 0)
+      return 1;
+
+   for (i = argi+1; i < argc; i++) {
+      if (merge_file(argv[i], i - argi - 1, &records) != 0)
+         goto done_with_error;
+      printf("%s: %u records\n", argv[i], records);
+      total += records;
+   }
+
+   if (fit_writer_close(&out) != 0)
+      goto done_with_error;
+
+   printf("%u records, %u definitions, %u duplicates dropped, %u compressed timestamps expanded\n", total, out.def_recs, dropped, expanded);
+   printf("Merging FIT files completed successfully\n");
+   for (i = 0; i < num_dev_infos; i++)
+      free(dev_infos[i].key);
+   free(dev_infos);
+   return 0;
+
+   //done with error
+done_with_error:
+   fit_writer_abort(&out);
+   for (i = 0; i < num_dev_infos; i++)
+      free(dev_infos[i].key);
+   free(dev_infos);
+   return 1;
+}
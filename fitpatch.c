@@ -0,0 +1,500 @@
+/*
+
+   This code uses GARMIN FIT SDK V21.141.00 (https://developer.garmin.com/downloads/fit/sdk/FitSDKRelease_21.141.00.zip)
+   Under the Flexible and Interoperable Data Transfer (FIT) Protocol License:
+   (https://www.thisisant.com/developer/ant/licensing/flexible-and-interoperable-data-transfer-fit-protocol-license).
+
+	Patch fields values in place in FIT file.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <fit_example.h>
+#include <fit_crc.h>
+
+#include <fit_convert.h>
+#include <fit_crc16.h>
+#include <fit_scan.h>
+
+#define MAX_PATCHES           64             // FIELD=VALUE arguments
+
+// FIELD=VALUE argument, value is in CSV format of the field base type
+typedef struct {
+   FIT_UINT8 field_num;
+   const int8_t *value;
+} _field_patch;
+
+// changed byte range of file. changes are applied only after all of them were found valid
+typedef struct {
+   uint32_t offset;
+   uint32_t len;
+   uint8_t *val;
+} _change;
+
+static uint8_t *file;                              // whole FIT file, mapped or read to memory
+static size_t file_size;
+static bool file_mapped;
+static FILE *fit_f = NULL;                         // fit file handle when file is not mapped
+#ifndef _WIN32
+static int32_t fit_fd = -1;                        // fit file descriptor when file is mapped
+#endif
+static _change *changes;
+static int32_t num_changes;
+static int32_t changes_size;
+static bool real_floats;                           // --real-floats: float values are decimal numbers
+
+/****************************************************/
+/* convert CSV format value to field bytes          */
+/****************************************************/
+
+// base type element size and sign. return element size, 0 for string and -1 for bytes
+static int32_t base_type_elem (FIT_UINT8 base_type, bool *is_signed) {
+   *is_signed = false;
+   switch (base_type) {
+      case FIT_FIT_BASE_TYPE_SINT8:
+         *is_signed = true;
+         // fallthrough
+      case FIT_FIT_BASE_TYPE_ENUM:
+      case FIT_FIT_BASE_TYPE_UINT8:
+      case FIT_FIT_BASE_TYPE_UINT8Z:
+         return 1;
+      case FIT_FIT_BASE_TYPE_SINT16:
+         *is_signed = true;
+         // fallthrough
+      case FIT_FIT_BASE_TYPE_UINT16:
+      case FIT_FIT_BASE_TYPE_UINT16Z:
+         return 2;
+      case FIT_FIT_BASE_TYPE_SINT32:
+         *is_signed = true;
+         // fallthrough
+      case FIT_FIT_BASE_TYPE_UINT32:
+      case FIT_FIT_BASE_TYPE_UINT32Z:
+      case FIT_FIT_BASE_TYPE_FLOAT32:              // fit2csv prints floats binary representation, unless --real-floats
+         return 4;
+      case FIT_FIT_BASE_TYPE_SINT64:
+         *is_signed = true;
+         // fallthrough
+      case FIT_FIT_BASE_TYPE_UINT64:
+      case FIT_FIT_BASE_TYPE_UINT64Z:
+      case FIT_FIT_BASE_TYPE_FLOAT64:
+         return 8;
+      case FIT_FIT_BASE_TYPE_STRING:
+         return 0;
+      default:
+         return -1;                                // BYTE and unknown types are printed as bytes
+   }
+}
+
+// convert value string to size bytes of field, in arch byte order. array elements are separated by "|",
+// bytes by "/" and strings are copied ("NULL" is empty string), the way fit2csv prints them.
+// return false if value is not valid for field base type
+static bool value_to_bytes (const int8_t *value, FIT_UINT8 base_type, FIT_UINT8 arch, uint8_t *val, int32_t size) {
+   const int8_t *end;
+   int32_t len = strlen(value);
+   int32_t elem_size;
+   int32_t i = 0;
+   int32_t b;
+   bool is_signed;
+   uint64_t uv;
+   int64_t sv;
+   float f;
+   double d;
+   uint32_t bits;
+   uint8_t sep;
+
+   memset(val, 0, size);
+
+   if ((elem_size = base_type_elem(base_type, &is_signed)) == 0) {
+      if (strcmp(value, "NULL") != 0)
+         memcpy(val, value, (len < size) ? len : size);
+      return true;
+   }
+
+   sep = (elem_size < 0) ? '/' : '|';
+   if (elem_size < 0)
+      elem_size = 1;
+
+   while (*value != 0) {
+      if ((end = strchr(value, sep)) == NULL)
+         end = value + strlen(value);
+      if (end > value) {
+         if (i + elem_size > size)
+            return false;
+         if (real_floats && (base_type == FIT_FIT_BASE_TYPE_FLOAT32)) {
+            if (parse_float32(value, end - value, &f) < 0)
+               return false;
+            memcpy(&bits, &f, sizeof(bits));
+            uv = bits;
+         }
+         else if (real_floats && (base_type == FIT_FIT_BASE_TYPE_FLOAT64)) {
+            if (parse_float64(value, end - value, &d) < 0)
+               return false;
+            memcpy(&uv, &d, sizeof(uv));
+         }
+         else if (is_signed) {
+            if (parse_int(value, end - value, (elem_size == 8) ? INT64_MIN : -(1LL << (elem_size*8 - 1)),
+                          (elem_size == 8) ? UINT64_MAX : (1ULL << (elem_size*8)) - 1, &sv) < 0)
+               return false;
+            uv = (uint64_t)sv;
+         }
+         else if (parse_uint(value, end - value, (elem_size == 8) ? UINT64_MAX : (1ULL << (elem_size*8)) - 1, &uv) < 0)
+            return false;
+
+         // store element in file byte order
+         for (b = 0; b < elem_size; b++)
+            val[i + (arch ? elem_size - 1 - b : b)] = (uv >> (b*8)) & 0xFF;
+         i += elem_size;
+      }
+      value = (*end != 0) ? end + 1 : end;
+   }
+
+   return i > 0;
+}
+
+// find field in record definition. return field offset in data record, -1 if field is not defined
+static int32_t field_offset (const _fit_scan_type *type, FIT_UINT8 field_num, const FIT_FIELD_DEF **field) {
+   int32_t offset = 0;
+   int32_t i;
+
+   for (i = 0; i < type->num_fields; i++) {
+      if (type->fields[i].field_def_num == field_num) {
+         *field = &type->fields[i];
+         return offset;
+      }
+      offset += type->fields[i].size;
+   }
+   return -1;
+}
+
+/****************************************************/
+/* FIT file access                                  */
+/****************************************************/
+
+// map FIT file for reading and writing, if it can not be mapped read it to memory
+static bool open_fit_file (const int8_t *name) {
+#ifndef _WIN32
+   struct stat st;
+   void *p;
+
+   if ((fit_fd = open(name, O_RDWR)) < 0) {
+      fprintf(stderr, "Failed to open FIT file: %s, %s\n", name, strerror(errno));
+      return false;
+   }
+   if ((fstat(fit_fd, &st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0)) {
+      if ((p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fit_fd, 0)) != MAP_FAILED) {
+         file = p;
+         file_size = st.st_size;
+         file_mapped = true;
+         return true;
+      }
+   }
+   close(fit_fd);
+   fit_fd = -1;
+#endif
+
+   if ((fit_f = fopen(name, "r+b")) == NULL) {
+      fprintf(stderr, "Failed to open FIT file: %s, %s\n", name, strerror(errno));
+      return false;
+   }
+   if ((fseek(fit_f, 0, SEEK_END) != 0) || ((long)(file_size = ftell(fit_f)) < 0) || (fseek(fit_f, 0, SEEK_SET) != 0)) {
+      fprintf(stderr, "Failed to read FIT file: %s, %s\n", name, strerror(errno));
+      return false;
+   }
+   if ((file = malloc(file_size + 1)) == NULL) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      return false;
+   }
+   if (fread(file, 1, file_size, fit_f) != file_size) {
+      fprintf(stderr, "Failed to read FIT file: %s, %s\n", name, strerror(errno));
+      return false;
+   }
+   file_mapped = false;
+   return true;
+}
+
+// add change of file bytes
+static bool add_change (uint32_t offset, const uint8_t *val, uint32_t len) {
+   _change *p;
+
+   if (num_changes == changes_size) {
+      changes_size = (changes_size > 0) ? changes_size * 2 : 64;
+      if ((p = realloc(changes, changes_size * sizeof(_change))) == NULL) {
+         fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+         return false;
+      }
+      changes = p;
+   }
+   if ((changes[num_changes].val = malloc(len)) == NULL) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      return false;
+   }
+   memcpy(changes[num_changes].val, val, len);
+   changes[num_changes].offset = offset;
+   changes[num_changes].len = len;
+   num_changes++;
+   return true;
+}
+
+// apply changes (if write is set) and close FIT file. return false on failure
+static bool close_fit_file (bool write) {
+   bool ok = true;
+   int32_t i;
+
+   for (i = 0; i < num_changes; i++) {
+      if (write && ok) {
+         if (file_mapped)
+            memcpy(file + changes[i].offset, changes[i].val, changes[i].len);
+         else if ((fseek(fit_f, changes[i].offset, SEEK_SET) != 0) || (fwrite(changes[i].val, 1, changes[i].len, fit_f) != changes[i].len)) {
+            fprintf(stderr, "Failed to write FIT file, %s\n", strerror(errno));
+            ok = false;
+         }
+      }
+      free(changes[i].val);
+   }
+   free(changes);
+
+#ifndef _WIN32
+   if (file_mapped) {
+      if (write && (msync(file, file_size, MS_SYNC) != 0)) {
+         fprintf(stderr, "Failed to write FIT file, %s\n", strerror(errno));
+         ok = false;
+      }
+      munmap(file, file_size);
+      close(fit_fd);
+      return ok;
+   }
+#endif
+
+   if ((fit_f != NULL) && (fclose(fit_f) != 0)) {
+      fprintf(stderr, "Failed to write FIT file, %s\n", strerror(errno));
+      ok = false;
+   }
+   free(file);
+   return ok;
+}
+
+/****************************************************/
+/* select records and patch their fields            */
+/****************************************************/
+
+static void print_usage () {
+   fprintf(stderr, "USAGE: fitpatch --mesg=M_NUM [--index=N] [--where=FIELD=VALUE] [--real-floats] <FIT_file_name> FIELD=VALUE [FIELD=VALUE ...]\n");
+   fprintf(stderr, "       --mesg=M_NUM          patch records of global message number M_NUM\n");
+   fprintf(stderr, "       --index=N             patch only the N-th selected record (0 - first)\n");
+   fprintf(stderr, "       --where=FIELD=VALUE   select only records whose field FIELD equals VALUE\n");
+   fprintf(stderr, "       --real-floats         float values are decimal numbers (fit2csv --real-floats)\n");
+   fprintf(stderr, "       FIELD=VALUE           new value of field number FIELD, in the CSV format of fit2csv\n");
+}
+
+// split FIELD=VALUE argument. return false if argument is not valid
+static bool parse_field_arg (const int8_t *arg, _field_patch *patch) {
+   const int8_t *eq;
+   uint64_t v;
+
+   if (((eq = strchr(arg, '=')) == NULL) || (parse_uint(arg, eq - arg, UINT8_MAX, &v) < 0))
+      return false;
+   patch->field_num = (FIT_UINT8)v;
+   patch->value = eq + 1;
+   return true;
+}
+
+int32_t main (int32_t argc, int8_t *argv[]) {
+   _fit_scan scan;
+   _fit_scan_rec rec;
+   _field_patch patches[MAX_PATCHES];
+   int32_t num_patches = 0;
+   _field_patch where = {0};
+   bool use_where = false;
+   uint64_t v;
+   int32_t mesg_num = -1;
+   int64_t index = -1;
+   int64_t selected = 0;                           // records selected so far
+   int32_t patched = 0;                            // fields changed
+   int32_t argi;
+   int32_t i;
+   int32_t off;
+   const FIT_FIELD_DEF *field;
+   uint8_t val[UINT8_MAX+1];
+   uint8_t diff[UINT8_MAX+1];
+   FIT_UINT16 file_crc;
+   FIT_UINT16 diff_crc;
+   uint32_t pos;
+
+   // print general license note
+   printf("\
+******************************************************************************\n\
+   fitpatch (V2.0) Copyright (C) 2024  Yoram Finder\n\
+   This program comes with ABSOLUTELY NO WARRANTY;\n\
+   This is free software, and you are welcome to redistribute it under the\n\
+   GNU License (https://www.gnu.org/licenses/) conditions;\n\
+******************************************************************************\n");
+
+   // read options
+   for (argi = 1; (argi < argc) && (strncmp(argv[argi], "--", 2) == 0); argi++) {
+      if (strncmp(argv[argi], "--mesg=", 7) == 0) {
+         if (parse_uint(argv[argi]+7, strlen(argv[argi]+7), UINT16_MAX, &v) < 0) {
+            fprintf(stderr, "Invalid message number: %s\n", argv[argi]+7);
+            return 1;
+         }
+         mesg_num = v;
+      }
+      else if (strncmp(argv[argi], "--index=", 8) == 0) {
+         if (parse_uint(argv[argi]+8, strlen(argv[argi]+8), INT64_MAX, &v) < 0) {
+            fprintf(stderr, "Invalid record index: %s\n", argv[argi]+8);
+            return 1;
+         }
+         index = v;
+      }
+      else if (strncmp(argv[argi], "--where=", 8) == 0) {
+         if (!parse_field_arg(argv[argi]+8, &where)) {
+            fprintf(stderr, "Invalid record selection: %s\n", argv[argi]+8);
+            return 1;
+         }
+         use_where = true;
+      }
+      else if (strcmp(argv[argi], "--real-floats") == 0)
+         real_floats = true;
+      else {
+         fprintf(stderr, "Unknown option: %s\n", argv[argi]);
+         return 1;
+      }
+   }
+
+   if ((mesg_num < 0) || (argc - argi < 2)) {
+      fprintf(stderr, "Missing arguments\n");
+      print_usage();
+      return 1;
+   }
+
+   for (i = argi+1; i < argc; i++) {
+      if (num_patches == MAX_PATCHES) {
+         fprintf(stderr, "Too many fields, at most %d fields can be patched\n", MAX_PATCHES);
+         return 1;
+      }
+      if (!parse_field_arg(argv[i], &patches[num_patches])) {
+         fprintf(stderr, "Invalid field value: %s\n", argv[i]);
+         print_usage();
+         return 1;
+      }
+      // CRC change of each field is calculated from the original bytes, so a field is patched once
+      for (off = 0; off < num_patches; off++) {
+         if (patches[off].field_num == patches[num_patches].field_num) {
+            fprintf(stderr, "Field %d is patched more than once\n", patches[off].field_num);
+            return 1;
+         }
+      }
+      num_patches++;
+   }
+
+   if (!open_fit_file(argv[argi]))
+      return 1;
+
+   // file CRC is updated from changed bytes only, so file must be intact before it is patched
+   if ((fit_scan_open(&scan, file, file_size) < 0) || (fit_scan_check_hdr_crc(&scan) < 0) || (fit_scan_check_crc(&scan) < 0)) {
+      fprintf(stderr, "Invalid FIT file: %s (offset %u)\n", fit_scan_error_str(scan.error), scan.err_offset);
+      goto done_with_error;
+   }
+   memcpy(&file_crc, file + scan.data_end, sizeof(file_crc));
+
+   while (fit_scan_next(&scan, &rec) > 0) {
+      if (rec.def || (rec.type->global_mesg_num != mesg_num))
+         continue;
+
+      if (use_where) {
+         if ((off = field_offset(rec.type, where.field_num, &field)) < 0)
+            continue;
+         if (!value_to_bytes(where.value, field->base_type, rec.type->arch, val, field->size)) {
+            fprintf(stderr, "Invalid value of field %d: %s\n", where.field_num, where.value);
+            goto done_with_error;
+         }
+         if (memcmp(rec.data + off, val, field->size) != 0)
+            continue;
+      }
+
+      // count selected records. if index is set, only the index-th one is patched
+      if ((index >= 0) && (selected != index)) {
+         selected++;
+         continue;
+      }
+      selected++;
+
+      for (i = 0; i < num_patches; i++) {
+         if ((off = field_offset(rec.type, patches[i].field_num, &field)) < 0) {
+            fprintf(stderr, "Field %d is not defined in record at offset %u\n", patches[i].field_num, rec.offset);
+            goto done_with_error;
+         }
+         if (!value_to_bytes(patches[i].value, field->base_type, rec.type->arch, val, field->size)) {
+            fprintf(stderr, "Invalid value of field %d: %s\n", patches[i].field_num, patches[i].value);
+            goto done_with_error;
+         }
+
+         pos = rec.offset + 1 + off;
+         if (memcmp(file + pos, val, field->size) == 0)
+            continue;
+
+         // CRC is linear: crc(new) = crc(old) ^ crc(old ^ new), where old ^ new is zero outside the
+         // changed bytes. leading zeros do not change CRC, trailing zeros are added by fit_crc16_shift()
+         memcpy(diff, file + pos, field->size);
+         for (off = 0; off < field->size; off++)
+            diff[off] ^= val[off];
+         diff_crc = FitCRC_Update16(0, diff, field->size);
+         file_crc ^= fit_crc16_shift(diff_crc, scan.data_end - pos - field->size);
+
+         if (!add_change(pos, val, field->size))
+            goto done_with_error;
+         printf("Patched field %d of record at offset %u\n", patches[i].field_num, rec.offset);
+         patched++;
+      }
+
+      if (index >= 0)
+         break;
+   }
+
+   if (scan.error != FIT_SCAN_OK) {
+      fprintf(stderr, "Invalid FIT file: %s (offset %u)\n", fit_scan_error_str(scan.error), scan.err_offset);
+      goto done_with_error;
+   }
+
+   if ((selected == 0) || (selected <= index)) {
+      fprintf(stderr, "No record was selected\n");
+      goto done_with_error;
+   }
+
+   if ((patched > 0) && !add_change(scan.data_end, (uint8_t *)&file_crc, sizeof(file_crc)))
+      goto done_with_error;
+   if (!close_fit_file(patched > 0))
+      return 1;
+
+   //done ok;
+   printf("%d fields patched\n", patched);
+   return 0;
+
+   //done with error
+done_with_error:
+   close_fit_file(false);
+   return 1;
+}
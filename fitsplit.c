@@ -0,0 +1,485 @@
+/*
+
+   This code uses GARMIN FIT SDK V21.141.00 (https://developer.garmin.com/downloads/fit/sdk/FitSDKRelease_21.141.00.zip)
+   Under the Flexible and Interoperable Data Transfer (FIT) Protocol License:
+   (https://www.thisisant.com/developer/ant/licensing/flexible-and-interoperable-data-transfer-fit-protocol-license).
+
+	Split FIT file to several FIT files by time, size or lap / session boundaries.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <fit_example.h>
+
+#include <fit_scan.h>
+#include <fit_file.h>
+#include <fit_writer.h>
+
+
+#define TIMESTAMP_FIELD       253            // timestamp field number, same in all messages
+#define TIMESTAMP_INVALID     0xFFFFFFFF
+#define DEF_FIXED_SIZE        5              // reserved, arch, global message number, number of fields
+#define FILE_CRC_SIZE         2
+#define NAME_SUFFIX_SIZE      16             // "_<part number>.fit"
+
+// split modes
+enum {
+   SPLIT_NONE = 0,
+   SPLIT_INTERVAL,                           // --interval=SECONDS: a part for every time interval
+   SPLIT_SIZE,                               // --max-size=BYTES: parts up to size limit
+   SPLIT_LAP,                                // --at=lap: a part for every lap
+   SPLIT_SESSION                             // --at=session: a part for every session
+};
+
+// developer_data_id or field_description record after the file head, and its definition record
+typedef struct {
+   uint32_t def_offset;
+   uint32_t offset;
+   uint32_t len;
+} _dev_rec;
+
+// output file: file head, developer records before start and the definitions held at start, then the
+// records from start to end of input file
+typedef struct {
+   uint32_t start;
+   uint32_t end;
+   uint32_t num_dev_recs;                    // developer records written before start
+   uint32_t defs[FIT_HDR_TYPE_MASK+1];       // offsets of definition records held at start, 0 if none
+   uint64_t prefix_len;                      // length of records written before start
+   uint32_t first_rec;                       // number of data records before start
+   uint32_t records;                         // data records from start to end
+   int32_t error;
+} _part;
+
+static int32_t mode = SPLIT_NONE;
+static FIT_UINT32 interval;
+static uint64_t max_size;
+
+static _fit_file file;
+static _fit_scan scan;
+static uint32_t head_end;                    // offset of first data record with timestamp
+static uint32_t head_defs[FIT_HDR_TYPE_MASK+1];   // definition records held at head_end
+static _dev_rec *dev_recs;
+static uint32_t num_dev_recs;
+static uint32_t dev_recs_size;
+static _part *parts;
+static uint32_t num_parts;
+static uint32_t parts_size;
+static const int8_t *out_prefix;
+static uint32_t data_recs;                   // data records walked so far
+static int32_t next_part;
+
+/****************************************************/
+/* framing scan                                     */
+/****************************************************/
+
+// timestamp field value of data record, TIMESTAMP_INVALID if it has none
+static FIT_UINT32 rec_timestamp (const _fit_scan_rec *rec) {
+   const uint8_t *v = rec->data;
+   FIT_UINT32 ts = TIMESTAMP_INVALID;
+   int32_t i;
+
+   for (i = 0; i < rec->type->num_fields; v += rec->type->fields[i].size, i++) {
+      if ((rec->type->fields[i].field_def_num == TIMESTAMP_FIELD) && (rec->type->fields[i].size == sizeof(ts))) {
+         ts = rec->type->arch ? ((FIT_UINT32)v[0] << 24) | (v[1] << 16) | (v[2] << 8) | v[3] : v[0] | (v[1] << 8) | (v[2] << 16) | ((FIT_UINT32)v[3] << 24);
+         break;
+      }
+   }
+   return ts;
+}
+
+// length of definition record at offset
+static uint32_t def_rec_len (uint32_t offset) {
+   uint32_t len = 1 + DEF_FIXED_SIZE + file.data[offset+DEF_FIXED_SIZE] * sizeof(FIT_FIELD_DEF);
+
+   if (file.data[offset] & FIT_HDR_DEV_DATA_BIT)
+      len += 1 + file.data[offset+len] * sizeof(FIT_DEV_FIELD_DEF);
+   return len;
+}
+
+// offsets of definition records held now
+static void held_defs (uint32_t *defs) {
+   int32_t i;
+
+   for (i = 0; i <= FIT_HDR_TYPE_MASK; i++)
+      defs[i] = (scan.types[i].def != NULL) ? scan.types[i].def - 1 - scan.file : 0;
+}
+
+// set part that starts at record offset, with current developer records and definitions
+static void set_part (_part *part, uint32_t start) {
+   uint32_t held[FIT_HDR_TYPE_MASK+1];
+   uint32_t i;
+   uint8_t t;
+
+   memset(part, 0, sizeof(_part));
+   part->start = start;
+   part->end = scan.data_end;
+   part->num_dev_recs = num_dev_recs;
+   part->first_rec = data_recs;
+   held_defs(part->defs);
+
+   // file head, developer records with their definitions, then definitions that are not held after them
+   memcpy(held, head_defs, sizeof(held));
+   part->prefix_len = head_end - scan.hdr_size;
+   for (i = 0; i < num_dev_recs; i++) {
+      t = file.data[dev_recs[i].def_offset] & FIT_HDR_TYPE_MASK;
+      if (held[t] != dev_recs[i].def_offset) {
+         part->prefix_len += def_rec_len(dev_recs[i].def_offset);
+         held[t] = dev_recs[i].def_offset;
+      }
+      part->prefix_len += dev_recs[i].len;
+   }
+   for (i = 0; i <= FIT_HDR_TYPE_MASK; i++) {
+      if ((part->defs[i] != 0) && (held[i] != part->defs[i]))
+         part->prefix_len += def_rec_len(part->defs[i]);
+   }
+}
+
+// add part, previous part ends at its start. return 0 on success, -1 on allocation error
+static int32_t add_part (const _part *part) {
+   _part *p;
+
+   if (num_parts == parts_size) {
+      if ((p = realloc(parts, (parts_size + 64) * sizeof(_part))) == NULL)
+         return -1;
+      parts = p;
+      parts_size += 64;
+   }
+   if (num_parts > 0)
+      parts[num_parts-1].end = part->start;
+   parts[num_parts++] = *part;
+   return 0;
+}
+
+// add developer record after file head. return 0 on success, -1 on allocation error
+static int32_t add_dev_rec (const _fit_scan_rec *rec) {
+   _dev_rec *p;
+
+   if (num_dev_recs == dev_recs_size) {
+      if ((p = realloc(dev_recs, (dev_recs_size + 64) * sizeof(_dev_rec))) == NULL)
+         return -1;
+      dev_recs = p;
+      dev_recs_size += 64;
+   }
+   dev_recs[num_dev_recs].def_offset = rec->type->def - 1 - scan.file;
+   dev_recs[num_dev_recs].offset = rec->offset;
+   dev_recs[num_dev_recs].len = rec->len;
+   num_dev_recs++;
+   return 0;
+}
+
+// output file size of part that ends at offset
+static uint64_t part_size (const _part *part, uint32_t end) {
+   return FIT_FILE_HDR_SIZE + part->prefix_len + (end - part->start) + FILE_CRC_SIZE;
+}
+
+// walk all records, check file and find parts boundaries. a part starts at a data record with timestamp
+// field, so compressed timestamp records follow their timestamp in the same part.
+// return 0 on success, -1 on error
+static int32_t find_parts (const int8_t *name) {
+   _fit_scan_rec rec;
+   _part cur;                                // part being walked
+   _part cand;                               // --max-size: last record current part can end before
+   bool have_cand = false;
+   bool head = true;
+   bool pending = false;                     // --at: lap or session ended, split at next record message
+   uint32_t warned = UINT32_MAX;            // --max-size: last part counted as oversize
+   uint32_t oversize = 0;
+   uint32_t i;
+   FIT_UINT32 ts;
+   FIT_UINT32 bucket = 0;
+   FIT_UINT16 split_mesg = (mode == SPLIT_LAP) ? FIT_MESG_NUM_LAP : FIT_MESG_NUM_SESSION;
+
+   fit_scan_open(&scan, file.data, file.size);
+   fit_scan_check_hdr_crc(&scan);
+
+   // first part starts at first record and has no file head of its own
+   head_end = scan.hdr_size;
+   data_recs = 0;
+   set_part(&cur, scan.hdr_size);
+   if (add_part(&cur) != 0)
+      goto done_with_error;
+
+   while (fit_scan_next(&scan, &rec) > 0) {
+      if (rec.def)
+         continue;
+
+      ts = (rec.rec_hdr & FIT_HDR_TIME_REC_BIT) ? TIMESTAMP_INVALID : rec_timestamp(&rec);
+      if (head && (ts != TIMESTAMP_INVALID)) {
+         // records before the first timestamp (file_id, file_creator, developer fields descriptions...)
+         // start every output file
+         head = false;
+         head_end = rec.offset;
+         held_defs(head_defs);
+         if (mode == SPLIT_INTERVAL)
+            bucket = ts / interval;
+      }
+      else if (!head && (ts != TIMESTAMP_INVALID) && (rec.offset > cur.start)) {
+         // record can start a part
+         if (((mode == SPLIT_INTERVAL) && (ts / interval > bucket)) ||
+             (pending && (rec.type->global_mesg_num == FIT_MESG_NUM_RECORD))) {
+            if (mode == SPLIT_INTERVAL)
+               bucket = ts / interval;
+            pending = false;
+            set_part(&cur, rec.offset);
+            if (add_part(&cur) != 0)
+               goto done_with_error;
+         }
+         else if (mode == SPLIT_SIZE) {
+            set_part(&cand, rec.offset);
+            have_cand = true;
+         }
+      }
+
+      if (!head && ((rec.type->global_mesg_num == FIT_MESG_NUM_DEVELOPER_DATA_ID) ||
+                    (rec.type->global_mesg_num == FIT_MESG_NUM_FIELD_DESCRIPTION))) {
+         if (add_dev_rec(&rec) != 0)
+            goto done_with_error;
+      }
+      if (((mode == SPLIT_LAP) || (mode == SPLIT_SESSION)) && (rec.type->global_mesg_num == split_mesg))
+         pending = true;
+
+      // --max-size: end current part before the last record that can start a part
+      if ((mode == SPLIT_SIZE) && (part_size(&cur, rec.offset + rec.len) > max_size)) {
+         if (have_cand) {
+            cur = cand;
+            have_cand = false;
+            if (add_part(&cur) != 0)
+               goto done_with_error;
+         }
+         if ((part_size(&cur, rec.offset + rec.len) > max_size) && (warned != num_parts)) {
+            oversize++;
+            warned = num_parts;
+         }
+      }
+      data_recs++;
+   }
+   fit_scan_check_crc(&scan);
+   if (scan.error != FIT_SCAN_OK) {
+      fprintf(stderr, "Invalid FIT file: %s, %s (offset %u)\n", name, fit_scan_error_str(scan.error), scan.err_offset);
+      return -1;
+   }
+
+   if (oversize > 0)
+      fprintf(stderr, "%u files are larger than %llu bytes, with no record with timestamp to split them at\n", oversize, (unsigned long long)max_size);
+
+   for (i = 0; i < num_parts; i++)
+      parts[i].records = ((i + 1 < num_parts) ? parts[i+1].first_rec : data_recs) - parts[i].first_rec;
+   return 0;
+
+   //done with error
+done_with_error:
+   fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+   return -1;
+}
+
+/****************************************************/
+/* parts writing                                    */
+/****************************************************/
+
+// write definition record at offset, unless local message type holds it already
+static int32_t write_def (_fit_writer *w, uint32_t *held, uint32_t offset) {
+   uint8_t t = file.data[offset] & FIT_HDR_TYPE_MASK;
+
+   if (held[t] == offset)
+      return 0;
+   held[t] = offset;
+   return fit_writer_write(w, file.data + offset, def_rec_len(offset));
+}
+
+// write part to its output file. return 0 on success, -1 on error
+static int32_t write_part (uint32_t n) {
+   _part *part = &parts[n];
+   _fit_writer w;
+   int8_t *name;
+   uint32_t held[FIT_HDR_TYPE_MASK+1];
+   uint32_t i;
+
+   if ((name = malloc(strlen(out_prefix) + NAME_SUFFIX_SIZE)) == NULL) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      return -1;
+   }
+   sprintf(name, "%s_%04u.fit", out_prefix, n + 1);
+   if (fit_writer_open(&w, name, scan.hdr.protocol_version, scan.hdr.profile_version) != 0) {
+      free(name);
+      return -1;
+   }
+
+   if (n > 0) {
+      // file head, developer fields descriptions and definitions held at part start
+      if (fit_writer_write(&w, file.data + scan.hdr_size, head_end - scan.hdr_size) != 0)
+         goto done_with_error;
+      memcpy(held, head_defs, sizeof(held));
+      for (i = 0; i < part->num_dev_recs; i++) {
+         if ((write_def(&w, held, dev_recs[i].def_offset) != 0) ||
+             (fit_writer_write(&w, file.data + dev_recs[i].offset, dev_recs[i].len) != 0))
+            goto done_with_error;
+      }
+      for (i = 0; i <= FIT_HDR_TYPE_MASK; i++) {
+         if ((part->defs[i] != 0) && (write_def(&w, held, part->defs[i]) != 0))
+            goto done_with_error;
+      }
+   }
+   if ((fit_writer_write(&w, file.data + part->start, part->end - part->start) != 0) ||
+       (fit_writer_close(&w) != 0))
+      goto done_with_error;
+
+   free(name);
+   return 0;
+
+   //done with error
+done_with_error:
+   fit_writer_abort(&w);
+   free(name);
+   return -1;
+}
+
+// thread function: write parts until all are taken
+static void *write_parts (void *arg) {
+   int32_t i;
+
+   while ((i = __atomic_fetch_add(&next_part, 1, __ATOMIC_RELAXED)) < (int32_t)num_parts)
+      parts[i].error = write_part(i);
+   return NULL;
+}
+
+// write all parts with jobs threads. return number of failed parts
+static int32_t write_all_parts (int32_t jobs) {
+   pthread_t *threads;
+   int32_t i;
+   int32_t started;
+   int32_t failed = 0;
+
+   next_part = 0;
+   if (jobs > (int32_t)num_parts)
+      jobs = num_parts;
+   if ((threads = malloc(jobs * sizeof(pthread_t))) == NULL) {
+      fprintf(stderr, "Failed to allocate memory, %s\n", strerror(errno));
+      return num_parts;
+   }
+
+   // if a thread can not be started, the started ones (or this one) do its share
+   for (started = 0; started < jobs; started++) {
+      if (pthread_create(&threads[started], NULL, write_parts, NULL) != 0)
+         break;
+   }
+   if (started == 0)
+      write_parts(NULL);
+   for (i = 0; i < started; i++)
+      pthread_join(threads[i], NULL);
+
+   for (i = 0; i < (int32_t)num_parts; i++) {
+      if (parts[i].error != 0)
+         failed++;
+   }
+   free(threads);
+   return failed;
+}
+
+static void print_usage () {
+   fprintf(stderr, "USAGE: fitsplit --interval=SECONDS|--max-size=BYTES|--at=lap|--at=session [--jobs=N] <FIT_file_name> <output_prefix>\n");
+   fprintf(stderr, "       --interval=SECONDS  a file for every time interval (e.g. 3600 - an hour, 86400 - a UTC day)\n");
+   fprintf(stderr, "       --max-size=BYTES    files up to BYTES each\n");
+   fprintf(stderr, "       --at=lap            a file for every lap\n");
+   fprintf(stderr, "       --at=session        a file for every session\n");
+   fprintf(stderr, "       --jobs=N            write files with N threads (default - number of CPUs)\n");
+   fprintf(stderr, "       files are named <output_prefix>_0001.fit, <output_prefix>_0002.fit...\n");
+}
+
+int32_t main (int32_t argc, int8_t *argv[]) {
+   int32_t jobs = 0;
+   int32_t argi;
+   uint32_t i;
+
+   // print general license note
+   printf("\
+******************************************************************************\n\
+   fitsplit (V2.0) Copyright (C) 2024  Yoram Finder\n\
+   This program comes with ABSOLUTELY NO WARRANTY;\n\
+   This is free software, and you are welcome to redistribute it under the\n\
+   GNU License (https://www.gnu.org/licenses/) conditions;\n\
+******************************************************************************\n");
+
+   // read options
+   for (argi = 1; (argi < argc) && (strncmp(argv[argi], "--", 2) == 0); argi++) {
+      if (strncmp(argv[argi], "--interval=", 11) == 0) {
+         mode = SPLIT_INTERVAL;
+         interval = strtoul(argv[argi]+11, NULL, 10);
+      }
+      else if (strncmp(argv[argi], "--max-size=", 11) == 0) {
+         mode = SPLIT_SIZE;
+         max_size = strtoull(argv[argi]+11, NULL, 10);
+      }
+      else if (strcmp(argv[argi], "--at=lap") == 0)
+         mode = SPLIT_LAP;
+      else if (strcmp(argv[argi], "--at=session") == 0)
+         mode = SPLIT_SESSION;
+      else if (strncmp(argv[argi], "--jobs=", 7) == 0)
+         jobs = atoi(argv[argi]+7);
+      else {
+         fprintf(stderr, "Unknown option: %s\n", argv[argi]);
+         return 1;
+      }
+   }
+
+   if ((argc - argi != 2) || (mode == SPLIT_NONE)) {
+      fprintf(stderr, "Missing arguments\n");
+      print_usage();
+      return 1;
+   }
+   if (((mode == SPLIT_INTERVAL) && (interval == 0)) || ((mode == SPLIT_SIZE) && (max_size == 0))) {
+      fprintf(stderr, "Wrong split value\n");
+      return 1;
+   }
+   out_prefix = argv[argi+1];
+
+   if (!fit_file_open(&file, argv[argi]))
+      return 1;
+
+   // framing scan finds the parts, then they are written in parallel
+   if (find_parts(argv[argi]) != 0)
+      goto done_with_error;
+
+   if (jobs <= 0)
+      jobs = sysconf(_SC_NPROCESSORS_ONLN);
+   if (jobs <= 0)
+      jobs = 1;
+   if (write_all_parts(jobs) != 0)
+      goto done_with_error;
+
+   for (i = 0; i < num_parts; i++)
+      printf("%s_%04u.fit: %u records, %llu bytes\n", out_prefix, i + 1, parts[i].records,
+             (unsigned long long)part_size(&parts[i], parts[i].end));
+   printf("Splitting FIT file completed successfully\n");
+   fit_file_close(&file);
+   free(parts);
+   free(dev_recs);
+   return 0;
+
+   //done with error
+done_with_error:
+   fit_file_close(&file);
+   free(parts);
+   free(dev_recs);
+   return 1;
+}
@@ -0,0 +1,444 @@
+/*
+
+   This code uses GARMIN FIT SDK V21.141.00 (https://developer.garmin.com/downloads/fit/sdk/FitSDKRelease_21.141.00.zip)
+   Under the Flexible and Interoperable Data Transfer (FIT) Protocol License:
+   (https://www.thisisant.com/developer/ant/licensing/flexible-and-interoperable-data-transfer-fit-protocol-license).
+
+	Thin record messages of FIT file by count, time or distance.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include <fit_example.h>
+
+#include <fit_scan.h>
+#include <fit_file.h>
+#include <fit_writer.h>
+
+#define TIMESTAMP_FIELD       253            // timestamp field number, same in all messages
+#define TIMESTAMP_INVALID     0xFFFFFFFF
+#define POSITION_INVALID      0x7FFFFFFF
+#define DEF_FIXED_SIZE        5              // reserved, arch, global message number, number of fields
+#define EARTH_RADIUS          6371008.8      // meters
+#define SEMICIRCLE_RAD        (M_PI / 2147483648.0)
+
+// thinning modes
+enum {
+   THIN_NONE = 0,
+   THIN_EVERY,                               // --every=N: keep every Nth record
+   THIN_STRIDE,                              // --stride=SECONDS: keep records at least SECONDS apart
+   THIN_DISTANCE                             // --distance=METERS: keep records at least METERS apart
+};
+
+// data record as it is written: record bytes in input file, its definition and timestamp
+typedef struct {
+   bool valid;
+   uint32_t offset;
+   uint32_t len;
+   uint32_t def_offset;
+   uint8_t rec_hdr;
+   FIT_UINT32 ts;                            // TIMESTAMP_INVALID if record has no timestamp
+   bool has_pos;
+   double lat;                               // radians
+   double lon;
+} _rec;
+
+static int32_t mode = THIN_NONE;
+static uint32_t every;
+static FIT_UINT32 stride;
+static double min_distance;
+static double min_angle;                     // --angle: degrees, 0 if not set
+
+static _fit_file file;
+static _fit_scan scan;
+static _fit_writer out;
+static uint32_t out_defs[FIT_HDR_TYPE_MASK+1];   // offsets of input definitions held by output local message types, 0 if none
+
+// timestamps as FIT reader tracks them, in input file and in output file
+static FIT_UINT32 in_last_ts;
+static bool in_last_ts_valid;
+static FIT_UINT32 out_last_ts;
+static bool out_last_ts_valid;
+
+static _rec kept;                            // last written record message
+static _rec held;                            // last dropped record message, written if it ends a segment
+
+static uint32_t records;                     // record messages
+static uint32_t dropped;                     // record messages that were not written
+static uint32_t expanded;                    // compressed timestamp records written with timestamp field
+
+/****************************************************/
+/* record fields                                    */
+/****************************************************/
+
+// timestamp field value of data record, TIMESTAMP_INVALID if it has none
+static FIT_UINT32 rec_timestamp (const _fit_scan_rec *rec) {
+   const uint8_t *v = rec->data;
+   FIT_UINT32 ts = TIMESTAMP_INVALID;
+   int32_t i;
+
+   for (i = 0; i < rec->type->num_fields; v += rec->type->fields[i].size, i++) {
+      if ((rec->type->fields[i].field_def_num == TIMESTAMP_FIELD) && (rec->type->fields[i].size == sizeof(ts))) {
+         ts = rec->type->arch ? ((FIT_UINT32)v[0] << 24) | (v[1] << 16) | (v[2] << 8) | v[3] : v[0] | (v[1] << 8) | (v[2] << 16) | ((FIT_UINT32)v[3] << 24);
+         break;
+      }
+   }
+   return ts;
+}
+
+// timestamp of compressed timestamp header time offset, after last timestamp
+static FIT_UINT32 ct_timestamp (FIT_UINT32 last_ts, uint8_t rec_hdr) {
+   FIT_UINT32 ts = last_ts;
+
+   if ((rec_hdr & FIT_HDR_TIME_OFFSET_MASK) < (ts & FIT_HDR_TIME_OFFSET_MASK))
+      ts += FIT_HDR_TIME_OFFSET_MASK + 1;
+   return (ts & ~FIT_HDR_TIME_OFFSET_MASK) | (rec_hdr & FIT_HDR_TIME_OFFSET_MASK);
+}
+
+// record message position_lat and position_long fields, in radians. return false if record has no valid position
+static bool rec_position (const _fit_scan_rec *rec, double *lat, double *lon) {
+   const uint8_t *v = rec->data;
+   FIT_UINT32 pos[2] = {POSITION_INVALID, POSITION_INVALID};
+   int32_t i;
+   uint8_t f;
+
+   for (i = 0; i < rec->type->num_fields; v += rec->type->fields[i].size, i++) {
+      f = rec->type->fields[i].field_def_num;
+      if (((f == FIT_RECORD_FIELD_NUM_POSITION_LAT) || (f == FIT_RECORD_FIELD_NUM_POSITION_LONG)) && (rec->type->fields[i].size == sizeof(FIT_SINT32)))
+         pos[f] = rec->type->arch ? ((FIT_UINT32)v[0] << 24) | (v[1] << 16) | (v[2] << 8) | v[3] : v[0] | (v[1] << 8) | (v[2] << 16) | ((FIT_UINT32)v[3] << 24);
+   }
+   if ((pos[0] == POSITION_INVALID) || (pos[1] == POSITION_INVALID))
+      return false;
+   *lat = (FIT_SINT32)pos[0] * SEMICIRCLE_RAD;
+   *lon = (FIT_SINT32)pos[1] * SEMICIRCLE_RAD;
+   return true;
+}
+
+// distance in meters (equirectangular approximation, good for points close to each other) and bearing in degrees
+static double distance (const _rec *a, const _rec *b, double *bearing) {
+   double x = (b->lon - a->lon) * cos((a->lat + b->lat) / 2);
+   double y = b->lat - a->lat;
+
+   if (bearing != NULL)
+      *bearing = atan2(x, y) * 180 / M_PI;
+   return sqrt(x * x + y * y) * EARTH_RADIUS;
+}
+
+// length of definition record at offset
+static uint32_t def_rec_len (uint32_t offset) {
+   uint32_t len = 1 + DEF_FIXED_SIZE + file.data[offset+DEF_FIXED_SIZE] * sizeof(FIT_FIELD_DEF);
+
+   if (file.data[offset] & FIT_HDR_DEV_DATA_BIT)
+      len += 1 + file.data[offset+len] * sizeof(FIT_DEV_FIELD_DEF);
+   return len;
+}
+
+/****************************************************/
+/* output                                           */
+/****************************************************/
+
+// write compressed timestamp record with normal header and a timestamp field before its fields. the local
+// message type then holds a definition that is not in input file
+static int32_t write_expanded (const _rec *rec, uint8_t t) {
+   static uint8_t def[1 + FIT_WRITER_DEF_SIZE + sizeof(FIT_FIELD_DEF)];
+   uint8_t data[1 + sizeof(FIT_UINT32)];
+   const uint8_t *in_def = file.data + rec->def_offset;
+   uint32_t len = def_rec_len(rec->def_offset);
+   FIT_FIELD_DEF *ts_field;
+
+   if (in_def[DEF_FIXED_SIZE] == UINT8_MAX) {
+      fprintf(stderr, "Compressed timestamp record at offset %u can not get timestamp field\n", rec->offset);
+      return -1;
+   }
+
+   // timestamp field is added before the other fields
+   memcpy(def, in_def, 1 + DEF_FIXED_SIZE);
+   def[0] = (in_def[0] & FIT_HDR_DEV_DATA_BIT) | FIT_HDR_TYPE_DEF_BIT | t;
+   def[DEF_FIXED_SIZE]++;
+   ts_field = (FIT_FIELD_DEF *)(def + 1 + DEF_FIXED_SIZE);
+   ts_field->field_def_num = TIMESTAMP_FIELD;
+   ts_field->size = sizeof(FIT_UINT32);
+   ts_field->base_type = FIT_FIT_BASE_TYPE_UINT32;
+   memcpy(def + 1 + DEF_FIXED_SIZE + sizeof(FIT_FIELD_DEF), in_def + 1 + DEF_FIXED_SIZE, len - 1 - DEF_FIXED_SIZE);
+
+   data[0] = t;
+   if (in_def[2]) {
+      data[1] = rec->ts >> 24;
+      data[2] = rec->ts >> 16;
+      data[3] = rec->ts >> 8;
+      data[4] = rec->ts;
+   }
+   else
+      memcpy(data + 1, &rec->ts, sizeof(rec->ts));
+
+   out_defs[t] = 0;
+   expanded++;
+   if ((fit_writer_write(&out, def, len + sizeof(FIT_FIELD_DEF)) != 0) ||
+       (fit_writer_write(&out, data, sizeof(data)) != 0) ||
+       (fit_writer_write(&out, file.data + rec->offset + 1, rec->len - 1) != 0))
+      return -1;
+   return 0;
+}
+
+// write data record as is, after its definition unless output local message type holds it. a compressed
+// timestamp record whose time offset gives another timestamp after the output last timestamp is expanded
+static int32_t write_rec (const _rec *rec) {
+   uint8_t t;
+
+   if (rec->rec_hdr & FIT_HDR_TIME_REC_BIT) {
+      t = (rec->rec_hdr & FIT_HDR_TIME_TYPE_MASK) >> FIT_HDR_TIME_TYPE_SHIFT;
+      if (!out_last_ts_valid || (ct_timestamp(out_last_ts, rec->rec_hdr) != rec->ts)) {
+         out_last_ts = rec->ts;
+         out_last_ts_valid = true;
+         return write_expanded(rec, t);
+      }
+   }
+   else
+      t = rec->rec_hdr & FIT_HDR_TYPE_MASK;
+
+   if (rec->ts != TIMESTAMP_INVALID) {
+      out_last_ts = rec->ts;
+      out_last_ts_valid = true;
+   }
+   if (out_defs[t] != rec->def_offset) {
+      if (fit_writer_write(&out, file.data + rec->def_offset, def_rec_len(rec->def_offset)) != 0)
+         return -1;
+      out_defs[t] = rec->def_offset;
+   }
+   return fit_writer_write(&out, file.data + rec->offset, rec->len);
+}
+
+// write record message and keep it as last written one
+static int32_t keep_rec (const _rec *rec) {
+   kept = *rec;
+   held.valid = false;
+   return write_rec(&kept);
+}
+
+// write held record message after all
+static int32_t keep_held () {
+   dropped--;
+   return keep_rec(&held);
+}
+
+/****************************************************/
+/* thinning                                         */
+/****************************************************/
+
+// check if record message is kept. in --angle mode the held record before it may be written first
+static int32_t thin_rec (const _rec *rec, bool *keep) {
+   double b1;
+   double b2;
+   double turn;
+
+   *keep = true;
+   switch (mode) {
+      case THIN_EVERY:
+         *keep = ((records - 1) % every) == 0;
+         break;
+
+      case THIN_STRIDE:
+         // time going back starts again
+         *keep = !kept.valid || (rec->ts == TIMESTAMP_INVALID) || (kept.ts == TIMESTAMP_INVALID) ||
+                 (rec->ts < kept.ts) || (rec->ts - kept.ts >= stride);
+         break;
+
+      case THIN_DISTANCE:
+         // records without position are kept, they can not be thinned by distance
+         if (!rec->has_pos || !kept.valid || !kept.has_pos) {
+            *keep = true;
+            break;
+         }
+
+         // a turn of more than min_angle at the held record keeps it
+         if ((min_angle > 0) && held.valid && held.has_pos &&
+             (distance(&kept, &held, &b1) > 0) && (distance(&held, rec, &b2) > 0)) {
+            turn = fabs(b2 - b1);
+            if (turn > 180)
+               turn = 360 - turn;
+            if ((turn >= min_angle) && (keep_held() != 0))
+               return -1;
+         }
+         *keep = distance(&kept, rec, NULL) >= min_distance;
+         break;
+   }
+   return 0;
+}
+
+// thin record messages of input file to output file. return 0 on success, -1 on error
+static int32_t thin_file () {
+   _fit_scan_rec rec;
+   _rec cur;
+   bool keep;
+
+   fit_scan_open(&scan, file.data, file.size);
+   while (fit_scan_next(&scan, &rec) > 0) {
+      // definitions are written in place, a local message type whose definition was replaced by an expanded
+      // record gets it again before its next record
+      if (rec.def) {
+         if (fit_writer_write(&out, file.data + rec.offset, rec.len) != 0)
+            return -1;
+         out_defs[rec.mesg_type] = rec.offset;
+         continue;
+      }
+
+      memset(&cur, 0, sizeof(cur));
+      cur.valid = true;
+      cur.offset = rec.offset;
+      cur.len = rec.len;
+      cur.def_offset = rec.type->def - 1 - scan.file;
+      cur.rec_hdr = rec.rec_hdr;
+      if (rec.rec_hdr & FIT_HDR_TIME_REC_BIT) {
+         if (!in_last_ts_valid) {
+            fprintf(stderr, "Compressed timestamp record at offset %u before any timestamp\n", rec.offset);
+            return -1;
+         }
+         cur.ts = in_last_ts = ct_timestamp(in_last_ts, rec.rec_hdr);
+      }
+      else if ((cur.ts = rec_timestamp(&rec)) != TIMESTAMP_INVALID) {
+         in_last_ts = cur.ts;
+         in_last_ts_valid = true;
+      }
+
+      if (rec.type->global_mesg_num != FIT_MESG_NUM_RECORD) {
+         // last record before an event, lap, session or activity message ends a segment and is kept. other
+         // messages are written in place, the held record is not written after them
+         if (held.valid && ((rec.type->global_mesg_num == FIT_MESG_NUM_EVENT) || (rec.type->global_mesg_num == FIT_MESG_NUM_LAP) ||
+                            (rec.type->global_mesg_num == FIT_MESG_NUM_SESSION) || (rec.type->global_mesg_num == FIT_MESG_NUM_ACTIVITY))) {
+            if (keep_held() != 0)
+               return -1;
+         }
+         held.valid = false;
+         if (write_rec(&cur) != 0)
+            return -1;
+         continue;
+      }
+
+      records++;
+      if (mode == THIN_DISTANCE)
+         cur.has_pos = rec_position(&rec, &cur.lat, &cur.lon);
+      if (thin_rec(&cur, &keep) != 0)
+         return -1;
+      if (keep) {
+         if (keep_rec(&cur) != 0)
+            return -1;
+      }
+      else {
+         held = cur;
+         dropped++;
+      }
+   }
+
+   // last record ends the file
+   if (held.valid && (keep_held() != 0))
+      return -1;
+   return 0;
+}
+
+static void print_usage () {
+   fprintf(stderr, "USAGE: fitthin --every=N|--stride=SECONDS|--distance=METERS [--angle=DEGREES] <FIT_file_name> <output_FIT_file_name>\n");
+   fprintf(stderr, "       --every=N           keep every Nth record message\n");
+   fprintf(stderr, "       --stride=SECONDS    keep record messages at least SECONDS apart\n");
+   fprintf(stderr, "       --distance=METERS   keep record messages at least METERS apart\n");
+   fprintf(stderr, "       --angle=DEGREES     with --distance, keep also record messages where the track turns by DEGREES\n");
+   fprintf(stderr, "       the last record message before an event, lap, session or activity message is always kept\n");
+}
+
+int32_t main (int32_t argc, int8_t *argv[]) {
+   _fit_scan_rec rec;
+   int32_t argi;
+
+   // print general license note
+   printf("\
+******************************************************************************\n\
+   fitthin (V2.0) Copyright (C) 2024  Yoram Finder\n\
+   This program comes with ABSOLUTELY NO WARRANTY;\n\
+   This is free software, and you are welcome to redistribute it under the\n\
+   GNU License (https://www.gnu.org/licenses/) conditions;\n\
+******************************************************************************\n");
+
+   // read options
+   for (argi = 1; (argi < argc) && (strncmp(argv[argi], "--", 2) == 0); argi++) {
+      if (strncmp(argv[argi], "--every=", 8) == 0) {
+         mode = THIN_EVERY;
+         every = strtoul(argv[argi]+8, NULL, 10);
+      }
+      else if (strncmp(argv[argi], "--stride=", 9) == 0) {
+         mode = THIN_STRIDE;
+         stride = strtoul(argv[argi]+9, NULL, 10);
+      }
+      else if (strncmp(argv[argi], "--distance=", 11) == 0) {
+         mode = THIN_DISTANCE;
+         min_distance = strtod(argv[argi]+11, NULL);
+      }
+      else if (strncmp(argv[argi], "--angle=", 8) == 0)
+         min_angle = strtod(argv[argi]+8, NULL);
+      else {
+         fprintf(stderr, "Unknown option: %s\n", argv[argi]);
+         return 1;
+      }
+   }
+
+   if ((argc - argi != 2) || (mode == THIN_NONE)) {
+      fprintf(stderr, "Missing arguments\n");
+      print_usage();
+      return 1;
+   }
+   if (((mode == THIN_EVERY) && (every == 0)) || ((mode == THIN_STRIDE) && (stride == 0)) ||
+       ((mode == THIN_DISTANCE) && !(min_distance > 0)) || (min_angle < 0) || ((min_angle > 0) && (mode != THIN_DISTANCE))) {
+      fprintf(stderr, "Wrong thinning value\n");
+      return 1;
+   }
+
+   if (!fit_file_open(&file, argv[argi]))
+      return 1;
+
+   // check header CRC, records framing and file CRC before anything is written
+   fit_scan_open(&scan, file.data, file.size);
+   fit_scan_check_hdr_crc(&scan);
+   while (fit_scan_next(&scan, &rec) > 0)
+      ;
+   fit_scan_check_crc(&scan);
+   if (scan.error != FIT_SCAN_OK) {
+      fprintf(stderr, "Invalid FIT file: %s, %s (offset %u)\n", argv[argi], fit_scan_error_str(scan.error), scan.err_offset);
+      fit_file_close(&file);
+      return 1;
+   }
+
+   if (fit_writer_open(&out, argv[argi+1], scan.hdr.protocol_version, scan.hdr.profile_version) != 0) {
+      fit_file_close(&file);
+      return 1;
+   }
+   if ((thin_file() != 0) || (fit_writer_close(&out) != 0))
+      goto done_with_error;
+
+   printf("%u record messages, %u kept, %u dropped, %u compressed timestamps expanded\n", records, records - dropped, dropped, expanded);
+   printf("Thinning FIT file completed successfully\n");
+   fit_file_close(&file);
+   return 0;
+
+   //done with error
+done_with_error:
+   fit_writer_abort(&out);
+   fit_file_close(&file);
+   return 1;
+}
@@ -0,0 +1,109 @@
+/*
+
+	Edge cases of fit_convert text parsers.
+   Copyright (C) <2024>  Yoram Finder
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <fit_cpu.h>
+#include <fit_convert.h>
+
+typedef struct {
+   const char *s;
+   int64_t min;
+   uint64_t max;
+   int32_t rv;                                  // expected return value
+   int64_t val;                                 // expected value if rv is 0
+} _int_case;
+
+typedef struct {
+   const char *s;
+   uint64_t max;
+   int32_t rv;
+   uint64_t val;
+} _uint_case;
+
+static const _int_case int_cases[] = {
+   {"5", INT8_MIN, UINT8_MAX, 0, 5},
+   {"-5", INT8_MIN, UINT8_MAX, 0, -5},
+   {"+5", INT8_MIN, UINT8_MAX, 0, 5},
+   {" -5\r", INT8_MIN, UINT8_MAX, 0, -5},
+   {"-128", INT8_MIN, UINT8_MAX, 0, -128},
+   {"255", INT8_MIN, UINT8_MAX, 0, 255},                 // unsigned text of negative value
+   {"-129", INT8_MIN, UINT8_MAX, -1, 0},
+   {"256", INT8_MIN, UINT8_MAX, -1, 0},
+   {"-+5", INT8_MIN, UINT8_MAX, -1, 0},
+   {"+-5", INT8_MIN, UINT8_MAX, -1, 0},
+   {"--5", INT8_MIN, UINT8_MAX, -1, 0},
+   {"++5", INT8_MIN, UINT8_MAX, -1, 0},
+   {"- 5", INT8_MIN, UINT8_MAX, -1, 0},
+   {"-", INT8_MIN, UINT8_MAX, -1, 0},
+   {"+", INT8_MIN, UINT8_MAX, -1, 0},
+   {"", INT8_MIN, UINT8_MAX, -1, 0},
+   {"5-", INT8_MIN, UINT8_MAX, -1, 0},
+   {"-000000005", INT32_MIN, UINT32_MAX, 0, -5},         // fixed width
+   {"-+00000005", INT32_MIN, UINT32_MAX, -1, 0},
+   {"-1234567890123456", INT64_MIN, UINT64_MAX, 0, -1234567890123456LL},   // vector digits
+   {"-+234567890123456", INT64_MIN, UINT64_MAX, -1, 0},
+   {"+-234567890123456", INT64_MIN, UINT64_MAX, -1, 0},
+   {"-9223372036854775808", INT64_MIN, INT64_MAX, 0, INT64_MIN},
+   {"-9223372036854775809", INT64_MIN, INT64_MAX, -1, 0},
+};
+
+static const _uint_case uint_cases[] = {
+   {"0", UINT8_MAX, 0, 0},
+   {"001", UINT8_MAX, 0, 1},
+   {"+7", UINT8_MAX, 0, 7},
+   {"1a", UINT8_MAX, -1, 0},
+   {"-1", UINT8_MAX, -1, 0},
+   {"+-1", UINT8_MAX, -1, 0},
+   {"18446744073709551615", UINT64_MAX, 0, UINT64_MAX},
+   {"18446744073709551616", UINT64_MAX, -1, 0},
+   {"123456789012345a", UINT64_MAX, -1, 0},
+};
+
+int32_t main () {
+   int64_t iv;
+   uint64_t uv;
+   int32_t failed = 0;
+   int32_t rv;
+   int32_t i;
+
+   for (i = 0; i < sizeof(int_cases)/sizeof(int_cases[0]); i++) {
+      iv = 0;
+      rv = parse_int(int_cases[i].s, strlen(int_cases[i].s), int_cases[i].min, int_cases[i].max, &iv);
+      if ((rv != int_cases[i].rv) || ((rv == 0) && (iv != int_cases[i].val))) {
+         fprintf(stderr, "parse_int(\"%s\") returned %d, %lld\n", int_cases[i].s, rv, (long long)iv);
+         failed++;
+      }
+   }
+
+   for (i = 0; i < sizeof(uint_cases)/sizeof(uint_cases[0]); i++) {
+      uv = 0;
+      rv = parse_uint(uint_cases[i].s, strlen(uint_cases[i].s), uint_cases[i].max, &uv);
+      if ((rv != uint_cases[i].rv) || ((rv == 0) && (uv != uint_cases[i].val))) {
+         fprintf(stderr, "parse_uint(\"%s\") returned %d, %llu\n", uint_cases[i].s, rv, (unsigned long long)uv);
+         failed++;
+      }
+   }
+
+   printf("test_convert (%s): %d failed\n", fit_cpu_name(fit_cpu_level()), failed);
+   return failed ? 1 : 0;
+}
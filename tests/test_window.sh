@@ -0,0 +1,53 @@
+#!/bin/sh
+# --from/--to on a file of compressed timestamp records: CSV, NDJSON and --fit output keep
+# every record of the window by its decoded time. run from the repository directory
+
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+failed=0
+
+# expect <what> <expected> <actual>
+expect () {
+   if [ "$2" != "$3" ]; then
+      echo "$1: expected $2, got $3" >&2
+      failed=$((failed + 1))
+   fi
+}
+
+# 40 records one second apart, csv2fit compresses the timestamps after the first one
+{
+   echo "FIT_PROTOCOL_VERSION, 32"
+   echo "FIT_PROFILE_VERSION,  21141"
+   echo "DEF:M_TYPE,0,M_NUM,0,FIELDS,2,DEV_FIELDS,0,,0,1,0,,4,4,134,,"
+   echo "DATA:CT,0,M_TYPE,0,,,,4,1000000000,"
+   echo "DEF:M_TYPE,1,M_NUM,20,FIELDS,2,DEV_FIELDS,0,,253,4,134,,3,1,2,,"
+   i=0
+   while [ $i -lt 40 ]; do
+      echo "DATA:CT,0,M_TYPE,1,,,,$((1000000000 + i)),$((100 + i)),"
+      i=$((i + 1))
+   done
+   echo "END,"
+} > "$dir/ct.csv"
+
+./csv2fit --compress-timestamps "$dir/ct.csv" "$dir/ct.fit" > /dev/null 2>&1 || expect "csv2fit" 0 $?
+./fit2csv "$dir/ct.fit" "$dir/all.csv" > /dev/null 2>&1
+expect "compressed timestamp records" 39 "$(grep -c '^DATA:CT,[1-9]' "$dir/all.csv")"
+
+# window of 10 records, none of them has a timestamp field
+./fit2csv --from=1000000010 --to=1000000019 "$dir/ct.fit" "$dir/w.csv" > /dev/null 2>&1
+expect "CSV records" 10 "$(grep -c '^DATA:CT,[1-9]' "$dir/w.csv")"
+
+./fit2csv --ndjson --from=1000000010 --to=1000000019 "$dir/ct.fit" "$dir/w.json" > /dev/null 2>&1
+expect "NDJSON records" 10 "$(grep -c '"RECORD"' "$dir/w.json")"
+
+# first record of trimmed FIT file gets timestamp field, the others keep their time offset
+./fit2csv --fit --from=1000000010 --to=1000000019 "$dir/ct.fit" "$dir/w.fit" > /dev/null 2>&1
+./fit2csv --ndjson "$dir/w.fit" "$dir/wf.json" > /dev/null 2>&1
+expect "FIT records" 10 "$(grep -c '"RECORD"' "$dir/wf.json")"
+expect "FIT first timestamp" 1000000010 "$(grep -m1 '"RECORD"' "$dir/wf.json" | sed 's/.*"TIMESTAMP":\([0-9]*\).*/\1/')"
+expect "FIT records values" "$(grep -o '"HEART_RATE":[0-9]*' "$dir/w.json" | tr '\n' ' ')" "$(grep -o '"HEART_RATE":[0-9]*' "$dir/wf.json" | tr '\n' ' ')"
+./fit2csv --verify-only "$dir/w.fit" > "$dir/verify.json" 2> /dev/null
+expect "FIT file check" 1 "$(grep -c '"ok":1' "$dir/verify.json")"
+
+echo "test_window: $failed failed"
+[ $failed -eq 0 ]